@@ -1,36 +1,288 @@
 #include "DPHT.h"
 #include "PHT.h"
 #include "pair.h"
+#include "hash.h"
+#include "flow_key.h"
+#include "thread_pool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <math.h>
 
-#define DEFAULT_INITIAL_TABLES 16   // Default number of tables
-#define DEFAULT_PHT_CAPACITY 4      // Initial capacity for each PHT table
-#define LOAD_FACTOR_THRESHOLD 5.0   // Average keys per table before rehashing
+#define MAX_INITIAL_TABLES (1 << 30) // Largest power of two the directory starts with
+#define SPLITS_PER_INSERT 2         // Maximum buckets split by a single insert
+#define MERGES_PER_REMOVE 2         // Maximum buckets merged by a single removal
+#define SEARCH_BATCH_CHUNK 64       // Keys carried through each stage of a batched search
+#define BATCH_HASH_GRAIN 4096       // Keys hashed per chunk of a parallel batch insert
+#define BATCH_BUCKET_GRAIN 16       // Buckets filled per chunk of a parallel batch insert
+#define TUNER_WINDOW 4096           // Inserts between two decisions of the load controller
+#define TUNER_SAMPLE_INTERVAL 64    // Lookups per timed lookup of the load controller
+#define TUNER_STEP 1.25             // Largest factor the load controller moves max_load by
+#define TUNER_MEMORY 0.5            // Weight of the previous windows in the controller's estimates
+
+/** Structure for the adaptive load controller of a DPHT.
+ *
+ * The controller models the time per operation as a function of the load L
+ * (keys per bucket) from what it measures over each window of TUNER_WINDOW
+ * inserts, at the current average load A:
+ *  - index builds (reported by the buckets through the context, from
+ *    whichever thread built) rebuild about L keys at a time, so their time
+ *    per insert scales as build * L / A;
+ *  - a split is needed every L inserts of a growing table, so the time of
+ *    splits per insert scales as split * A / L;
+ *  - a lookup costs about base + slope * keys in its bucket, fitted over
+ *    the lookups it times (one in TUNER_SAMPLE_INTERVAL per thread).
+ * Weighting each by how often it happened, the sum is lowest at
+ * L = sqrt(split * A / (build / A + lookups * slope)). max_load moves toward
+ * that load by at most TUNER_STEP per window, within the configured bounds.
+ *
+ * \param build_cost Build time totals filled in by the buckets.
+ * \param samples Lookups timed in the window (any thread).
+ * \param sum_keys Sum of the bucket sizes of the timed lookups (any thread).
+ * \param sum_ns Sum of their times in nanoseconds (any thread).
+ * \param sum_keys_ns Sum of size times time, for the slope (any thread).
+ * \param sum_keys2 Sum of squared sizes, for the slope (any thread).
+ * \param lookups Lookups made in the window, estimated from the sampling
+ *                (any thread).
+ * \param split_ns Time spent splitting buckets in the window (writer only).
+ * \param inserts Inserts in the window (writer only).
+ * \param min_load Lowest max_load allowed.
+ * \param max_load Highest max_load allowed.
+ * \param build_term Smoothed build time scaled to a load of 1.
+ * \param split_term Smoothed split time scaled to a load of 1.
+ * \param lookup_term Smoothed lookups times the lookup slope.
+ * \param build_ns_per_key Build time per key indexed in the last window.
+ * \param lookup_avg_ns Average timed lookup in the last window.
+ */
+struct DPHTTuner {
+    pht_build_cost_t build_cost;
+    uint64_t samples;
+    uint64_t sum_keys;
+    uint64_t sum_ns;
+    uint64_t sum_keys_ns;
+    uint64_t sum_keys2;
+    uint64_t lookups;
+    uint64_t split_ns;
+    int inserts;
+    double min_load;
+    double max_load;
+    double build_term;
+    double split_term;
+    double lookup_term;
+    double build_ns_per_key;
+    double lookup_avg_ns;
+};
+
+static __thread unsigned int dpht_lookup_tick = 0; // Lookups made by this thread, for sampling
 
 /** Hash function for the DPHT.
  *
- * This function computes a hash value for the given key using the
- * djb2 algorithm. The hash value is used to determine the index of
- * the PHT table in which the key-value pair will be stored.
+ * This function computes a hash value for the given key bytes with the
+ * table's hash function and seed. The hash value is used to determine the
+ * index of the PHT table in which the key-value pair will be stored, and is
+ * kept in the pair so that it never has to be recomputed.
  *
- * \param key Pointer to the key string.
+ * \param dpht Pointer to the DPHT.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
  * \returns The computed hash value.
  */
-static size_t dpht_hash(const char* key) {
-    size_t hash = 5381;
-    int c;
-    while ((c = *key++))
-        hash = ((hash << 5) + hash) + c;  // hash * 33 + c
-    return hash;
+static uint64_t dpht_hash(const DPHT* dpht, const void* key, size_t len) {
+    if (!dpht->hash) {
+        if (dpht->key_width) {
+            return flow_key_hash(key, len, dpht->seed); // Fixed-width kernel, same values
+        }
+        return hash_bytes_seeded(key, len, dpht->seed); // Default hash, inlined
+    }
+    return dpht->hash(key, len, dpht->seed);
+}
+
+/** Checks a key length against the fixed key width of a DPHT.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param len Number of bytes in the key.
+ * \returns 1 if the DPHT accepts keys of this length, 0 otherwise.
+ */
+static int dpht_key_fits(const DPHT* dpht, size_t len) {
+    return dpht->key_width == 0 || len == (size_t)dpht->key_width;
+}
+
+/** Rounds a table count up to a power of two.
+ *
+ * \param n The requested count (at least 1).
+ * \returns The smallest power of two not below n, at most MAX_INITIAL_TABLES.
+ */
+static int dpht_round_tables(int n) {
+    int tables = 1;
+    while (tables < n && tables < MAX_INITIAL_TABLES) {
+        tables *= 2;
+    }
+    return tables;
+}
+
+/** Reads the clock used by the load controller.
+ *
+ * \returns Monotonic time in nanoseconds.
+ */
+static uint64_t dpht_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/** Returns the initial entries capacity of new buckets for a load factor.
+ *
+ * \param load The split threshold.
+ * \returns The smallest power of two holding load keys.
+ */
+static int dpht_capacity_for_load(double load) {
+    int keys = (int)load;
+    if (keys < load) {
+        keys++;
+    }
+    return dpht_round_tables(keys);
+}
+
+/** Adds timed lookups to the load controller's window.
+ *
+ * \param tuner Pointer to the load controller.
+ * \param count Number of lookups timed together.
+ * \param keys Sum of the sizes of the buckets they probed.
+ * \param elapsed Time they took, in nanoseconds.
+ * \param intervals Sampling intervals they stand for.
+ */
+static void dpht_tuner_sample(dpht_tuner_t* tuner, uint64_t count, uint64_t keys, uint64_t elapsed,
+                              uint64_t intervals) {
+    // A group counts as count lookups of its average size and time
+    __atomic_fetch_add(&tuner->samples, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tuner->sum_keys, keys, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tuner->sum_ns, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tuner->sum_keys_ns, keys * elapsed / count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tuner->sum_keys2, keys * keys / count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tuner->lookups, intervals * TUNER_SAMPLE_INTERVAL, __ATOMIC_RELAXED);
+}
+
+/** Ends a window of the load controller: updates its cost model and moves
+ * max_load toward the load the model finds cheapest.
+ *
+ * \param dpht Pointer to a DPHT with a load controller (writer only).
+ */
+static void dpht_tuner_decide(DPHT* dpht) {
+    dpht_tuner_t* tuner = dpht->tuner;
+    double buildNs = (double)__atomic_exchange_n(&tuner->build_cost.ns, 0, __ATOMIC_RELAXED);
+    double buildKeys = (double)__atomic_exchange_n(&tuner->build_cost.keys, 0, __ATOMIC_RELAXED);
+    double samples = (double)__atomic_exchange_n(&tuner->samples, 0, __ATOMIC_RELAXED);
+    double sumKeys = (double)__atomic_exchange_n(&tuner->sum_keys, 0, __ATOMIC_RELAXED);
+    double sumNs = (double)__atomic_exchange_n(&tuner->sum_ns, 0, __ATOMIC_RELAXED);
+    double sumKeysNs = (double)__atomic_exchange_n(&tuner->sum_keys_ns, 0, __ATOMIC_RELAXED);
+    double sumKeys2 = (double)__atomic_exchange_n(&tuner->sum_keys2, 0, __ATOMIC_RELAXED);
+    double lookups = (double)__atomic_exchange_n(&tuner->lookups, 0, __ATOMIC_RELAXED);
+    double load = (double)dpht->size / dpht->capacity;
+
+    // Least-squares slope of lookup time over bucket size
+    double slope = 0.0;
+    double spread = samples * sumKeys2 - sumKeys * sumKeys;
+    if (samples > 1.0 && spread > 0.0) {
+        slope = (samples * sumKeysNs - sumKeys * sumNs) / spread;
+    }
+    tuner->build_ns_per_key = buildKeys > 0.0 ? buildNs / buildKeys : 0.0;
+    tuner->lookup_avg_ns = samples > 0.0 ? sumNs / samples : 0.0;
+
+    // Fold the window into the smoothed terms, scaled to a load of 1
+    double build = buildNs / load;
+    double split = (double)tuner->split_ns * load;
+    double lookup = lookups * slope;
+    int first = (tuner->build_term == 0.0 && tuner->split_term == 0.0 && tuner->lookup_term == 0.0);
+    double keep = first ? 0.0 : TUNER_MEMORY;
+    tuner->build_term = keep * tuner->build_term + (1.0 - keep) * build;
+    tuner->split_term = keep * tuner->split_term + (1.0 - keep) * split;
+    tuner->lookup_term = keep * tuner->lookup_term + (1.0 - keep) * lookup;
+    tuner->split_ns = 0;
+    tuner->inserts = 0;
+
+    // Step toward the cheapest load, no further than TUNER_STEP
+    double rising = tuner->build_term + tuner->lookup_term;
+    double target = (rising > 0.0) ? sqrt(tuner->split_term / rising) : tuner->max_load;
+    double next = dpht->max_load;
+    if (target > next) {
+        next = (target < next * TUNER_STEP) ? target : next * TUNER_STEP;
+    }
+    else {
+        next = (target > next / TUNER_STEP) ? target : next / TUNER_STEP;
+    }
+    if (next > tuner->max_load) {
+        next = tuner->max_load;
+    }
+    if (next < tuner->min_load) {
+        next = tuner->min_load;
+    }
+    dpht->max_load = next;
+    dpht->bucket_capacity = dpht_capacity_for_load(next);
+}
+
+void dpht_config_init(dpht_config_t* config) {
+    if (!config) {
+        return;
+    }
+    config->initial_tables = DPHT_DEFAULT_TABLES;
+    config->backend = PHT_BACKEND_CMPH;
+    config->bucket_capacity = DPHT_DEFAULT_BUCKET_CAPACITY;
+    config->max_load = DPHT_DEFAULT_MAX_LOAD;
+    config->adaptive_load = 0;
+    config->adaptive_min_load = DPHT_ADAPTIVE_MIN_LOAD;
+    config->adaptive_max_load = DPHT_ADAPTIVE_MAX_LOAD;
+    config->shrink_ratio = DPHT_DEFAULT_SHRINK_RATIO;
+    config->key_width = 0;
+    config->delta_threshold = PHT_DELTA_THRESHOLD;
+    config->tombstone_percent = PHT_TOMBSTONE_PERCENT;
+    config->background_rebuild = 0;
+    config->use_arena = 0;
+    config->huge_pages = 0;
+    config->threads = 1;
+    config->concurrent = 0;
+    config->trace_events = 0;
+    pht_mph_policy_init(&config->mph_policy);
+    config->hash = NULL;
+    config->seed = DPHT_SEED_RANDOM;
+}
+
+/** Creates an empty PHT bucket configured for the given DPHT.
+ *
+ * \param dpht Pointer to the DPHT that will own the bucket.
+ * \param bucket Index of the bucket in the directory.
+ * \returns A pointer to the new PHT, or NULL on failure.
+ */
+static PHT* dpht_new_table(DPHT* dpht, int bucket) {
+    PHT* table = pht_create_with_backend(dpht->bucket_capacity, dpht->backend);
+    if (table) {
+        table->ctx = &dpht->context;
+        table->bucket = bucket;
+    }
+    return table;
 }
 
 DPHT* dpht_create(int initialTables) {
+    dpht_config_t config;
+    dpht_config_init(&config);
+    config.initial_tables = initialTables;
+    return dpht_create_with_config(&config);
+}
+
+DPHT* dpht_create_with_config(const dpht_config_t* config) {
+    dpht_config_t defaults;
+    if (!config) {
+        dpht_config_init(&defaults);
+        config = &defaults;
+    }
+
     // Set default initial tables if the input is invalid
+    int initialTables = config->initial_tables;
     if (initialTables < 1) {
-        initialTables = DEFAULT_INITIAL_TABLES;
+        initialTables = DPHT_DEFAULT_TABLES;
     }
+    initialTables = dpht_round_tables(initialTables);
 
     DPHT* dpht = malloc(sizeof(DPHT));
     if (!dpht) {
@@ -39,15 +291,130 @@ DPHT* dpht_create(int initialTables) {
 
     dpht->capacity = initialTables;
     dpht->size = 0;
-    dpht->tables = malloc(sizeof(PHT*) * dpht->capacity);
+    dpht->base = initialTables;
+    dpht->split = 0;
+    dpht->allocated = initialTables;
+    dpht->min_capacity = initialTables;
+    dpht->backend = config->backend;
+    dpht->bucket_capacity = (config->bucket_capacity > 0) ? config->bucket_capacity : DPHT_DEFAULT_BUCKET_CAPACITY;
+    dpht->max_load = (config->max_load > 0.0) ? config->max_load : DPHT_DEFAULT_MAX_LOAD;
+    dpht->shrink_ratio = config->shrink_ratio;
+    if (dpht->shrink_ratio < 0.0 || dpht->shrink_ratio >= 1.0) {
+        dpht->shrink_ratio = DPHT_DEFAULT_SHRINK_RATIO; // Must stay below the split threshold
+    }
+    dpht->key_width = (config->key_width > 0) ? config->key_width : 0;
+    dpht->tuner = NULL;
+    dpht->hash = config->hash;
+    dpht->seed = config->seed != DPHT_SEED_RANDOM ? config->seed : hash_random_seed();
+    dpht->context.delta_threshold = config->delta_threshold;
+    if (dpht->context.delta_threshold < 0) {
+        dpht->context.delta_threshold = PHT_DELTA_THRESHOLD;
+    }
+    dpht->context.tombstone_percent = config->tombstone_percent;
+    if (dpht->context.tombstone_percent < 0) {
+        dpht->context.tombstone_percent = PHT_TOMBSTONE_PERCENT;
+    }
+    dpht->context.worker = NULL;
+    dpht->context.arena = NULL;
+    dpht->context.epoch = NULL;
+    dpht->context.counters = NULL;
+    dpht->context.trace = NULL;
+    dpht->context.build_cost = NULL;
+    dpht->mph_policy = config->mph_policy;
+    dpht->context.mph_policy = &dpht->mph_policy;
+    dpht->pool = NULL;
+    dpht->concurrent = config->concurrent ? 1 : 0;
+    dpht->seq = 0;
+    if (dpht->concurrent) {
+        pthread_mutex_init(&dpht->write_lock, NULL);
+    }
+    dpht->tables = calloc(dpht->capacity, sizeof(PHT*));
     if (!dpht->tables) {
         free(dpht);
         return NULL; // Memory allocation failure
     }
 
+#ifdef DPHT_STATS
+    // Allocate the event counters, one cache-line-aligned stripe per thread group
+    dpht->context.counters = aligned_alloc(sizeof(pht_counters_t),
+                                           sizeof(pht_counters_t) * PHT_COUNTER_STRIPES);
+    if (!dpht->context.counters) {
+        dpht_free(dpht);
+        return NULL;
+    }
+    memset(dpht->context.counters, 0, sizeof(pht_counters_t) * PHT_COUNTER_STRIPES);
+#endif
+
+    // Create the event trace if requested
+    if (config->trace_events > 0) {
+        dpht->context.trace = trace_ring_create((size_t)config->trace_events);
+        if (!dpht->context.trace) {
+            dpht_free(dpht);
+            return NULL;
+        }
+    }
+
+    // Start the load controller if requested, within sane bounds around max_load
+    if (config->adaptive_load) {
+        dpht->tuner = calloc(1, sizeof(dpht_tuner_t));
+        if (!dpht->tuner) {
+            dpht_free(dpht);
+            return NULL;
+        }
+        dpht_tuner_t* tuner = dpht->tuner;
+        tuner->min_load = (config->adaptive_min_load > 0.0) ? config->adaptive_min_load : DPHT_ADAPTIVE_MIN_LOAD;
+        tuner->max_load = (config->adaptive_max_load >= tuner->min_load) ? config->adaptive_max_load
+                                                                        : tuner->min_load;
+        if (dpht->max_load < tuner->min_load) {
+            dpht->max_load = tuner->min_load;
+        }
+        if (dpht->max_load > tuner->max_load) {
+            dpht->max_load = tuner->max_load;
+        }
+        dpht->bucket_capacity = dpht_capacity_for_load(dpht->max_load);
+        dpht->context.build_cost = &tuner->build_cost;
+    }
+
+    // Create the arena that owns all pairs if requested
+    if (config->use_arena) {
+        dpht->context.arena = arena_create(config->huge_pages);
+        if (!dpht->context.arena) {
+            dpht_free(dpht);
+            return NULL;
+        }
+    }
+
+    // Start the thread pool used by bulk operations if requested
+    if (config->threads > 1) {
+        dpht->pool = thread_pool_create(config->threads);
+        if (!dpht->pool) {
+            dpht_free(dpht);
+            return NULL;
+        }
+    }
+
+    // Create the reclamation domain of lock-free readers if requested
+    if (dpht->concurrent) {
+        dpht->context.epoch = epoch_create();
+        if (!dpht->context.epoch) {
+            dpht_free(dpht);
+            return NULL;
+        }
+    }
+
+    // Start the background rebuild worker if requested (concurrent writers
+    // rebuild on their private bucket copies instead)
+    if (config->background_rebuild && !dpht->concurrent) {
+        dpht->context.worker = rebuild_worker_create();
+        if (!dpht->context.worker) {
+            dpht_free(dpht);
+            return NULL;
+        }
+    }
+
     // Initialize each PHT table in the DPHT
     for (int i = 0; i < dpht->capacity; i++) {
-        dpht->tables[i] = pht_create(DEFAULT_PHT_CAPACITY);
+        dpht->tables[i] = dpht_new_table(dpht, i);
         if (!dpht->tables[i]) {
             dpht_free(dpht);
             return NULL;
@@ -56,67 +423,359 @@ DPHT* dpht_create(int initialTables) {
     return dpht;
 }
 
-/** Rehashes the DPHT by doubling its number of PHT buckets.
+DPHT* dpht_build(const char** keys, const char** values, size_t n) {
+    return dpht_build_with_config(NULL, keys, values, n);
+}
+
+DPHT* dpht_build_with_config(const dpht_config_t* config, const char** keys,
+                             const char** values, size_t n) {
+    if (!keys || !values) {
+        return NULL; // Invalid parameters
+    }
+
+    dpht_config_t sized;
+    if (config) {
+        sized = *config;
+    }
+    else {
+        dpht_config_init(&sized);
+    }
+
+    // Start with enough buckets to hold n keys below the load factor
+    double max_load = (sized.max_load > 0.0) ? sized.max_load : DPHT_DEFAULT_MAX_LOAD;
+    size_t needed = (size_t)(n / max_load) + 1;
+    if (needed > (size_t)sized.initial_tables) {
+        sized.initial_tables = (needed > MAX_INITIAL_TABLES) ? MAX_INITIAL_TABLES : (int)needed;
+    }
+
+    DPHT* dpht = dpht_create_with_config(&sized);
+    if (!dpht) {
+        return NULL;
+    }
+    if (n > 0 && dpht_insert_batch(dpht, keys, values, n) == 0) {
+        dpht_free(dpht);
+        return NULL;
+    }
+    return dpht;
+}
+
+/** Maps a hash value to its PHT bucket (linear hashing).
  *
- * This function reallocates the internal array of PHT pointers in the DPHT,
- * and redistributes all key-value pairs into the new PHTs using the updated capacity.
- * Each key is rehashed into a new bucket based on the updated hash modulus.
+ * Buckets below the split pointer have already been split in the current
+ * round and are addressed with twice the round's base modulus. The base is
+ * always a power of two, so both moduli are bit masks of the low hash bits.
  *
- * \param dpht Pointer to the DPHT to be rehashed.
- *             The original tables and entries will be freed after rehashing.
+ * \param dpht Pointer to the DPHT.
+ * \param hashValue The hash of the key.
+ * \returns The index of the PHT bucket holding the key.
  */
-static void dpht_rehash(DPHT* dpht) {
-    int oldCapacity = dpht->capacity;
-    int newCapacity = oldCapacity * 2;
+static int dpht_index(const DPHT* dpht, uint64_t hashValue) {
+    uint64_t index = hashValue & ((uint64_t)dpht->base - 1);
+    if (index < (uint64_t)dpht->split) {
+        index = hashValue & ((uint64_t)dpht->base * 2 - 1);
+    }
+    return (int)index;
+}
 
-    // Allocate new tables array
-    PHT** newTables = malloc(sizeof(PHT*) * newCapacity);
-    if (!newTables) {
-        return; // Leave DPHT unchanged on allocation failure
+/** Predicate for pht_move_entries(): does a pair belong to the split image?
+ *
+ * \param pair Pointer to the pair being considered.
+ * \param arg Pointer to the DPHT being grown.
+ * \returns 1 if the pair moves to bucket base + split, 0 otherwise.
+ */
+static int dpht_moves_on_split(const pair_t* pair, void* arg) {
+    DPHT* dpht = (DPHT*)arg;
+    return (int)(pair->hash & ((uint64_t)dpht->base * 2 - 1)) != dpht->split;
+}
+
+/** epoch_retire() callback freeing a replaced bucket version.
+ *
+ * \param ptr Pointer to the PHT version.
+ * \param arg Unused.
+ */
+static void dpht_free_retired_table(void* ptr, void* arg) {
+    (void)arg;
+    pht_delete_shell((PHT*)ptr);
+}
+
+/** epoch_retire() callback freeing a replaced directory array.
+ *
+ * \param ptr Pointer to the PHT* array.
+ * \param arg Unused.
+ */
+static void dpht_free_retired_directory(void* ptr, void* arg) {
+    (void)arg;
+    free(ptr);
+}
+
+/** Starts a write: takes the writer lock of a concurrent DPHT.
+ *
+ * \param dpht Pointer to the DPHT.
+ */
+static void dpht_write_begin(DPHT* dpht) {
+    if (dpht->concurrent) {
+        pthread_mutex_lock(&dpht->write_lock);
     }
+}
 
-    // Initialize each new PHT
-    for (int i = 0; i < newCapacity; i++) {
-        newTables[i] = pht_create(DEFAULT_PHT_CAPACITY);
-        if (!newTables[i]) { // Memory allocation failure
-            for (int j = 0; j < i; j++) {
-                pht_delete(newTables[j]);
-            }
-            free(newTables);
-            return;
+/** Ends a write: frees what readers have released and drops the writer lock.
+ *
+ * \param dpht Pointer to the DPHT.
+ */
+static void dpht_write_end(DPHT* dpht) {
+    if (dpht->concurrent) {
+        epoch_reclaim(dpht->context.epoch);
+        pthread_mutex_unlock(&dpht->write_lock);
+    }
+}
+
+/** Returns the version of a bucket a writer may modify.
+ *
+ * Without concurrent readers this is the bucket itself; otherwise it is a
+ * private copy that must be handed to dpht_publish_table().
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param index Index of the bucket.
+ * \returns The writable bucket, or NULL on failure.
+ */
+static PHT* dpht_writable_table(DPHT* dpht, int index) {
+    if (!dpht->concurrent) {
+        return dpht->tables[index];
+    }
+    return pht_clone(dpht->tables[index]);
+}
+
+/** Makes the result of a write visible to concurrent readers.
+ *
+ * The modified copy replaces the bucket with a single pointer store and the
+ * previous version is retired; an unchanged copy is simply dropped.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param index Index of the bucket.
+ * \param table The bucket returned by dpht_writable_table().
+ * \param changed Nonzero if the write modified the bucket.
+ */
+static void dpht_publish_table(DPHT* dpht, int index, PHT* table, int changed) {
+    if (!dpht->concurrent) {
+        return; // The bucket was modified in place
+    }
+    if (!changed) {
+        pht_delete_shell(table);
+        return;
+    }
+    PHT* old = dpht->tables[index];
+    __atomic_store_n(&dpht->tables[index], table, __ATOMIC_RELEASE);
+    epoch_retire(dpht->context.epoch, old, dpht_free_retired_table, NULL);
+}
+
+/** Opens a seqlock write section around a change of the directory layout.
+ *
+ * Readers that look at the directory meanwhile, or that miss a key across
+ * the section, start their lookup again.
+ *
+ * \param dpht Pointer to the DPHT.
+ */
+static void dpht_layout_begin(DPHT* dpht) {
+    if (dpht->concurrent) {
+        __atomic_store_n(&dpht->seq, dpht->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+}
+
+/** Closes a seqlock write section opened by dpht_layout_begin().
+ *
+ * \param dpht Pointer to the DPHT.
+ */
+static void dpht_layout_end(DPHT* dpht) {
+    if (dpht->concurrent) {
+        __atomic_store_n(&dpht->seq, dpht->seq + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/** Reallocates the directory array to a new number of slots.
+ *
+ * The first capacity bucket pointers are kept. In a concurrent DPHT readers
+ * may be indexing the current array, so a copy is published instead and the
+ * old array is retired.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param allocated The new number of slots, at least the capacity.
+ * \returns 1 on success, 0 on failure (the directory is left unchanged).
+ */
+static int dpht_resize_directory(DPHT* dpht, int allocated) {
+    if (!dpht->concurrent) {
+        PHT** newTables = realloc(dpht->tables, sizeof(PHT*) * allocated);
+        if (!newTables) {
+            return 0; // Memory allocation failure
+        }
+        dpht->tables = newTables;
+    }
+    else {
+        PHT** newTables = malloc(sizeof(PHT*) * allocated);
+        if (!newTables) {
+            return 0; // Memory allocation failure
         }
+        memcpy(newTables, dpht->tables, sizeof(PHT*) * dpht->capacity);
+        PHT** oldTables = dpht->tables;
+        __atomic_store_n(&dpht->tables, newTables, __ATOMIC_RELEASE);
+        epoch_retire(dpht->context.epoch, oldTables, dpht_free_retired_directory, NULL);
     }
+    dpht->allocated = allocated;
+    return 1;
+}
 
-    // Rehash all entries from the old tables into the new tables
-    for (int i = 0; i < oldCapacity; i++) {
-        PHT* oldTable = dpht->tables[i];
+/** Grows the DPHT by one bucket (one linear-hashing split).
+ *
+ * The bucket under the split pointer is divided between itself and a new
+ * bucket appended at index base + split. Pairs move by pointer, so the cost is
+ * bounded by the size of one bucket rather than the whole table. When every
+ * bucket of the round has been split, the base doubles and a new round starts.
+ *
+ * \param dpht Pointer to the DPHT to grow.
+ * \returns 1 on success, 0 on failure (the DPHT is left unchanged).
+ */
+static int dpht_split_bucket(DPHT* dpht) {
+    int bucket = dpht->split;
+    int oldCapacity = dpht->capacity;
+    trace_ring_record(dpht->context.trace, TRACE_SPLIT_BEGIN, 0, bucket, oldCapacity, oldCapacity + 1);
+    // Grow the directory geometrically; this copies pointers only
+    if (dpht->capacity >= dpht->allocated && !dpht_resize_directory(dpht, dpht->allocated * 2)) {
+        trace_ring_record(dpht->context.trace, TRACE_SPLIT_END, 0, bucket, oldCapacity, oldCapacity);
+        return 0; // Leave DPHT unchanged on allocation failure
+    }
 
-        // Iterate through each entry in the old table
-        for (int j = 0; j < oldTable->size; j++) {
-            pair_t* entry = oldTable->entries[j];
+    PHT* target = dpht_new_table(dpht, dpht->capacity);
+    PHT* source = target ? dpht_writable_table(dpht, dpht->split) : NULL;
+    if (!source) {
+        pht_delete(target);
+        trace_ring_record(dpht->context.trace, TRACE_SPLIT_END, 0, bucket, oldCapacity, oldCapacity);
+        return 0; // Memory allocation failure
+    }
 
-            if (entry) {
-                // Duplicate the pair so the new tables own their copy
-                pair_t* dupEntry = pair_create(entry->key, entry->value);
-                if (!dupEntry) {
-                    continue; // Memory allocation failed, skip this entry
-                }
-                // Calculate the new hash value and insert into the new table
-                size_t hashValue = dpht_hash(entry->key);
-                int newIndex = hashValue % newCapacity;
-                int status = pht_insert(newTables[newIndex], dupEntry);
+    // Move the pairs whose placement changes into the new bucket. Readers
+    // keep using the published buckets meanwhile, so the index builds this
+    // may run stay outside the seqlock section
+    pht_move_entries(source, target, dpht_moves_on_split, dpht);
+    dpht_layout_begin(dpht);
+    __atomic_store_n(&dpht->tables[dpht->base + dpht->split], target, __ATOMIC_RELEASE);
+    dpht_publish_table(dpht, dpht->split, source, 1);
+    __atomic_store_n(&dpht->capacity, dpht->capacity + 1, __ATOMIC_RELAXED);
 
-                if (!status) {
-                    pair_free(dupEntry); // Insertion failed, free the duplicate
-                }
-            }
+    // Advance the split pointer, starting a new round when it wraps
+    if (dpht->split + 1 == dpht->base) {
+        __atomic_store_n(&dpht->base, dpht->base * 2, __ATOMIC_RELAXED);
+        __atomic_store_n(&dpht->split, 0, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_store_n(&dpht->split, dpht->split + 1, __ATOMIC_RELAXED);
+    }
+    dpht_layout_end(dpht);
+    PHT_COUNT(dpht->context.counters, splits, 1);
+    trace_ring_record(dpht->context.trace, TRACE_SPLIT_END, 0, bucket, oldCapacity, dpht->capacity);
+    return 1;
+}
+
+/** Predicate for pht_move_entries(): does a pair belong to the last bucket?
+ *
+ * \param pair Pointer to the pair being considered.
+ * \param arg Pointer to the DPHT being shrunk, before its layout changes.
+ * \returns 1 if the pair maps to bucket capacity - 1, 0 otherwise.
+ */
+static int dpht_moves_on_merge(const pair_t* pair, void* arg) {
+    DPHT* dpht = (DPHT*)arg;
+    return dpht_index(dpht, pair->hash) == dpht->capacity - 1;
+}
+
+/** Predicate for pht_move_entries(): moves every pair.
+ *
+ * \param pair Pointer to the pair being considered.
+ * \param arg Unused.
+ * \returns 1.
+ */
+static int dpht_moves_all(const pair_t* pair, void* arg) {
+    (void)pair;
+    (void)arg;
+    return 1;
+}
+
+/** Shrinks the DPHT by one bucket (the reverse of dpht_split_bucket()).
+ *
+ * The split pointer steps back, ending the current round when it is already
+ * at 0, and the last bucket is merged back into the bucket it was split
+ * from. Pairs move by pointer, so the cost is bounded by the size of two
+ * buckets. Once at most a quarter of the directory array is in use, it is
+ * halved.
+ *
+ * \param dpht Pointer to the DPHT to shrink.
+ * \returns 1 on success, 0 on failure or if the DPHT is at its minimum
+ *          capacity (the DPHT is left unchanged).
+ */
+static int dpht_merge_bucket(DPHT* dpht) {
+    int oldCapacity = dpht->capacity;
+    if (oldCapacity <= dpht->min_capacity) {
+        return 0; // Never shrink below the initial directory
+    }
+    int base = dpht->base;
+    int split = dpht->split;
+    if (split == 0) {
+        base /= 2;
+        split = base;
+    }
+    split--;
+    int last = oldCapacity - 1; // Always base + split
+    trace_ring_record(dpht->context.trace, TRACE_MERGE_BEGIN, 0, split, oldCapacity, oldCapacity - 1);
+
+    PHT* target = dpht_writable_table(dpht, split);
+    PHT* source = target ? dpht_writable_table(dpht, last) : NULL;
+    if (!source) {
+        if (target) {
+            dpht_publish_table(dpht, split, target, 0);
         }
-        pht_delete(oldTable); // Free the old table
+        trace_ring_record(dpht->context.trace, TRACE_MERGE_END, 0, split, oldCapacity, oldCapacity);
+        return 0; // Memory allocation failure
     }
-    // Replace the old tables with the new ones
-    free(dpht->tables);
-    dpht->tables = newTables;
-    dpht->capacity = newCapacity;
+
+    // Move every pair of the last bucket into its split partner. Readers
+    // keep using the published buckets meanwhile, so the index builds this
+    // may run stay outside the seqlock section
+    int keys = source->size - source->tombstones;
+    if (pht_move_entries(source, target, dpht_moves_all, NULL) < keys) {
+        // A pair could not be inserted: hand back what moved, under the old
+        // layout. Both versions may have dropped their shared MPH, so they
+        // are published rather than discarded; each holds the same keys as
+        // the version it replaces.
+        pht_move_entries(target, source, dpht_moves_on_merge, dpht);
+        dpht_publish_table(dpht, last, source, 1);
+        dpht_publish_table(dpht, split, target, 1);
+        trace_ring_record(dpht->context.trace, TRACE_MERGE_END, 0, split, oldCapacity, oldCapacity);
+        return 0;
+    }
+    PHT* dropped = dpht->tables[last];
+    dpht_layout_begin(dpht);
+    dpht_publish_table(dpht, split, target, 1);
+    __atomic_store_n(&dpht->base, base, __ATOMIC_RELAXED);
+    __atomic_store_n(&dpht->split, split, __ATOMIC_RELAXED);
+    __atomic_store_n(&dpht->capacity, last, __ATOMIC_RELAXED);
+
+    // Halve the directory array once it is mostly unused
+    if (dpht->allocated / 2 >= dpht->min_capacity && dpht->capacity <= dpht->allocated / 4) {
+        dpht_resize_directory(dpht, dpht->allocated / 2);
+    }
+    dpht_layout_end(dpht);
+    if (!dpht->concurrent) {
+        pht_delete(source);
+        if (dpht->allocated > last) {
+            dpht->tables[last] = NULL;
+        }
+    }
+    else {
+        // Readers of the old layout may still probe the last bucket: retire it
+        pht_delete_shell(source);
+        epoch_retire(dpht->context.epoch, dropped, dpht_free_retired_table, NULL);
+    }
+    PHT_COUNT(dpht->context.counters, merges, 1);
+    trace_ring_record(dpht->context.trace, TRACE_MERGE_END, 0, split, oldCapacity, dpht->capacity);
+    return 1;
 }
 
 int dpht_insert(DPHT* dpht, char* key, char* value) {
@@ -124,34 +783,385 @@ int dpht_insert(DPHT* dpht, char* key, char* value) {
     if (!dpht || !key || !value) {
         return 0;
     }
+    return dpht_insert_n(dpht, key, strlen(key), value, strlen(value));
+}
+
+/** Stores a key with a single probe of its bucket.
+ *
+ * The bucket and the key's slot are resolved once: an existing pair is
+ * updated where it is (or kept), a missing key is appended to the bucket.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the value bytes.
+ * \param value_len Number of bytes in the value.
+ * \param overwrite If nonzero, an existing pair takes the value; otherwise it
+ *                  is left unchanged.
+ * \param inserted If not NULL, receives 1 if the key was new, 0 otherwise.
+ * \returns The pair holding the key, or NULL on failure. In a concurrent DPHT
+ *          an overwritten pair is replaced, so the result only reports success.
+ */
+static pair_t* dpht_store(DPHT* dpht, const void* key, size_t key_len, const void* value,
+                          size_t value_len, int overwrite, int* inserted) {
+    if (!dpht_key_fits(dpht, key_len)) {
+        return NULL; // Not a key of the table's fixed width
+    }
 
     // Compute the hash value and map it to the appropriate table index
-    size_t hashValue = dpht_hash(key);
-    int index = hashValue % dpht->capacity;
+    uint64_t hashValue = dpht_hash(dpht, key, key_len);
+    dpht_write_begin(dpht);
+    int index = dpht_index(dpht, hashValue);
+    PHT* table = dpht_writable_table(dpht, index);
+    if (!table) {
+        dpht_write_end(dpht);
+        return NULL; // Memory allocation failure
+    }
 
-    // If the key already exists, update the value
-    PHT* table = dpht->tables[index];
-    if (pht_lookup(table, key)) {
-        return pht_update(table, key, value);
+    // If the key already exists, update the value of the pair just found
+    PHT_COUNT(dpht->context.counters, probes, 1);
+    pair_t* pair = pht_find_n(table, key, key_len, hashValue);
+    if (pair) {
+        int status = 1;
+        if (overwrite) {
+            // Concurrent readers may be reading the value: swap in a new pair instead
+            status = dpht->concurrent ? pht_update_n(table, key, key_len, hashValue, value, value_len)
+                                      : pair_update_value_n(dpht->context.arena, pair, value, value_len);
+        }
+        dpht_publish_table(dpht, index, table, overwrite && status);
+        dpht_write_end(dpht);
+        if (inserted) {
+            *inserted = 0;
+        }
+        return status ? pair : NULL;
     }
 
     // If the key does not exist, create a new pair and insert it
-    pair_t* newPair = pair_create(key, value);
-    if (!newPair) {
+    pair = pair_create_n(dpht->context.arena, key, key_len, value, value_len, hashValue);
+    int status = pair ? pht_insert(table, pair) : 0;
+    dpht_publish_table(dpht, index, table, status);
+    if (status) { // Successful insertion
+        dpht->size++;
+
+        // Check the load factor and split a bounded number of buckets if necessary
+        uint64_t splitStart = dpht->tuner ? dpht_clock_ns() : 0;
+        for (int i = 0; i < SPLITS_PER_INSERT; i++) {
+            float currentLoad = (float)dpht->size / dpht->capacity;
+            if (currentLoad <= dpht->max_load || !dpht_split_bucket(dpht)) {
+                break;
+            }
+        }
+
+        // Charge the splits to the load controller's window
+        if (dpht->tuner) {
+            dpht->tuner->split_ns += dpht_clock_ns() - splitStart;
+            if (++dpht->tuner->inserts >= TUNER_WINDOW) {
+                dpht_tuner_decide(dpht);
+            }
+        }
+    }
+    else if (pair) {
+        pair_free_in(dpht->context.arena, pair);
+        pair = NULL;
+    }
+    dpht_write_end(dpht);
+    if (inserted) {
+        *inserted = status;
+    }
+    return pair;
+}
+
+int dpht_insert_n(DPHT* dpht, const void* key, size_t key_len, const void* value, size_t value_len) {
+    // Validate input parameters
+    if (!dpht || !key || !value) {
+        return 0;
+    }
+    return dpht_store(dpht, key, key_len, value, value_len, 1, NULL) ? 1 : 0;
+}
+
+pair_t* dpht_upsert(DPHT* dpht, const char* key, const char* value) {
+    // Validate input parameters
+    if (!dpht || !key || !value) {
+        return NULL;
+    }
+    return dpht_upsert_n(dpht, key, strlen(key), value, strlen(value));
+}
+
+pair_t* dpht_upsert_n(DPHT* dpht, const void* key, size_t key_len, const void* value, size_t value_len) {
+    // Validate input parameters
+    if (!dpht || !key || !value || dpht->concurrent) {
+        return NULL;
+    }
+    return dpht_store(dpht, key, key_len, value, value_len, 1, NULL);
+}
+
+pair_t* dpht_get_or_insert(DPHT* dpht, const char* key, int* inserted) {
+    // Validate input parameters
+    if (!dpht || !key) {
+        return NULL;
+    }
+    return dpht_get_or_insert_n(dpht, key, strlen(key), "", 0, inserted);
+}
+
+pair_t* dpht_get_or_insert_n(DPHT* dpht, const void* key, size_t key_len,
+                             const void* value, size_t value_len, int* inserted) {
+    // Validate input parameters
+    if (!dpht || !key || !value || dpht->concurrent) {
+        return NULL;
+    }
+    return dpht_store(dpht, key, key_len, value, value_len, 0, inserted);
+}
+
+int dpht_set_value(DPHT* dpht, pair_t* pair, const void* value, size_t value_len) {
+    // Validate input parameters
+    if (!dpht || !pair || !value || dpht->concurrent) {
+        return 0;
+    }
+    return pair_update_value_n(dpht->context.arena, pair, value, value_len);
+}
+
+/** State shared by the parallel phases of dpht_insert_batch().
+ *
+ * \param dpht Pointer to the DPHT being loaded.
+ * \param keys Keys of the batch.
+ * \param values Values of the batch.
+ * \param hashes Hash of every key.
+ * \param buckets Bucket of every key, or -1 for skipped pairs.
+ * \param starts Offset of every bucket's pairs in the pairs array.
+ * \param added Number of new pairs of every bucket; negated if inserting them fails.
+ * \param pairs New pairs, grouped by bucket.
+ * \param order Indices of the keys, grouped by bucket.
+ */
+typedef struct DPHTBatch {
+    DPHT* dpht;
+    const char** keys;
+    const char** values;
+    uint64_t* hashes;
+    int* buckets;
+    size_t* starts;
+    int* added;
+    pair_t** pairs;
+    size_t* order;
+} dpht_batch_t;
+
+/** Frees the scratch arrays of a batch insert.
+ *
+ * \param batch Pointer to the batch state.
+ */
+static void dpht_batch_release(dpht_batch_t* batch) {
+    free(batch->hashes);
+    free(batch->buckets);
+    free(batch->starts);
+    free(batch->added);
+    free(batch->pairs);
+    free(batch->order);
+}
+
+/** Parallel phase of a batch insert: hashes a chunk of keys.
+ *
+ * \param begin First key of the chunk.
+ * \param end One past the last key of the chunk.
+ * \param arg Pointer to the dpht_batch_t.
+ */
+static void dpht_batch_hash(size_t begin, size_t end, void* arg) {
+    dpht_batch_t* batch = (dpht_batch_t*)arg;
+    for (size_t i = begin; i < end; i++) {
+        batch->buckets[i] = -1;
+        if (!batch->keys[i] || !batch->values[i]) {
+            continue;
+        }
+        size_t len = strlen(batch->keys[i]);
+        if (!dpht_key_fits(batch->dpht, len)) {
+            continue;
+        }
+        batch->hashes[i] = dpht_hash(batch->dpht, batch->keys[i], len);
+        batch->buckets[i] = dpht_index(batch->dpht, batch->hashes[i]);
+    }
+}
+
+/** Parallel phase of a batch insert: hands a chunk of buckets their new pairs.
+ *
+ * Each bucket builds its MPH here, so the builds run on every pool thread.
+ *
+ * \param begin First bucket of the chunk.
+ * \param end One past the last bucket of the chunk.
+ * \param arg Pointer to the dpht_batch_t.
+ */
+static void dpht_batch_insert(size_t begin, size_t end, void* arg) {
+    dpht_batch_t* batch = (dpht_batch_t*)arg;
+    for (size_t b = begin; b < end; b++) {
+        if (batch->added[b] > 0 &&
+            !pht_insert_batch(batch->dpht->tables[b], batch->pairs + batch->starts[b], batch->added[b])) {
+            batch->added[b] = -batch->added[b];
+        }
+    }
+}
+
+size_t dpht_insert_batch(DPHT* dpht, const char** keys, const char** values, size_t n) {
+    // Validate input parameters
+    if (!dpht || !keys || !values || n == 0) {
+        return 0;
+    }
+
+    // Concurrent readers need every bucket change published copy-on-write
+    if (dpht->concurrent) {
+        size_t stored = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (keys[i] && values[i]) {
+                stored += dpht_insert_n(dpht, keys[i], strlen(keys[i]), values[i], strlen(values[i]));
+            }
+        }
+        return stored;
+    }
+
+    // Grow the directory for the whole batch before partitioning it
+    while ((double)(dpht->size + n) / dpht->capacity > dpht->max_load) {
+        if (!dpht_split_bucket(dpht)) {
+            break; // Keep going with a higher load factor
+        }
+    }
+
+    dpht_batch_t batch;
+    batch.dpht = dpht;
+    batch.keys = keys;
+    batch.values = values;
+    batch.hashes = malloc(sizeof(uint64_t) * n);
+    batch.buckets = malloc(sizeof(int) * n);
+    batch.starts = calloc((size_t)dpht->capacity + 1, sizeof(size_t));
+    batch.added = calloc((size_t)dpht->capacity, sizeof(int));
+    batch.pairs = malloc(sizeof(pair_t*) * n);
+    batch.order = malloc(sizeof(size_t) * n);
+    if (!batch.hashes || !batch.buckets || !batch.starts || !batch.added || !batch.pairs || !batch.order) {
+        dpht_batch_release(&batch);
         return 0; // Memory allocation failure
     }
 
-    int status = pht_insert(table, newPair);
-    if (status) { // Successful insertion
-        dpht->size++;
+    // Hash every key, then count the keys of each bucket
+    thread_pool_parallel_for(dpht->pool, n, BATCH_HASH_GRAIN, dpht_batch_hash, &batch);
+    for (size_t i = 0; i < n; i++) {
+        if (batch.buckets[i] >= 0) {
+            batch.starts[batch.buckets[i] + 1]++;
+        }
+    }
 
-        // Check the load factor and rehash if necessary
-        float currentLoad = (float)dpht->size / dpht->capacity;
-        if (currentLoad > LOAD_FACTOR_THRESHOLD) {
-            dpht_rehash(dpht);
+    // Partition the keys by bucket, keeping their order within each bucket
+    for (int b = 0; b < dpht->capacity; b++) {
+        batch.starts[b + 1] += batch.starts[b];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (batch.buckets[i] >= 0) {
+            batch.order[batch.starts[batch.buckets[i]]++] = i;
+        }
+    }
+    // Shift the bucket starts back after using them as cursors
+    for (int b = dpht->capacity; b > 0; b--) {
+        batch.starts[b] = batch.starts[b - 1];
+    }
+    batch.starts[0] = 0;
+
+    // Update existing keys and create the new pairs (the arena is single-threaded)
+    size_t stored = 0;
+    for (int b = 0; b < dpht->capacity; b++) {
+        PHT* table = dpht->tables[b];
+        pair_t** pairs = batch.pairs + batch.starts[b];
+        int count = 0;
+
+        for (size_t k = batch.starts[b]; k < batch.starts[b + 1]; k++) {
+            size_t i = batch.order[k];
+            size_t keyLen = strlen(keys[i]);
+            size_t valueLen = strlen(values[i]);
+
+            // Existing keys are updated in place
+            if (pht_search_n(table, keys[i], keyLen, batch.hashes[i], NULL)) {
+                stored += pht_update_n(table, keys[i], keyLen, batch.hashes[i], values[i], valueLen);
+                continue;
+            }
+
+            // Repeated keys of the batch keep their last value
+            int j;
+            for (j = 0; j < count; j++) {
+                if (pair_matches(pairs[j], keys[i], keyLen, batch.hashes[i])) {
+                    break;
+                }
+            }
+            if (j < count) {
+                stored += pair_update_value_n(dpht->context.arena, pairs[j], values[i], valueLen);
+                continue;
+            }
+
+            pair_t* newPair = pair_create_n(dpht->context.arena, keys[i], keyLen,
+                                            values[i], valueLen, batch.hashes[i]);
+            if (newPair) {
+                pairs[count++] = newPair;
+            }
+        }
+        batch.added[b] = count;
+    }
+
+    // Hand every bucket its new pairs in one go, building the MPHs in parallel
+    thread_pool_parallel_for(dpht->pool, (size_t)dpht->capacity, BATCH_BUCKET_GRAIN,
+                             dpht_batch_insert, &batch);
+    for (int b = 0; b < dpht->capacity; b++) {
+        if (batch.added[b] > 0) {
+            dpht->size += batch.added[b];
+            stored += batch.added[b];
+        }
+        // A bucket that rejected its pairs leaves them to be released here
+        for (int k = 0; k < -batch.added[b]; k++) {
+            pair_free_in(dpht->context.arena, batch.pairs[batch.starts[b] + k]);
+        }
+    }
+
+    dpht_batch_release(&batch);
+    return stored;
+}
+
+/** Lock-free lookup in a concurrent DPHT.
+ *
+ * The directory layout is read under its seqlock, then the bucket version
+ * current at that point is searched without any lock. Bucket versions are
+ * immutable once published, so a hit is always valid; a miss is only trusted
+ * if no split moved keys between buckets in the meantime.
+ *
+ * \param dpht Pointer to a concurrent DPHT (inside a read section).
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hashValue Hash of the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \param probed Receives the bucket version searched last.
+ * \returns Pointer to the value bytes if found, NULL otherwise.
+ */
+static void* dpht_search_concurrent(DPHT* dpht, const void* key, size_t key_len,
+                                    uint64_t hashValue, size_t* value_len, PHT** probed) {
+    while (1) {
+        unsigned int seq = __atomic_load_n(&dpht->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue; // A split or merge is publishing its layout
+        }
+        uint64_t base = (uint64_t)__atomic_load_n(&dpht->base, __ATOMIC_RELAXED);
+        uint64_t split = (uint64_t)__atomic_load_n(&dpht->split, __ATOMIC_RELAXED);
+        PHT** tables = __atomic_load_n(&dpht->tables, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&dpht->seq, __ATOMIC_RELAXED) != seq) {
+            continue; // Torn read of the layout
+        }
+
+        uint64_t index = hashValue & (base - 1);
+        if (index < split) {
+            index = hashValue & (base * 2 - 1);
+        }
+        PHT* table = __atomic_load_n(&tables[index], __ATOMIC_ACQUIRE);
+        *probed = table;
+        void* value = pht_search_n(table, key, key_len, hashValue, value_len);
+        if (value) {
+            return value;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&dpht->seq, __ATOMIC_RELAXED) == seq) {
+            return NULL; // No split happened: the key is really absent
         }
     }
-    return status;
 }
 
 char* dpht_search(DPHT* dpht, char* key) {
@@ -159,13 +1169,208 @@ char* dpht_search(DPHT* dpht, char* key) {
     if (!dpht || !key) {
         return NULL;
     }
+    return (char*)dpht_search_n(dpht, key, strlen(key), NULL);
+}
 
+/** Looks up a binary key (see dpht_search_n()).
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \param probed Receives the bucket (version) searched.
+ * \returns Pointer to the value bytes if found, NULL otherwise.
+ */
+static void* dpht_search_key(DPHT* dpht, const void* key, size_t key_len, size_t* value_len,
+                             PHT** probed) {
     // Compute the hash value and map it to the appropriate table index
-    size_t hashValue = dpht_hash(key);
-    int index = hashValue % dpht->capacity;
+    uint64_t hashValue = dpht_hash(dpht, key, key_len);
+    void* value;
+    if (dpht->concurrent) {
+        value = dpht_search_concurrent(dpht, key, key_len, hashValue, value_len, probed);
+    }
+    else {
+        // Delegate the search to the appropriate PHT
+        *probed = dpht->tables[dpht_index(dpht, hashValue)];
+        value = pht_search_n(*probed, key, key_len, hashValue, value_len);
+    }
+    PHT_COUNT(dpht->context.counters, probes, 1);
+    PHT_COUNT(dpht->context.counters, hits, value != NULL);
+    PHT_COUNT(dpht->context.counters, misses, value == NULL);
+    return value;
+}
+
+void* dpht_search_n(DPHT* dpht, const void* key, size_t key_len, size_t* value_len) {
+    // Validate input parameters
+    if (!dpht || !key || !dpht_key_fits(dpht, key_len)) {
+        return NULL;
+    }
+    PHT* probed;
+    if (!dpht->tuner || ++dpht_lookup_tick % TUNER_SAMPLE_INTERVAL != 0) {
+        return dpht_search_key(dpht, key, key_len, value_len, &probed);
+    }
 
-    // Delegate the search to the appropriate PHT
-    return pht_search(dpht->tables[index], key);
+    // Time this lookup for the load controller; it stands for the whole interval
+    uint64_t start = dpht_clock_ns();
+    void* value = dpht_search_key(dpht, key, key_len, value_len, &probed);
+    uint64_t elapsed = dpht_clock_ns() - start;
+    dpht_tuner_sample(dpht->tuner, 1, (uint64_t)(probed->size - probed->tombstones), elapsed, 1);
+    return value;
+}
+
+/** Looks up one chunk of a burst through the staged pipeline.
+ *
+ * \param dpht Pointer to a DPHT without concurrent readers.
+ * \param keys Array of count key pointers (NULL entries are misses).
+ * \param lengths Number of bytes of each key.
+ * \param count Number of keys, at most SEARCH_BATCH_CHUNK.
+ * \param out Array of count pointers receiving each value, or NULL when not found.
+ * \returns The number of keys found.
+ */
+static size_t dpht_search_chunk(DPHT* dpht, const void** keys, const size_t* lengths,
+                                size_t count, void** out) {
+    // Time the chunk for the load controller if it crosses a sampling point
+    unsigned int intervals = 0;
+    uint64_t start = 0;
+    if (dpht->tuner) {
+        unsigned int before = dpht_lookup_tick;
+        dpht_lookup_tick += (unsigned int)count;
+        intervals = dpht_lookup_tick / TUNER_SAMPLE_INTERVAL - before / TUNER_SAMPLE_INTERVAL;
+        start = intervals ? dpht_clock_ns() : 0;
+    }
+
+    uint64_t hashes[SEARCH_BATCH_CHUNK];
+    PHT* tables[SEARCH_BATCH_CHUNK];
+    int slots[SEARCH_BATCH_CHUNK];
+    size_t found = 0;
+    size_t probed = 0;
+
+    // Stage 1: hash every key and prefetch its bucket header
+    for (size_t i = 0; i < count; i++) {
+        probed += (keys[i] != NULL);
+        hashes[i] = keys[i] ? dpht_hash(dpht, keys[i], lengths[i]) : 0;
+        tables[i] = dpht->tables[dpht_index(dpht, hashes[i])];
+        __builtin_prefetch(tables[i]);
+    }
+
+    // Stage 2: install finished rebuilds so that no slot moves until stage 5
+    for (size_t i = 0; i < count; i++) {
+        pht_sync(tables[i]);
+        if (tables[i]->mph) {
+            __builtin_prefetch(tables[i]->mph);
+        }
+    }
+
+    // Stage 3: evaluate every MPH and prefetch the candidate slots
+    for (size_t i = 0; i < count; i++) {
+        slots[i] = keys[i] ? pht_probe(tables[i], keys[i], lengths[i], hashes[i]) : -1;
+    }
+
+    // Stage 4: prefetch the candidate pairs whose fingerprints match
+    for (size_t i = 0; i < count; i++) {
+        pht_prefetch_candidate(tables[i], slots[i], hashes[i]);
+    }
+
+    // Stage 5: compare the keys
+    for (size_t i = 0; i < count; i++) {
+        out[i] = NULL;
+        if (keys[i]) {
+            out[i] = pht_search_candidate(tables[i], slots[i], keys[i], lengths[i], hashes[i], NULL);
+        }
+        if (out[i]) {
+            found++;
+        }
+    }
+    PHT_COUNT(dpht->context.counters, probes, probed);
+    PHT_COUNT(dpht->context.counters, hits, found);
+    PHT_COUNT(dpht->context.counters, misses, probed - found);
+    if (intervals && probed > 0) {
+        uint64_t elapsed = dpht_clock_ns() - start;
+        uint64_t keys = 0;
+        for (size_t i = 0; i < count; i++) {
+            keys += (uint64_t)(tables[i]->size - tables[i]->tombstones);
+        }
+        dpht_tuner_sample(dpht->tuner, count, keys, elapsed, intervals);
+    }
+    return found;
+}
+
+size_t dpht_search_batch(DPHT* dpht, const char** keys, size_t n, char** out) {
+    // Validate input parameters
+    if (!dpht || !keys || !out) {
+        return 0;
+    }
+
+    // Concurrent readers cannot hold bucket slots across stages: look up one by one
+    if (dpht->concurrent) {
+        size_t found = 0;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = keys[i] ? (char*)dpht_search_n(dpht, keys[i], strlen(keys[i]), NULL) : NULL;
+            found += (out[i] != NULL);
+        }
+        return found;
+    }
+
+    const void* chunk[SEARCH_BATCH_CHUNK];
+    size_t lengths[SEARCH_BATCH_CHUNK];
+    void* values[SEARCH_BATCH_CHUNK];
+    size_t found = 0;
+
+    for (size_t start = 0; start < n; start += SEARCH_BATCH_CHUNK) {
+        size_t count = n - start;
+        if (count > SEARCH_BATCH_CHUNK) {
+            count = SEARCH_BATCH_CHUNK;
+        }
+        for (size_t i = 0; i < count; i++) {
+            chunk[i] = keys[start + i];
+            lengths[i] = chunk[i] ? strlen(keys[start + i]) : 0;
+            if (chunk[i] && !dpht_key_fits(dpht, lengths[i])) {
+                chunk[i] = NULL; // Not a key of the table's fixed width
+            }
+        }
+        found += dpht_search_chunk(dpht, chunk, lengths, count, values);
+        for (size_t i = 0; i < count; i++) {
+            out[start + i] = (char*)values[i];
+        }
+    }
+    return found;
+}
+
+size_t dpht_search_batch_n(DPHT* dpht, const void* keys, size_t n, void** out) {
+    // Validate input parameters
+    if (!dpht || !keys || !out || dpht->key_width == 0) {
+        return 0;
+    }
+
+    const char* bytes = (const char*)keys;
+    size_t width = (size_t)dpht->key_width;
+
+    // Concurrent readers cannot hold bucket slots across stages: look up one by one
+    if (dpht->concurrent) {
+        size_t found = 0;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = dpht_search_n(dpht, bytes + i * width, width, NULL);
+            found += (out[i] != NULL);
+        }
+        return found;
+    }
+
+    const void* chunk[SEARCH_BATCH_CHUNK];
+    size_t lengths[SEARCH_BATCH_CHUNK];
+    size_t found = 0;
+
+    for (size_t start = 0; start < n; start += SEARCH_BATCH_CHUNK) {
+        size_t count = n - start;
+        if (count > SEARCH_BATCH_CHUNK) {
+            count = SEARCH_BATCH_CHUNK;
+        }
+        for (size_t i = 0; i < count; i++) {
+            chunk[i] = bytes + (start + i) * width;
+            lengths[i] = width;
+        }
+        found += dpht_search_chunk(dpht, chunk, lengths, count, out + start);
+    }
+    return found;
 }
 
 int dpht_update(DPHT* dpht, char* key, char* new_value) {
@@ -173,21 +1378,29 @@ int dpht_update(DPHT* dpht, char* key, char* new_value) {
     if (!dpht || !key || !new_value) {
         return 0;
     }
+    return dpht_update_n(dpht, key, strlen(key), new_value, strlen(new_value));
+}
 
-    // Locate the PHT bucket for the given key
-    size_t hashValue = dpht_hash(key);
-    int index = hashValue % dpht->capacity;
-    PHT* table = dpht->tables[index];
-
-    // Special case: optimize for size-1 table with no MPH
-    if (table->size == 1 && table->mph == NULL) {
-        if (strcmp(table->entries[0]->key, key) == 0)
-            return pair_update_value(table->entries[0], new_value);
+int dpht_update_n(DPHT* dpht, const void* key, size_t key_len, const void* new_value, size_t value_len) {
+    // Validate input parameters
+    if (!dpht || !key || !new_value || !dpht_key_fits(dpht, key_len)) {
         return 0;
     }
 
+    // Locate the PHT bucket for the given key
+    uint64_t hashValue = dpht_hash(dpht, key, key_len);
+    dpht_write_begin(dpht);
+    int index = dpht_index(dpht, hashValue);
+    PHT* table = dpht_writable_table(dpht, index);
+
     // Delegate the update to the appropriate PHT
-    return pht_update(table, key, new_value);
+    PHT_COUNT(dpht->context.counters, probes, 1);
+    int status = table ? pht_update_n(table, key, key_len, hashValue, new_value, value_len) : 0;
+    if (table) {
+        dpht_publish_table(dpht, index, table, status);
+    }
+    dpht_write_end(dpht);
+    return status;
 }
 
 int dpht_lookup(DPHT* dpht, char* key) {
@@ -199,17 +1412,187 @@ void dpht_remove_entry(DPHT* dpht, char* key) {
     if (!dpht || !key) {
         return;
     }
+    dpht_remove_n(dpht, key, strlen(key));
+}
+
+int dpht_remove_n(DPHT* dpht, const void* key, size_t key_len) {
+    // Validate input parameters
+    if (!dpht || !key || !dpht_key_fits(dpht, key_len)) {
+        return 0;
+    }
 
     // Locate the PHT bucket for the given key
-    size_t hashValue = dpht_hash(key);
-    int index = hashValue % dpht->capacity;
-    PHT* table = dpht->tables[index];
+    uint64_t hashValue = dpht_hash(dpht, key, key_len);
+    dpht_write_begin(dpht);
+    int index = dpht_index(dpht, hashValue);
+    PHT* table = dpht_writable_table(dpht, index);
 
     // If the key exists in the table, delete it and decrement size
-    if (pht_lookup(table, key)) {
-        pht_remove_entry(table, key);
+    PHT_COUNT(dpht->context.counters, probes, 1);
+    int status = table ? pht_remove_n(table, key, key_len, hashValue) : 0;
+    if (table) {
+        dpht_publish_table(dpht, index, table, status);
+    }
+    if (status) {
         dpht->size--;
+
+        // Merge a bounded number of buckets once the load has fallen far enough
+        for (int i = 0; i < MERGES_PER_REMOVE; i++) {
+            double currentLoad = (double)dpht->size / dpht->capacity;
+            if (currentLoad >= dpht->shrink_ratio * dpht->max_load || !dpht_merge_bucket(dpht)) {
+                break;
+            }
+        }
     }
+    dpht_write_end(dpht);
+    return status;
+}
+
+int dpht_compact(DPHT* dpht) {
+    // Validate input parameters
+    if (!dpht) {
+        return 0;
+    }
+    dpht_write_begin(dpht);
+
+    // Merge buckets as long as the load stays within the split threshold
+    while (dpht->capacity > dpht->min_capacity &&
+           (double)dpht->size / (dpht->capacity - 1) <= dpht->max_load) {
+        if (!dpht_merge_bucket(dpht)) {
+            break;
+        }
+    }
+
+    // Index every bucket from scratch and trim its arrays
+    int status = 1;
+    for (int b = 0; b < dpht->capacity; b++) {
+        PHT* table = dpht_writable_table(dpht, b);
+        if (!table) {
+            status = 0; // Memory allocation failure, the bucket stays as it is
+            continue;
+        }
+        status &= pht_repack(table);
+        dpht_publish_table(dpht, b, table, 1);
+    }
+
+    // Give back the directory slots beyond the buckets in use
+    if (dpht->allocated > dpht->capacity && !dpht_resize_directory(dpht, dpht->capacity)) {
+        status = 0;
+    }
+    dpht_write_end(dpht);
+    return status;
+}
+
+epoch_reader_t* dpht_reader_register(DPHT* dpht) {
+    if (!dpht || !dpht->concurrent) {
+        return NULL; // Only concurrent DPHTs have readers
+    }
+    return epoch_register(dpht->context.epoch);
+}
+
+void dpht_reader_unregister(epoch_reader_t* reader) {
+    epoch_unregister(reader);
+}
+
+void dpht_read_begin(epoch_reader_t* reader) {
+    if (reader) {
+        epoch_enter(reader);
+    }
+}
+
+void dpht_read_end(epoch_reader_t* reader) {
+    if (reader) {
+        epoch_exit(reader);
+    }
+}
+
+/** Returns the histogram bin of a bucket size (see dpht_stats_t).
+ *
+ * \param keys Keys in the bucket.
+ * \returns The bin index.
+ */
+static int dpht_histogram_bin(size_t keys) {
+    int bin = 0;
+    while (keys > 0 && bin < DPHT_STATS_HISTOGRAM_BINS - 1) {
+        keys >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+int dpht_get_stats(DPHT* dpht, dpht_stats_t* stats) {
+    // Validate input parameters
+    if (!dpht || !stats) {
+        return 0;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    // Sum the event counters over the stripes
+    const pht_counters_t* stripes = dpht->context.counters;
+    stats->counters_enabled = (stripes != NULL);
+    for (int i = 0; stripes && i < PHT_COUNTER_STRIPES; i++) {
+        const pht_counters_t* stripe = &stripes[i];
+        stats->rebuilds += __atomic_load_n(&stripe->rebuilds, __ATOMIC_RELAXED);
+        stats->cmph_builds += __atomic_load_n(&stripe->cmph_builds, __ATOMIC_RELAXED);
+        stats->seed_builds += __atomic_load_n(&stripe->seed_builds, __ATOMIC_RELAXED);
+        stats->fks_builds += __atomic_load_n(&stripe->fks_builds, __ATOMIC_RELAXED);
+        stats->rebuild_failures += __atomic_load_n(&stripe->rebuild_failures, __ATOMIC_RELAXED);
+        stats->rebuild_ns += __atomic_load_n(&stripe->rebuild_ns, __ATOMIC_RELAXED);
+        uint64_t longest = __atomic_load_n(&stripe->rebuild_max_ns, __ATOMIC_RELAXED);
+        if (longest > stats->rebuild_max_ns) {
+            stats->rebuild_max_ns = longest;
+        }
+        stats->compactions += __atomic_load_n(&stripe->compactions, __ATOMIC_RELAXED);
+        stats->splits += __atomic_load_n(&stripe->splits, __ATOMIC_RELAXED);
+        stats->merges += __atomic_load_n(&stripe->merges, __ATOMIC_RELAXED);
+        stats->probes += __atomic_load_n(&stripe->probes, __ATOMIC_RELAXED);
+        stats->hits += __atomic_load_n(&stripe->hits, __ATOMIC_RELAXED);
+        stats->misses += __atomic_load_n(&stripe->misses, __ATOMIC_RELAXED);
+    }
+
+    // Walk the buckets for their shape and memory, keeping writers out
+    dpht_write_begin(dpht);
+    pht_usage_t total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < dpht->capacity; i++) {
+        size_t before = total.keys;
+        pht_add_usage(dpht->tables[i], &total);
+        size_t keys = total.keys - before;
+        stats->histogram[dpht_histogram_bin(keys)]++;
+        if (keys > stats->largest_bucket) {
+            stats->largest_bucket = keys;
+        }
+    }
+    stats->size = (size_t)dpht->size;
+    stats->buckets = (size_t)dpht->capacity;
+    stats->tombstones = total.tombstones;
+    stats->staged = total.staged;
+    stats->pending_rebuilds = total.pending;
+    stats->directory_bytes = sizeof(PHT*) * (size_t)dpht->allocated + total.table_bytes;
+    stats->entries_bytes = total.entries_bytes;
+    stats->pair_bytes = total.pair_bytes;
+    stats->key_bytes = total.key_bytes;
+    stats->value_bytes = total.value_bytes;
+    stats->mph_bytes = total.mph_bytes;
+    stats->arena_bytes = dpht->context.arena ? arena_reserved_bytes(dpht->context.arena) : 0;
+    stats->max_load = dpht->max_load;
+    if (dpht->tuner) {
+        stats->build_ns_per_key = dpht->tuner->build_ns_per_key;
+        stats->lookup_ns = dpht->tuner->lookup_avg_ns;
+    }
+    dpht_write_end(dpht);
+
+    stats->total_bytes = stats->directory_bytes + stats->entries_bytes + stats->pair_bytes +
+                         stats->key_bytes + stats->value_bytes + stats->mph_bytes;
+    return 1;
+}
+
+int dpht_trace_dump(DPHT* dpht, FILE* out) {
+    // Validate input parameters
+    if (!dpht || !out || !dpht->context.trace) {
+        return 0;
+    }
+    return trace_ring_write_chrome(dpht->context.trace, out);
 }
 
 void dpht_free(DPHT* dpht) {
@@ -222,6 +1605,24 @@ void dpht_free(DPHT* dpht) {
         pht_delete(dpht->tables[i]);
     }
 
+    // Free the bucket versions, pairs and MPHs still waiting for readers
+    epoch_destroy(dpht->context.epoch);
+    if (dpht->concurrent) {
+        pthread_mutex_destroy(&dpht->write_lock);
+    }
+
+    // Stop the worker once no bucket can reference its jobs anymore
+    rebuild_worker_destroy(dpht->context.worker);
+    thread_pool_destroy(dpht->pool);
+
+    // Release every pair allocated from the arena at once
+    arena_destroy(dpht->context.arena);
+
+    // The worker and the pool counted into these until they stopped
+    free(dpht->context.counters);
+    trace_ring_destroy(dpht->context.trace);
+    free(dpht->tuner);
+
     // Free the array of PHT pointers and the DPHT structure itself
     free(dpht->tables);
     free(dpht);
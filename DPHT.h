@@ -3,39 +3,261 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include "PHT.h"
 #include "pair.h"
+#include "hash.h"
+#include "thread_pool.h"
+#include "epoch.h"
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure for the adaptive load controller of a DPHT. */
+typedef struct DPHTTuner dpht_tuner_t;
 
 /** Structure for the dynamic perfect hash table (DPHT).
+ *
+ * The DPHT grows by linear hashing: instead of doubling all at once, one
+ * bucket at a time is split in round-robin order. A key with hash h lives in
+ * bucket h % base, or in bucket h % (2 * base) if that bucket has already been
+ * split in the current round (i.e. is below the split pointer). The base is
+ * a power of two, so both moduli are computed with a mask. After mass
+ * removals it shrinks the same way in reverse, merging the last bucket back
+ * into the bucket it was split from.
  *
  * \param size The total number of key-value pairs stored in the DPHT.
- * \param capacity The number of PHT tables in the DPHT.
+ * \param capacity The number of PHT tables in the DPHT (base + split).
  * \param tables the array of PHT pointers
+ * \param base Number of buckets at the start of the current split round (a power of two).
+ * \param split Index of the next bucket to split.
+ * \param allocated Number of slots allocated in the tables array.
+ * \param min_capacity Number of buckets the DPHT never shrinks below (its
+ *                     initial number of buckets).
+ * \param backend The second-level backend used by every PHT bucket.
+ * \param bucket_capacity Initial entries capacity of every new bucket.
+ * \param max_load Average number of keys per bucket above which buckets split;
+ *                 moved at runtime by the load controller, if any.
+ * \param shrink_ratio Share of max_load below which the average load makes
+ *                     buckets merge, or 0 if the DPHT never shrinks.
+ * \param key_width Width in bytes of every key, or 0 for keys of any length.
+ * \param context Settings and services shared by every PHT bucket.
+ * \param pool Threads used by bulk operations, or NULL to run them on the caller.
+ * \param concurrent 1 if lookups may run concurrently with writers (see dpht_config_t).
+ * \param write_lock Serializes writers of a concurrent DPHT.
+ * \param seq Seqlock counter of the directory layout; odd while a split or
+ *            merge publishes its buckets and the new layout. The keys are
+ *            moved, and the buckets re-indexed, before the counter turns odd.
+ * \param hash The first-level hash function, or NULL for hash_bytes_seeded().
+ * \param seed The seed of the hash function, drawn at random per table by default.
+ * \param mph_policy MPH algorithm of each bucket size (see dpht_config_t).
+ * \param tuner The adaptive load controller, or NULL (see dpht_config_t).
  */
 typedef struct DynamicPerfectHashTable {
     int size;
     int capacity;
     PHT** tables;
+    int base;
+    int split;
+    int allocated;
+    int min_capacity;
+    pht_backend_t backend;
+    int bucket_capacity;
+    double max_load;
+    double shrink_ratio;
+    int key_width;
+    pht_context_t context;
+    thread_pool_t* pool;
+    int concurrent;
+    pthread_mutex_t write_lock;
+    unsigned int seq;
+    hash_fn hash;
+    uint64_t seed;
+    pht_mph_policy_t mph_policy;
+    dpht_tuner_t* tuner;
 } DPHT;
 
+#define DPHT_SEED_RANDOM 0              // dpht_config_t seed asking for a random seed
+#define DPHT_DEFAULT_TABLES 16          // Buckets of a new DPHT (a power of two)
+#define DPHT_DEFAULT_BUCKET_CAPACITY 4  // Initial entries capacity of each bucket
+#define DPHT_DEFAULT_MAX_LOAD 5.0       // Average keys per bucket before splitting
+#define DPHT_ADAPTIVE_MIN_LOAD 1.0      // Default lowest max_load of the load controller
+#define DPHT_ADAPTIVE_MAX_LOAD 32.0     // Default highest max_load of the load controller
+#define DPHT_DEFAULT_SHRINK_RATIO 0.25  // Share of max_load below which buckets merge
+
+/** Options used to create a DPHT.
+ *
+ * Always initialize with dpht_config_init() before changing individual
+ * fields, so that options added later keep their defaults.
+ *
+ * \param initial_tables The number of PHT buckets to start with, rounded up to
+ *                       a power of two. If less than 1, a default value is used.
+ * \param backend The second-level backend of the buckets (PHT_BACKEND_CMPH by default).
+ * \param bucket_capacity Initial entries capacity of every bucket
+ *                        (DPHT_DEFAULT_BUCKET_CAPACITY by default).
+ * \param max_load Average number of keys per bucket above which the DPHT
+ *                 splits buckets (DPHT_DEFAULT_MAX_LOAD by default). Lower
+ *                 values mean smaller, cheaper-to-rebuild buckets and a
+ *                 larger directory.
+ * \param adaptive_load If nonzero, a controller tunes max_load at runtime (0 by
+ *                      default). Every few thousand inserts it measures the
+ *                      time spent on bucket index builds (per key rebuilt),
+ *                      on splits and on sampled lookups (against the size of
+ *                      the bucket probed), and moves max_load a bounded step
+ *                      toward the load at which their sum is lowest: larger
+ *                      buckets cost more to rebuild, more buckets cost more
+ *                      splits and directory memory. New buckets start with
+ *                      room for max_load keys, overriding bucket_capacity.
+ *                      max_load starts from its configured value.
+ * \param adaptive_min_load Lowest max_load the controller may choose
+ *                          (DPHT_ADAPTIVE_MIN_LOAD by default). Each bucket
+ *                          costs about sizeof(PHT) + sizeof(PHT*) plus its MPH,
+ *                          so this bounds the directory's memory per key.
+ * \param adaptive_max_load Highest max_load the controller may choose
+ *                          (DPHT_ADAPTIVE_MAX_LOAD by default), bounding the
+ *                          size of a single bucket rebuild.
+ * \param shrink_ratio Buckets merge back when the average load falls below
+ *                     shrink_ratio * max_load (DPHT_DEFAULT_SHRINK_RATIO by
+ *                     default; 0 disables shrinking). Like splits, merges are
+ *                     incremental: each removal merges at most a couple of
+ *                     buckets, and the directory array is halved once at most
+ *                     a quarter of it is in use. The gap between the two
+ *                     thresholds keeps a table whose size hovers around one
+ *                     of them from splitting and merging the same bucket over
+ *                     and over. The DPHT never shrinks below initial_tables.
+ * \param key_width If nonzero, every key is a fixed-width binary key of exactly
+ *                  this many bytes, such as a flow_key4_t (FLOW_KEY4_WIDTH) or
+ *                  a flow_key6_t (FLOW_KEY6_WIDTH); operations on keys of any
+ *                  other length fail. The flow key widths are hashed by a
+ *                  kernel with the length folded in and compared a word at a
+ *                  time; bursts of keys are looked up with
+ *                  dpht_search_batch_n() (0, any length, by default).
+ * \param delta_threshold Number of staged keys per bucket that triggers an MPH
+ *                        rebuild (PHT_DELTA_THRESHOLD by default).
+ * \param tombstone_percent Share of a bucket's MPH slots, in percent, that
+ *                          removed keys may leave as tombstones before the
+ *                          bucket is compacted and its MPH rebuilt
+ *                          (PHT_TOMBSTONE_PERCENT by default). Higher values
+ *                          trade lookup-free slots for fewer rebuilds.
+ * \param background_rebuild If nonzero, MPH rebuilds run on a background worker
+ *                           thread and lookups never wait for CMPH (0 by default).
+ * \param use_arena If nonzero, pairs and their strings are allocated from
+ *                  size-classed slabs owned by the DPHT, reused on delete and
+ *                  freed in bulk by dpht_free() (0 by default).
+ * \param huge_pages If nonzero (and use_arena is set), arena slabs are backed
+ *                   by huge pages when available (0 by default).
+ * \param threads Number of threads used by bulk operations such as
+ *                dpht_insert_batch(), the caller included. Bucket MPHs are
+ *                built in parallel with work stealing (1 by default).
+ * \param concurrent If nonzero, lookups never take a lock and may run on any
+ *                   number of threads while writers modify the table (0 by
+ *                   default). Readers register with dpht_reader_register() and
+ *                   bracket their lookups with dpht_read_begin() and
+ *                   dpht_read_end(). Writers are serialized by an internal lock
+ *                   and update buckets copy-on-write, publishing each new
+ *                   version with an atomic pointer swap; replaced versions are
+ *                   freed once no reader can see them. MPH rebuilds run on the
+ *                   writer, so background_rebuild is ignored. Whole-table
+ *                   operations such as dpht_freeze() and dpht_save() must not
+ *                   run while a writer is active.
+ * \param trace_events If nonzero, the DPHT records its bucket index builds,
+ *                     splits, merges and build failures, with timestamps and the
+ *                     thread that ran them, in a lock-free ring keeping the
+ *                     last trace_events events (rounded up to a power of
+ *                     two); dpht_trace_dump() writes them out (0, no trace,
+ *                     by default).
+ * \param hash The first-level hash function, or NULL for hash_bytes_seeded()
+ *             (the default). dpht_save() requires the default function.
+ * \param seed The seed of the hash function. DPHT_SEED_RANDOM (the default)
+ *             draws a different random seed for every table, so that key
+ *             sets chosen to collide in one table do not collide in another.
+ * \param mph_policy The MPH algorithm used by CMPH buckets of each size, set
+ *                   up with pht_mph_policy_init() and pht_mph_policy_add_tier().
+ *                   The default uses CHD for every bucket; e.g. BDZ for buckets
+ *                   of up to 64 keys builds faster, CHD stays smaller for large
+ *                   buckets. bench_mph compares policies on a workload.
+ */
+typedef struct DPHTConfig {
+    int initial_tables;
+    pht_backend_t backend;
+    int bucket_capacity;
+    double max_load;
+    int adaptive_load;
+    double adaptive_min_load;
+    double adaptive_max_load;
+    double shrink_ratio;
+    int key_width;
+    int delta_threshold;
+    int tombstone_percent;
+    int background_rebuild;
+    int use_arena;
+    int huge_pages;
+    int threads;
+    int concurrent;
+    int trace_events;
+    hash_fn hash;
+    uint64_t seed;
+    pht_mph_policy_t mph_policy;
+} dpht_config_t;
+
+/** Fills a configuration with the default DPHT options.
+ *
+ * \param config Pointer to the configuration to initialize.
+ */
+void dpht_config_init(dpht_config_t* config);
+
 /** Creates a new Dynamic Perfect Hash Table (DPHT).
  *
  * This function allocates and initializes a DPHT structure consisting of
  * an array of smaller PHT (Perfect Hash Table) buckets.
  *
- * \param initialTables The number of PHT buckets to initialize.
- *                      If less than 1, a default value is used.
+ * \param initialTables The number of PHT buckets to initialize, rounded up to a
+ *                      power of two. If less than 1, a default value is used.
  * \returns A pointer to the newly created DPHT, or NULL if memory allocation fails.
  */
 
 DPHT* dpht_create(int initialTables);
 
+/** Creates a new Dynamic Perfect Hash Table (DPHT) from a configuration.
+ *
+ * \param config Pointer to the options to use, or NULL for the defaults.
+ * \returns A pointer to the newly created DPHT, or NULL if memory allocation fails.
+ */
+DPHT* dpht_create_with_config(const dpht_config_t* config);
+
+/** Builds a DPHT from an initial set of key-value pairs.
+ *
+ * The directory is sized from n and the load factor threshold up front, so
+ * no bucket is split during the load, and each bucket builds its MPH once.
+ *
+ * \param keys Array of n key strings.
+ * \param values Array of n value strings.
+ * \param n Number of pairs to load.
+ * \returns A pointer to the new DPHT, or NULL on failure.
+ */
+DPHT* dpht_build(const char** keys, const char** values, size_t n);
+
+/** Builds a DPHT from a configuration and an initial set of key-value pairs.
+ *
+ * \param config Pointer to the options to use, or NULL for the defaults. The
+ *               number of initial tables is raised to fit n keys if needed.
+ * \param keys Array of n key strings.
+ * \param values Array of n value strings.
+ * \param n Number of pairs to load.
+ * \returns A pointer to the new DPHT, or NULL on failure.
+ */
+DPHT* dpht_build_with_config(const dpht_config_t* config, const char** keys,
+                             const char** values, size_t n);
+
 /** Inserts a key-value pair into the DPHT.
  *
  * This function hashes the key to determine the appropriate PHT bucket,
  * and inserts the new pair into that bucket. If the key already exists,
- * the existing value is updated instead. The DPHT may trigger a rehash
- * if the load factor exceeds the predefined threshold.
+ * the existing value is updated instead. If the load factor exceeds the
+ * predefined threshold, the DPHT grows by splitting at most a small, fixed
+ * number of buckets, so no single insert pays for rehashing the whole table.
  *
  * \param dpht Pointer to the DPHT structure.
  * \param key Pointer to the key string.
@@ -44,6 +266,110 @@ DPHT* dpht_create(int initialTables);
  */
 int dpht_insert(DPHT* dpht, char* key, char* value);
 
+/** Inserts a binary key-value pair into the DPHT.
+ *
+ * Keys and values are arbitrary byte strings and may contain zero bytes.
+ * The key length and the full key hash are stored in the pair, so later
+ * comparisons reject mismatches without reading the key bytes.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the value bytes.
+ * \param value_len Number of bytes in the value.
+ * \returns 1 on success, 0 on failure (e.g., memory allocation error).
+ */
+int dpht_insert_n(DPHT* dpht, const void* key, size_t key_len, const void* value, size_t value_len);
+
+/** Inserts or updates a key-value pair and returns the pair holding it.
+ *
+ * The bucket and the key's slot are resolved with a single probe; an
+ * existing pair takes the new value in place. The returned pair is a handle
+ * to the value: its value bytes may be changed directly, and
+ * dpht_set_value() replaces a value of another length. The handle stays
+ * valid, across splits, merges and MPH rebuilds, until the key is removed
+ * or the DPHT is freed.
+ *
+ * Concurrent DPHTs never hand out handles, since readers may be reading any
+ * value; use dpht_insert() there.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key string.
+ * \param value Pointer to the value string.
+ * \returns The pair holding the key, or NULL on failure (or if the DPHT is concurrent).
+ */
+pair_t* dpht_upsert(DPHT* dpht, const char* key, const char* value);
+
+/** Inserts or updates a binary key-value pair and returns the pair holding it.
+ *
+ * See dpht_upsert().
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the value bytes.
+ * \param value_len Number of bytes in the value.
+ * \returns The pair holding the key, or NULL on failure (or if the DPHT is concurrent).
+ */
+pair_t* dpht_upsert_n(DPHT* dpht, const void* key, size_t key_len, const void* value, size_t value_len);
+
+/** Finds the pair of a key, inserting the key with an empty value if it is missing.
+ *
+ * The "find or create" step of per-packet flow processing: a single probe
+ * either finds the flow or appends it, and the caller then fills in or
+ * updates the value through the returned handle (see dpht_upsert()).
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key string.
+ * \param inserted If not NULL, receives 1 if the key was inserted, 0 if it existed.
+ * \returns The pair holding the key, or NULL on failure (or if the DPHT is concurrent).
+ */
+pair_t* dpht_get_or_insert(DPHT* dpht, const char* key, int* inserted);
+
+/** Finds the pair of a binary key, inserting it with an initial value if it is missing.
+ *
+ * See dpht_get_or_insert(). An existing pair keeps its value.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the initial value bytes of a new pair.
+ * \param value_len Number of bytes in the initial value.
+ * \param inserted If not NULL, receives 1 if the key was inserted, 0 if it existed.
+ * \returns The pair holding the key, or NULL on failure (or if the DPHT is concurrent).
+ */
+pair_t* dpht_get_or_insert_n(DPHT* dpht, const void* key, size_t key_len,
+                             const void* value, size_t value_len, int* inserted);
+
+/** Replaces the value of a pair returned by dpht_upsert() or dpht_get_or_insert().
+ *
+ * A value of the same length is copied over the old one in place.
+ *
+ * \param dpht Pointer to the DPHT that holds the pair.
+ * \param pair The handle.
+ * \param value Pointer to the new value bytes.
+ * \param value_len Number of bytes in the new value.
+ * \returns 1 on success, 0 on failure.
+ */
+int dpht_set_value(DPHT* dpht, pair_t* pair, const void* value, size_t value_len);
+
+/** Inserts or updates a batch of key-value pairs in the DPHT.
+ *
+ * The directory is grown for the whole batch first, then the keys are
+ * partitioned by bucket and each bucket takes its new pairs in one
+ * pht_insert_batch() call, which rebuilds its MPH once. Existing keys are
+ * updated; when a key appears several times in the batch the last value wins.
+ * With a thread pool (see dpht_config_t.threads) the keys are hashed and the
+ * bucket MPHs are built on every thread of the pool.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param keys Array of n key strings (pairs with a NULL key or value are skipped).
+ * \param values Array of n value strings.
+ * \param n Number of pairs in the batch.
+ * \returns The number of pairs inserted or updated.
+ */
+size_t dpht_insert_batch(DPHT* dpht, const char** keys, const char** values, size_t n);
+
 /** Searches for a key in the DPHT.
  *
  * This function computes the hash of the given key to locate the appropriate
@@ -55,6 +381,46 @@ int dpht_insert(DPHT* dpht, char* key, char* value);
  */
 char* dpht_search(DPHT* dpht, char* key);
 
+/** Searches for a binary key in the DPHT.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes if the key is found, or NULL otherwise.
+ *          The value is followed by a NUL byte that is not counted in value_len.
+ */
+void* dpht_search_n(DPHT* dpht, const void* key, size_t key_len, size_t* value_len);
+
+/** Searches for a burst of keys in the DPHT.
+ *
+ * The lookups run as a staged pipeline over chunks of the burst: all keys are
+ * hashed and their buckets prefetched, then all MPHs are evaluated and their
+ * candidate entries prefetched, and only then are the keys compared. The
+ * memory latency of the lookups in a chunk overlaps instead of adding up.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param keys Array of n key strings (NULL entries are treated as misses).
+ * \param n Number of keys in the burst.
+ * \param out Array of n pointers receiving each value, or NULL when not found.
+ * \returns The number of keys found.
+ */
+size_t dpht_search_batch(DPHT* dpht, const char** keys, size_t n, char** out);
+
+/** Searches for a burst of fixed-width keys in the DPHT.
+ *
+ * Same pipeline as dpht_search_batch(), for a DPHT created with a key_width:
+ * the keys are read straight from a packed array, e.g. the flow_key4_t keys
+ * parsed from a receive burst.
+ *
+ * \param dpht Pointer to a DPHT with a fixed key width.
+ * \param keys Array of n keys of key_width bytes each, back to back.
+ * \param n Number of keys in the burst.
+ * \param out Array of n pointers receiving each value, or NULL when not found.
+ * \returns The number of keys found (0 if the DPHT has no fixed key width).
+ */
+size_t dpht_search_batch_n(DPHT* dpht, const void* keys, size_t n, void** out);
+
 /** Updates the value associated with an existing key in the DPHT.
  *
  * This function hashes the key to find its corresponding PHT bucket
@@ -67,6 +433,17 @@ char* dpht_search(DPHT* dpht, char* key);
  */
 int dpht_update(DPHT* dpht, char* key, char* new_value);
 
+/** Updates the value associated with an existing binary key in the DPHT.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param new_value Pointer to the new value bytes.
+ * \param value_len Number of bytes in the new value.
+ * \returns 1 if the key was found and updated, 0 otherwise.
+ */
+int dpht_update_n(DPHT* dpht, const void* key, size_t key_len, const void* new_value, size_t value_len);
+
 /** Checks if a given key exists in the DPHT.
  *
  * This function performs a lookup for the key and returns whether it exists.
@@ -88,13 +465,187 @@ int dpht_lookup(DPHT* dpht, char* key);
  */
 void dpht_remove_entry(DPHT* dpht, char* key);
 
+/** Deletes the key-value pair holding a binary key from the DPHT.
+ *
+ * \param dpht Pointer to the DPHT structure.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \returns 1 if a pair was deleted, 0 if the key was not found.
+ */
+int dpht_remove_n(DPHT* dpht, const void* key, size_t key_len);
+
+/** Repacks the whole DPHT into the least memory that holds its pairs.
+ *
+ * Buckets are merged while the average load stays within max_load (never
+ * below the initial number of buckets), every bucket is compacted, indexed
+ * and trimmed with pht_repack(), and the directory array is cut down to the
+ * buckets in use. Unlike the incremental shrinking done by removals, the
+ * cost is proportional to the whole table; call it after a mass deletion has
+ * drained the table, e.g. once a flow storm is over. On a concurrent DPHT it
+ * holds the writer lock throughout, while readers keep running.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \returns 1 on success, 0 on invalid parameters or if some bucket could not
+ *          be repacked (the DPHT stays valid, that bucket just keeps part of
+ *          its delta area or its arrays).
+ */
+int dpht_compact(DPHT* dpht);
+
+/** Registers the calling thread as a reader of a concurrent DPHT.
+ *
+ * \param dpht Pointer to a DPHT created with the concurrent option.
+ * \returns The reader handle of the thread, or NULL if the DPHT is not
+ *          concurrent or EPOCH_MAX_READERS threads are already registered.
+ */
+epoch_reader_t* dpht_reader_register(DPHT* dpht);
+
+/** Unregisters a reader. It must not be inside a read section.
+ *
+ * \param reader The reader handle (NULL is ignored).
+ */
+void dpht_reader_unregister(epoch_reader_t* reader);
+
+/** Starts a read section on a concurrent DPHT.
+ *
+ * Lookups (dpht_search() and dpht_search_n()) made inside the section take no
+ * lock, and the values they return stay valid until dpht_read_end(), even if
+ * a writer updates or removes the key meanwhile.
+ *
+ * \param reader The reader handle of the calling thread.
+ */
+void dpht_read_begin(epoch_reader_t* reader);
+
+/** Ends a read section; values returned inside it must not be used any more.
+ *
+ * \param reader The reader handle of the calling thread.
+ */
+void dpht_read_end(epoch_reader_t* reader);
+
+#define DPHT_STATS_HISTOGRAM_BINS 12  // Bins of the bucket size histogram of dpht_stats_t
+
+/** Runtime statistics of a DPHT, filled in by dpht_get_stats().
+ *
+ * The event counters are only kept when the library is built with
+ * DPHT_STATS defined; otherwise counters_enabled is 0, the counters read 0
+ * and no hot path pays anything for them. The shape and memory figures are
+ * computed on demand and are always available.
+ *
+ * \param counters_enabled 1 if the library counts events (built with DPHT_STATS).
+ * \param rebuilds Second-level index builds of every kind since creation.
+ * \param cmph_builds CMPH MPH builds, inline or on the background worker.
+ * \param seed_builds Seed-search MPH builds of small buckets.
+ * \param fks_builds FKS slot array re-seeds.
+ * \param rebuild_failures Builds that failed; the bucket kept its old index.
+ * \param rebuild_ns Total time spent building indexes, in nanoseconds.
+ * \param rebuild_max_ns Longest single build, in nanoseconds.
+ * \param compactions Buckets compacted to drop their tombstones.
+ * \param splits Buckets split by linear hashing (the directory's rehashes).
+ * \param merges Buckets merged back as the directory shrank.
+ * \param probes Keys looked up in a bucket, by searches and by writers.
+ * \param hits Searches that found their key.
+ * \param misses Searches that did not.
+ * \param size Key-value pairs stored.
+ * \param buckets PHT buckets in the directory.
+ * \param largest_bucket Keys in the fullest bucket.
+ * \param tombstones Tombstones left in bucket entries arrays.
+ * \param staged Keys in delta areas, not yet indexed by an MPH.
+ * \param pending_rebuilds Background rebuilds not yet installed.
+ * \param histogram Bucket sizes: histogram[0] counts empty buckets and
+ *                  histogram[b] buckets of 2^(b-1) to 2^b - 1 keys; the last
+ *                  bin also counts every larger bucket.
+ * \param directory_bytes Directory array and PHT structures.
+ * \param entries_bytes Bucket entries, fingerprint and FKS slot arrays.
+ * \param pair_bytes pair_t structures.
+ * \param key_bytes Key bytes and their NUL terminators.
+ * \param value_bytes Value bytes and their NUL terminators.
+ * \param mph_bytes CMPH functions (their packed size).
+ * \param arena_bytes Slab memory reserved by the pair arena, or 0 without
+ *                    one. Pairs, keys and values live inside it, so it is an
+ *                    alternative view of those three figures, not an addition.
+ * \param total_bytes directory_bytes + entries_bytes + pair_bytes + key_bytes
+ *                    + value_bytes + mph_bytes.
+ * \param max_load The current split threshold (chosen by the load controller
+ *                 if adaptive_load is set).
+ * \param build_ns_per_key Index build time per key indexed, as measured by the
+ *                         load controller over its last window (0 without one).
+ * \param lookup_ns Average sampled lookup time over the controller's last
+ *                  window (0 without a controller or without sampled lookups).
+ */
+typedef struct DPHTStats {
+    int counters_enabled;
+    uint64_t rebuilds;
+    uint64_t cmph_builds;
+    uint64_t seed_builds;
+    uint64_t fks_builds;
+    uint64_t rebuild_failures;
+    uint64_t rebuild_ns;
+    uint64_t rebuild_max_ns;
+    uint64_t compactions;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t misses;
+    size_t size;
+    size_t buckets;
+    size_t largest_bucket;
+    size_t tombstones;
+    size_t staged;
+    size_t pending_rebuilds;
+    size_t histogram[DPHT_STATS_HISTOGRAM_BINS];
+    size_t directory_bytes;
+    size_t entries_bytes;
+    size_t pair_bytes;
+    size_t key_bytes;
+    size_t value_bytes;
+    size_t mph_bytes;
+    size_t arena_bytes;
+    size_t total_bytes;
+    double max_load;
+    double build_ns_per_key;
+    double lookup_ns;
+} dpht_stats_t;
+
+/** Reports the runtime statistics of a DPHT.
+ *
+ * The counters are summed over the per-thread stripes with relaxed loads, so
+ * while other threads are still counting the figures are approximate. The
+ * shape and memory figures walk every bucket; on a concurrent DPHT the call
+ * takes the writer lock, otherwise the caller must keep writers out.
+ *
+ * \param dpht Pointer to the DPHT.
+ * \param stats Receives the statistics.
+ * \returns 1 on success, 0 on invalid parameters.
+ */
+int dpht_get_stats(DPHT* dpht, dpht_stats_t* stats);
+
+/** Writes the events traced by a DPHT as Chrome trace_event JSON.
+ *
+ * Each index build and each split is a duration event on the thread that ran
+ * it (the owner, the background worker or a pool thread) and each failed
+ * build is an instant event, labelled with the bucket index and its number of
+ * keys or the directory capacities. The file opens in chrome://tracing or
+ * Perfetto, where pauses line up against other timelines. Recording continues
+ * while the dump runs.
+ *
+ * \param dpht Pointer to a DPHT created with trace_events set.
+ * \param out The stream to write to.
+ * \returns 1 on success, 0 if the DPHT has no trace or on a write error.
+ */
+int dpht_trace_dump(DPHT* dpht, FILE* out);
+
 /** Deletes the entire DPHT and frees all associated memory.
  *
- * This function deallocates each internal PHT bucket and
+ * This function deallocates each internal PHT bucket, stops the background
+ * rebuild worker (if any), releases the pair arena (if any) in one pass and
  * then releases the DPHT structure itself.
  *
  * \param dpht Pointer to the DPHT structure to delete.
  */
 void dpht_free(DPHT* dpht);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // DPHT_H
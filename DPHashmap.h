@@ -1,37 +1,340 @@
-#include <cmph.h>
+#ifndef DPHASHMAP_H
+#define DPHASHMAP_H
 
-typedef struct pair {
-    char* key;
-    char* value;
-} pair_t;
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "DPHT.h"
 
+/** Header-only C++ front end of the DPHT.
+ *
+ * DPHashmap<Key, Value, Hash, Traits> stores its keys in a DPHT and its
+ * values, constructed in place, in the value bytes of each pair, so the
+ * C table does all hashing, probing and growth while values are real C++
+ * objects: move-only types work, and nothing is copied through char*.
+ *
+ * Requires C++17.
+ */
+namespace dpht {
 
-typedef struct PerfectHashTable {
-    int size;
-    int capacity;
-    cmph_t* mph;
-    pair_t** elements;
-} PHT;
+/** How a key type is turned into the bytes the table hashes and stores.
+ *
+ * Only the specializations below exist; other key types do not compile.
+ */
+template <typename Key, typename Enable = void>
+struct KeyBytes;
 
-typedef int(*hashFunctionPointer)(char*, int);
+/** String keys.
+ *
+ * Lookups take anything convertible to std::string_view (std::string, string
+ * literals, std::string_view), so no std::string is built to find a key.
+ */
+template <>
+struct KeyBytes<std::string> {
+    static constexpr bool fixed_width = false;
+    static std::string_view bytes(std::string_view key) noexcept {
+        return key;
+    }
+};
 
-typedef struct DynamicPerfectHashTable {
-    int size;
-    int capacity;
-    hashFunctionPointer hashFunction;
-    PHT** tables;
-} DPHT;
+/** Fixed-width keys: integers, enums and packed structs such as 5-tuples.
+ *
+ * The object representation is the key, so there is no string path at all:
+ * no formatting, no strlen, and the table is created with a fixed key width.
+ * flow_key4_t and flow_key6_t work as they are. Types with padding bytes are
+ * rejected, since two equal keys could differ in their padding.
+ */
+template <typename Key>
+struct KeyBytes<Key, std::enable_if_t<std::is_trivially_copyable_v<Key> &&
+                                      std::has_unique_object_representations_v<Key>>> {
+    static constexpr bool fixed_width = true;
+    static std::string_view bytes(const Key& key) noexcept {
+        return std::string_view(reinterpret_cast<const char*>(&key), sizeof(Key));
+    }
+};
 
-void insert();
-char* search();
-void delete_entry();
-int lookup(); // contains
-PHT* resize();
-DPHT* resize();
-void delete_table();
-int update();
+/** The built-in first-level hash of the DPHT, hash_bytes_seeded().
+ *
+ * A map using it passes no hash function to the C table, which then calls
+ * the hash inline instead of through a pointer.
+ */
+struct DefaultHash {
+    uint64_t operator()(const void* key, size_t len, uint64_t seed) const noexcept {
+        return hash_bytes_seeded(key, len, seed);
+    }
+};
 
+/** Compile-time settings of a DPHashmap, and the KeyBytes of its key type.
+ *
+ * Derive from it to change individual constants, e.g.
+ *   struct FlowTraits : dpht::DefaultTraits<Flow> { static constexpr double max_load = 3.0; };
+ */
+template <typename Key>
+struct DefaultTraits : KeyBytes<Key> {
+    static constexpr int initial_buckets = DPHT_DEFAULT_TABLES;          // Rounded up to a power of two
+    static constexpr int bucket_capacity = DPHT_DEFAULT_BUCKET_CAPACITY; // Initial entries per bucket
+    static constexpr double max_load = DPHT_DEFAULT_MAX_LOAD;            // Keys per bucket before a split
+    static constexpr int delta_threshold = PHT_DELTA_THRESHOLD;          // Staged keys before an MPH rebuild
+    static constexpr bool use_arena = false;                             // Allocate pairs from an arena
+};
 
+/** A hash map from Key to Value backed by a DPHT.
+ *
+ * Values live in their pair from insertion to removal and never move, so the
+ * pointers returned by find() and try_emplace() stay valid across inserts,
+ * splits, merges and MPH rebuilds until their key is erased. Maps are
+ * move-only, and a moved-from map may only be destroyed or assigned to.
+ *
+ * \tparam Key std::string, or a trivially copyable type without padding.
+ * \tparam Value Any object type that is at most 16-byte aligned.
+ * \tparam Hash Stateless callable uint64_t(const void* key, size_t len, uint64_t seed).
+ * \tparam Traits Compile-time settings, see DefaultTraits.
+ */
+template <typename Key, typename Value, typename Hash = DefaultHash, typename Traits = DefaultTraits<Key>>
+class DPHashmap {
+    static_assert(alignof(Value) <= 16, "values are stored in 16-byte aligned pair buffers");
+    static_assert(Traits::initial_buckets > 0, "initial_buckets must be positive");
+    static_assert(Traits::bucket_capacity > 0, "bucket_capacity must be positive");
+    static_assert(Traits::max_load > 0.0, "max_load must be positive");
+    static_assert(std::is_empty_v<Hash>, "the hash function must be stateless");
 
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using size_type = size_t;
 
+    /** What lookups convert their key argument to: a Key (fixed width), or a
+     *  std::string_view. Binding a converted Key to the reference keeps the
+     *  temporary alive for the whole operation. */
+    using lookup_type = std::conditional_t<Traits::fixed_width, const Key&, std::string_view>;
 
+    /** Creates an empty map.
+     *
+     * \param seed Seed of the hash function, or DPHT_SEED_RANDOM.
+     * \throws std::bad_alloc if the table cannot be created.
+     */
+    explicit DPHashmap(uint64_t seed = DPHT_SEED_RANDOM) : table_(create(seed)) {}
+
+    ~DPHashmap() {
+        release();
+    }
+
+    DPHashmap(const DPHashmap&) = delete;
+    DPHashmap& operator=(const DPHashmap&) = delete;
+
+    DPHashmap(DPHashmap&& other) noexcept : table_(std::exchange(other.table_, nullptr)) {}
+
+    DPHashmap& operator=(DPHashmap&& other) noexcept {
+        if (this != &other) {
+            release();
+            table_ = std::exchange(other.table_, nullptr);
+        }
+        return *this;
+    }
+
+    /** Constructs a value for a key unless the key is already present.
+     *
+     * The bucket is probed once; an existing value is left untouched and
+     * args are not used.
+     *
+     * \returns The value of the key, and true if it was inserted.
+     * \throws std::bad_alloc on allocation failure, or what Value's constructor throws.
+     */
+    template <typename K, typename... Args>
+    std::pair<Value*, bool> try_emplace(const K& key, Args&&... args) {
+        lookup_type lookup = key;
+        std::string_view bytes = Traits::bytes(lookup);
+        int inserted = 0;
+        pair_t* pair = dpht_get_or_insert_n(table_, bytes.data(), bytes.size(),
+                                            blank(), sizeof(Value), &inserted);
+        if (!pair) {
+            throw std::bad_alloc();
+        }
+        Value* value = stored(pair);
+        if (inserted) {
+            try {
+                ::new (static_cast<void*>(value)) Value(std::forward<Args>(args)...);
+            }
+            catch (...) {
+                dpht_remove_n(table_, bytes.data(), bytes.size());
+                throw;
+            }
+        }
+        return { value, inserted != 0 };
+    }
+
+    /** Inserts a value, or assigns it to the value already stored for the key.
+     *
+     * \returns The value of the key, and true if it was inserted.
+     */
+    template <typename K, typename V>
+    std::pair<Value*, bool> insert_or_assign(const K& key, V&& value) {
+        std::pair<Value*, bool> result = try_emplace(key, std::forward<V>(value));
+        if (!result.second) {
+            *result.first = std::forward<V>(value); // try_emplace() did not use it
+        }
+        return result;
+    }
+
+    /** Returns the value of a key, default-constructing it if it is missing. */
+    template <typename K>
+    Value& operator[](const K& key) {
+        return *try_emplace(key).first;
+    }
+
+    /** Finds the value of a key.
+     *
+     * \returns Pointer to the value, or nullptr if the key is not present.
+     */
+    template <typename K>
+    Value* find(const K& key) {
+        lookup_type lookup = key;
+        std::string_view bytes = Traits::bytes(lookup);
+        return static_cast<Value*>(dpht_search_n(table_, bytes.data(), bytes.size(), nullptr));
+    }
+
+    template <typename K>
+    const Value* find(const K& key) const {
+        return const_cast<DPHashmap*>(this)->find(key); // Lookups only install finished rebuilds
+    }
+
+    template <typename K>
+    bool contains(const K& key) const {
+        return find(key) != nullptr;
+    }
+
+    /** Removes a key and destroys its value.
+     *
+     * \returns true if the key was present.
+     */
+    template <typename K>
+    bool erase(const K& key) {
+        lookup_type lookup = key;
+        std::string_view bytes = Traits::bytes(lookup);
+        if constexpr (!std::is_trivially_destructible_v<Value>) {
+            Value* value = find(key);
+            if (!value) {
+                return false;
+            }
+            value->~Value();
+        }
+        return dpht_remove_n(table_, bytes.data(), bytes.size()) != 0;
+    }
+
+    /** Removes every key, keeping the seed of the hash function. */
+    void clear() {
+        DPHashmap empty(table_->seed);
+        std::swap(table_, empty.table_);
+    }
+
+    size_type size() const noexcept {
+        return (size_type)table_->size;
+    }
+
+    bool empty() const noexcept {
+        return table_->size == 0;
+    }
+
+    /** Calls f(key, value) for every entry, in no particular order.
+     *
+     * String maps pass the key as a std::string_view, fixed-width maps as a Key.
+     * f must not insert or erase keys.
+     */
+    template <typename F>
+    void for_each(F&& f) {
+        each_pair([&](pair_t* pair) {
+            if constexpr (Traits::fixed_width) {
+                Key key;
+                std::memcpy(&key, pair->key, sizeof(Key));
+                f(static_cast<const Key&>(key), *stored(pair));
+            }
+            else {
+                f(std::string_view(pair->key, pair->key_len), *stored(pair));
+            }
+        });
+    }
+
+    /** Returns the underlying DPHT, e.g. for dpht_freeze(). */
+    DPHT* native() noexcept {
+        return table_;
+    }
+
+private:
+    DPHT* table_;
+
+    static DPHT* create(uint64_t seed) {
+        dpht_config_t config;
+        dpht_config_init(&config);
+        config.initial_tables = Traits::initial_buckets;
+        config.bucket_capacity = Traits::bucket_capacity;
+        config.max_load = Traits::max_load;
+        config.delta_threshold = Traits::delta_threshold;
+        config.use_arena = Traits::use_arena ? 1 : 0;
+        if constexpr (Traits::fixed_width) {
+            config.key_width = (int)sizeof(Key); // Fixed-width hashing and compares
+        }
+        config.hash = hash_function();
+        config.seed = seed;
+        DPHT* table = dpht_create_with_config(&config);
+        if (!table) {
+            throw std::bad_alloc();
+        }
+        return table;
+    }
+
+    static uint64_t hash_thunk(const void* key, size_t len, uint64_t seed) {
+        return Hash()(key, len, seed);
+    }
+
+    static hash_fn hash_function() noexcept {
+        if constexpr (std::is_same_v<Hash, DefaultHash>) {
+            return nullptr; // The table's own inline hash
+        }
+        else {
+            return &DPHashmap::hash_thunk;
+        }
+    }
+
+    /** Initial bytes of a new pair's value, overwritten by the constructor. */
+    static const void* blank() noexcept {
+        alignas(Value) static const unsigned char zeros[sizeof(Value)] = {};
+        return zeros;
+    }
+
+    static Value* stored(pair_t* pair) noexcept {
+        return std::launder(reinterpret_cast<Value*>(pair->value));
+    }
+
+    /** Calls f(pair) for every pair of every bucket, skipping tombstones. */
+    template <typename F>
+    void each_pair(F&& f) {
+        for (int b = 0; b < table_->capacity; b++) {
+            const PHT* bucket = table_->tables[b];
+            for (int i = 0; i < bucket->size; i++) {
+                if (bucket->entries[i]) {
+                    f(bucket->entries[i]);
+                }
+            }
+        }
+    }
+
+    void release() noexcept {
+        if (!table_) {
+            return;
+        }
+        if constexpr (!std::is_trivially_destructible_v<Value>) {
+            each_pair([](pair_t* pair) { stored(pair)->~Value(); });
+        }
+        dpht_free(table_);
+        table_ = nullptr;
+    }
+};
+
+} // namespace dpht
+
+#endif // DPHASHMAP_H
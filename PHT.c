@@ -1,53 +1,494 @@
 #include "PHT.h"
 #include "pair.h"
+#include "hash.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #define PHT_DEFAULT_CAPACITY 4
+#define PHT_FKS_MAX_ATTEMPTS 64     // Seeds tried before an FKS rebuild gives up
+#define PHT_SEED_MAX_ATTEMPTS (1u << 16) // Seeds tried before a seed-search MPH gives up
+#define PHT_FKS_INITIAL_SEED 0x9e3779b97f4a7c15ULL
 
-/** Rebuilds the MPH for the current set of keys in the PHT, using CMPH.
+static unsigned int pht_next_stripe = 0;           // Stripe handed to the next new thread
+static __thread int pht_stripe = -1;               // This thread's stripe, -1 until first use
+
+pht_counters_t* pht_counters_local(pht_counters_t* counters) {
+    if (pht_stripe < 0) {
+        pht_stripe = (int)(__atomic_fetch_add(&pht_next_stripe, 1, __ATOMIC_RELAXED) % PHT_COUNTER_STRIPES);
+    }
+    return &counters[pht_stripe];
+}
+
+/** Reads the clock used to time index builds.
  *
- * This function reorders the entries array so that cmph_search() returns
- * the correct index for each key.
+ * \returns Monotonic time in nanoseconds.
+ */
+static uint64_t pht_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/** Counts one second-level index build and its time.
  *
- * \param pht Pointer to the PHT whose MPH needs to be rebuilt.
+ * Does nothing when counting is compiled out or there are no counters.
+ *
+ * \param counters The context's counter stripes, or NULL.
+ * \param kind The kind of index built.
+ * \param elapsed Time the build took, in nanoseconds.
+ * \param built 1 if the build succeeded, 0 if it failed.
  */
-static void pht_rebuild(PHT* pht) {
-    if (!pht) {
-        return; // Invalid PHT
+static void pht_count_build(pht_counters_t* counters, trace_build_kind_t kind, uint64_t elapsed, int built) {
+#ifdef DPHT_STATS
+    if (!counters) {
+        return;
     }
+    pht_counters_t* local = pht_counters_local(counters);
+    uint64_t* kind_count = (kind == TRACE_BUILD_CMPH) ? &local->cmph_builds
+                         : (kind == TRACE_BUILD_SEED) ? &local->seed_builds : &local->fks_builds;
+    __atomic_fetch_add(&local->rebuilds, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(kind_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&local->rebuild_failures, built ? 0 : 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&local->rebuild_ns, elapsed, __ATOMIC_RELAXED);
 
-    // For a single entry or empty table, skip rebuilding
-    if (pht->size <= 1) {
-        if (pht->mph) { // Free the MPH if it exists
-            cmph_destroy(pht->mph);
-            pht->mph = NULL;
+    // Raise the maximum; another thread sharing the stripe may race us
+    uint64_t longest = __atomic_load_n(&local->rebuild_max_ns, __ATOMIC_RELAXED);
+    while (elapsed > longest &&
+           !__atomic_compare_exchange_n(&local->rebuild_max_ns, &longest, elapsed, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    (void)counters;
+    (void)kind;
+    (void)elapsed;
+    (void)built;
+#endif
+}
+
+/** Marks the start of a second-level index build.
+ *
+ * \param ctx The context of the PHT being indexed, or NULL.
+ * \param kind The kind of index being built.
+ * \param bucket Index of the bucket in the directory, or -1.
+ * \param keys Number of keys indexed.
+ * \returns The start time to hand to pht_build_end().
+ */
+static uint64_t pht_build_begin(const pht_context_t* ctx, trace_build_kind_t kind, int bucket, int keys) {
+    if (!ctx) {
+        return 0; // Nothing measures standalone PHTs
+    }
+    trace_ring_record(ctx->trace, TRACE_REBUILD_BEGIN, kind, bucket, keys, 0);
+    return pht_clock_ns();
+}
+
+/** Marks the end of a second-level index build: counts it, charges its time
+ * to the context's build costs and traces it.
+ *
+ * \param ctx The context of the PHT being indexed, or NULL.
+ * \param kind The kind of index built.
+ * \param bucket Index of the bucket in the directory, or -1.
+ * \param keys Number of keys indexed.
+ * \param start The value returned by pht_build_begin().
+ * \param built 1 if the build succeeded, 0 if it failed.
+ */
+static void pht_build_end(const pht_context_t* ctx, trace_build_kind_t kind,
+                          int bucket, int keys, uint64_t start, int built) {
+    if (!ctx) {
+        return;
+    }
+    uint64_t elapsed = pht_clock_ns() - start;
+    pht_count_build(ctx->counters, kind, elapsed, built);
+    if (ctx->build_cost) {
+        __atomic_fetch_add(&ctx->build_cost->ns, elapsed, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&ctx->build_cost->keys, (uint64_t)keys, __ATOMIC_RELAXED);
+    }
+    if (!built) {
+        trace_ring_record(ctx->trace, TRACE_MPH_FAILURE, kind, bucket, keys, 0);
+    }
+    trace_ring_record(ctx->trace, TRACE_REBUILD_END, kind, bucket, keys, 0);
+}
+
+/** Seeded hash function for the FKS second level.
+ *
+ * This is the seeded first-level hash (hash_bytes_seeded()) folded to 32
+ * bits; every seed yields an independent-looking function.
+ *
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param seed The seed selecting the hash function.
+ * \returns A 32-bit hash value.
+ */
+static uint32_t pht_fks_hash(const void* key, size_t len, uint64_t seed) {
+    uint64_t hash = hash_bytes_seeded(key, len, seed);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/** Advances an FKS seed to the next one (splitmix64 step).
+ *
+ * \param seed The current seed.
+ * \returns The next seed.
+ */
+static uint64_t pht_fks_next_seed(uint64_t seed) {
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/** Maps a key to its FKS slot for the current seed.
+ *
+ * The 32-bit hash is scaled into [0, slot_count) with a multiply and a shift
+ * instead of a modulo.
+ *
+ * \param pht Pointer to an FKS PHT.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \returns The slot index of the key.
+ */
+static int pht_fks_slot(const PHT* pht, const void* key, size_t len) {
+    uint64_t hash = pht_fks_hash(key, len, pht->seed);
+    return (int)((hash * (uint64_t)pht->slot_count) >> 32);
+}
+
+/** Rebuilds the FKS slot array so that every key has a slot of its own.
+ *
+ * The slot array is sized to slot_capacity * slot_capacity. Seeds are tried
+ * until every entry lands in a distinct slot; with a quadratic number of slots
+ * each attempt succeeds with probability at least 1/2.
+ *
+ * \param pht Pointer to the FKS PHT to rebuild.
+ * \param slot_capacity The number of keys the new slot array must support.
+ * \returns 1 on success, 0 on failure (slot_capacity above
+ *          PHT_FKS_MAX_CAPACITY, memory allocation or no seed found).
+ */
+static int pht_fks_rebuild(PHT* pht, int slot_capacity) {
+    if (slot_capacity > PHT_FKS_MAX_CAPACITY) {
+        return 0; // The slot array would be too large
+    }
+    uint64_t start = pht_build_begin(pht->ctx, TRACE_BUILD_FKS, pht->bucket, pht->size);
+    int slot_count = (int)((size_t)slot_capacity * (size_t)slot_capacity);
+    pair_t** new_slots = (pair_t**)malloc(sizeof(pair_t*) * slot_count);
+    uint8_t* new_tags = (uint8_t*)malloc(slot_count);
+    if (!new_slots || !new_tags) {
+        free(new_slots);
+        free(new_tags);
+        pht_build_end(pht->ctx, TRACE_BUILD_FKS, pht->bucket, pht->size, start, 0);
+        return 0; // Memory allocation failed
+    }
+
+    pair_t** old_slots = pht->slots;
+    uint8_t* old_tags = pht->tags;
+    int old_count = pht->slot_count;
+    uint64_t old_seed = pht->seed;
+    pht->slots = new_slots;
+    pht->tags = new_tags;
+    pht->slot_count = slot_count;
+
+    for (int attempt = 0; attempt < PHT_FKS_MAX_ATTEMPTS; attempt++) {
+        pht->seed = pht_fks_next_seed(pht->seed);
+        memset(new_slots, 0, sizeof(pair_t*) * slot_count);
+
+        // Place every entry, starting over with a new seed on a collision
+        int i;
+        for (i = 0; i < pht->size; i++) {
+            pair_t* entry = pht->entries[i];
+            int slot = pht_fks_slot(pht, entry->key, entry->key_len);
+            if (new_slots[slot]) {
+                break;
+            }
+            new_slots[slot] = entry;
+            new_tags[slot] = pht_tag(entry->hash);
+        }
+        if (i == pht->size) {
+            // Clear the tags of the slots left empty
+            for (int slot = 0; slot < slot_count; slot++) {
+                if (!new_slots[slot]) {
+                    new_tags[slot] = 0;
+                }
+            }
+            free(old_slots);
+            free(old_tags);
+            pht_build_end(pht->ctx, TRACE_BUILD_FKS, pht->bucket, pht->size, start, 1);
+            return 1;
+        }
+    }
+
+    // No collision-free seed found: restore the previous slot array
+    free(new_slots);
+    free(new_tags);
+    pht->slots = old_slots;
+    pht->tags = old_tags;
+    pht->slot_count = old_count;
+    pht->seed = old_seed;
+    pht_build_end(pht->ctx, TRACE_BUILD_FKS, pht->bucket, pht->size, start, 0);
+    return 0;
+}
+
+/** Finds the FKS slot holding the given key.
+ *
+ * The slot's fingerprint is checked first, so a miss only reads the tag array.
+ *
+ * \param pht Pointer to an FKS PHT.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns The slot index of the key, or -1 if the key is not present.
+ */
+static int pht_fks_find(const PHT* pht, const void* key, size_t len, uint64_t hash) {
+    int slot = pht_fks_slot(pht, key, len);
+    if (pht->tags[slot] != pht_tag(hash)) {
+        return -1; // Fingerprint mismatch (or empty slot)
+    }
+    if (pair_matches(pht->slots[slot], key, len, hash)) {
+        return slot;
+    }
+    return -1;
+}
+
+/** Returns the arena the pairs of a PHT are allocated from.
+ *
+ * \param pht Pointer to the PHT.
+ * \returns The arena of the owning DPHT, or NULL if pairs use malloc.
+ */
+static arena_t* pht_arena(const PHT* pht) {
+    return pht->ctx ? pht->ctx->arena : NULL;
+}
+
+/** Returns the reclamation domain of concurrent readers of a PHT.
+ *
+ * \param pht Pointer to the PHT.
+ * \returns The epoch domain of the owning DPHT, or NULL without concurrent readers.
+ */
+static epoch_t* pht_epoch(const PHT* pht) {
+    return pht->ctx ? pht->ctx->epoch : NULL;
+}
+
+/** epoch_retire() callback freeing a pair.
+ *
+ * \param ptr Pointer to the pair.
+ * \param arg Arena the pair was allocated from, or NULL.
+ */
+static void pht_free_retired_pair(void* ptr, void* arg) {
+    pair_free_in((arena_t*)arg, (pair_t*)ptr);
+}
+
+/** epoch_retire() callback freeing an MPH.
+ *
+ * \param ptr Pointer to the cmph_t.
+ * \param arg Unused.
+ */
+static void pht_free_retired_mph(void* ptr, void* arg) {
+    (void)arg;
+    cmph_destroy((cmph_t*)ptr);
+}
+
+/** Frees a pair the PHT no longer references.
+ *
+ * With concurrent readers the pair is retired and freed once no reader can
+ * still hold it.
+ *
+ * \param pht Pointer to the PHT that dropped the pair.
+ * \param pair Pointer to the pair.
+ */
+static void pht_release_pair(PHT* pht, pair_t* pair) {
+    epoch_t* epoch = pht_epoch(pht);
+    if (epoch) {
+        epoch_retire(epoch, pair, pht_free_retired_pair, pht_arena(pht));
+        return;
+    }
+    pair_free_in(pht_arena(pht), pair);
+}
+
+/** Finds a seed under which the first n entries map to distinct slots.
+ *
+ * Seeds are tried in order until pht_seed_slot() is a bijection on the
+ * stored key hashes (a RecSplit-style leaf). The expected number of tries is
+ * n^n / n!, about 400 for 8 keys and 2,800 for PHT_SEED_LIMIT keys, so
+ * PHT_SEED_MAX_ATTEMPTS only bounds the time lost on equal hashes; nothing is
+ * allocated.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ * \param n Number of entries to index (at most PHT_SEED_LIMIT).
+ * \param seed Receives the seed.
+ * \returns 1 on success, 0 if no seed was found (e.g. two equal hashes).
+ */
+static int pht_seed_search(const PHT* pht, int n, uint32_t* seed) {
+    for (uint32_t candidate = 0; candidate < PHT_SEED_MAX_ATTEMPTS; candidate++) {
+        uint32_t used = 0;
+        int i = 0;
+        for (; i < n; i++) {
+            uint32_t bit = 1u << pht_seed_slot(pht->entries[i]->hash, candidate, n);
+            if (used & bit) {
+                break; // Collision, try the next seed
+            }
+            used |= bit;
+        }
+        if (i == n) {
+            *seed = candidate;
+            return 1;
         }
+    }
+    return 0;
+}
+
+/** Frees an MPH the PHT no longer uses.
+ *
+ * With concurrent readers the MPH is retired, since an older version of the
+ * bucket may still be probed with it.
+ *
+ * \param pht Pointer to the PHT that dropped the MPH.
+ * \param mph Pointer to the MPH.
+ */
+static void pht_release_mph(PHT* pht, cmph_t* mph) {
+    epoch_t* epoch = pht_epoch(pht);
+    if (epoch) {
+        epoch_retire(epoch, mph, pht_free_retired_mph, NULL);
         return;
     }
+    cmph_destroy(mph);
+}
 
-    // Allocate an array of keys from the current entries
-    // CMPH vector adapter requires an array of strings
-    char** keys = (char**)malloc(sizeof(char*) * pht->size);
-    if (!keys) {
-        return; // Memory allocation failed
+/** Squeezes the tombstones out of the entries array of a CMPH PHT.
+ *
+ * The remaining pairs keep their order but not their MPH slots, so the MPH
+ * is dropped and every pair is staged until the next rebuild.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ */
+static void pht_compact(PHT* pht) {
+    if (pht->tombstones == 0) {
+        return; // Nothing to squeeze out
     }
+    int kept = 0;
     for (int i = 0; i < pht->size; i++) {
-        keys[i] = pht->entries[i]->key;
+        if (pht->entries[i]) {
+            pht->entries[kept] = pht->entries[i];
+            pht->tags[kept++] = pht->tags[i];
+        }
+    }
+    for (int i = kept; i < pht->size; i++) {
+        pht->entries[i] = NULL;
+    }
+    pht->size = kept;
+    pht->tombstones = 0;
+    PHT_COUNT(pht->ctx ? pht->ctx->counters : NULL, compactions, 1);
+
+    if (pht->mph) {
+        pht_release_mph(pht, pht->mph);
+        pht->mph = NULL;
+    }
+    pht->mph_size = 0;
+    pht->generation++; // Snapshots of pending rebuilds no longer match
+}
+
+/** Returns the largest bucket indexed by a seed-search MPH instead of CMPH.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ * \returns The number of keys.
+ */
+static int pht_seed_max_keys(const PHT* pht) {
+    const pht_mph_policy_t* policy = pht->ctx ? pht->ctx->mph_policy : NULL;
+    int max_keys = policy ? policy->seed_max_keys : PHT_SEED_MAX_KEYS;
+    return (max_keys > PHT_SEED_LIMIT) ? PHT_SEED_LIMIT : max_keys;
+}
+
+/** Indexes all entries of a small PHT with a seed-search MPH, in place.
+ *
+ * The entries are permuted within the existing arrays, so the rebuild needs
+ * no allocation, and the index itself is just the seed kept in the PHT.
+ *
+ * \param pht Pointer to a CMPH PHT with at most PHT_SEED_LIMIT entries and
+ *            no tombstones.
+ * \returns 1 on success, 0 if no seed was found (the PHT is unchanged).
+ */
+static int pht_seed_rebuild(PHT* pht) {
+    int n = pht->size;
+    uint32_t seed;
+    uint64_t start = pht_build_begin(pht->ctx, TRACE_BUILD_SEED, pht->bucket, n);
+    if (!pht_seed_search(pht, n, &seed)) {
+        pht_build_end(pht->ctx, TRACE_BUILD_SEED, pht->bucket, n, start, 0);
+        return 0;
     }
 
-    // Build the MPH function using CHD algorithm
+    // Cycle every entry into its slot, carrying its fingerprint along
+    for (int i = 0; i < n; i++) {
+        int slot = pht_seed_slot(pht->entries[i]->hash, seed, n);
+        while (slot != i) {
+            pair_t* entry = pht->entries[slot];
+            uint8_t tag = pht->tags[slot];
+            pht->entries[slot] = pht->entries[i];
+            pht->tags[slot] = pht->tags[i];
+            pht->entries[i] = entry;
+            pht->tags[i] = tag;
+            slot = pht_seed_slot(pht->entries[i]->hash, seed, n);
+        }
+    }
+    pht->generation++; // A pending rebuild's snapshot no longer matches
+
+    if (pht->mph) {
+        pht_release_mph(pht, pht->mph);
+        pht->mph = NULL;
+    }
+    pht->seed = seed;
+    pht->mph_size = n;
+    pht_build_end(pht->ctx, TRACE_BUILD_SEED, pht->bucket, n, start, 1);
+    return 1;
+}
 
-    // Create an input adapter that allows CMPH to read the keys
-    cmph_io_adapter_t* source = cmph_io_vector_adapter(keys, pht->size);
+/** Structure for a background MPH rebuild of one PHT.
+ *
+ * The job owns a private copy of the keys of the pairs in entries[0, span)
+ * taken when it was submitted, so the worker never touches the PHT or its
+ * pairs. The result is an MPH together with the slot of every snapshot pair;
+ * installing it is a pointer permutation done by the PHT owner.
+ *
+ * \param base Generic job header (must be first).
+ * \param generation PHT generation at submission time.
+ * \param n Number of snapshot pairs.
+ * \param span Number of entries covered by the snapshot, tombstones included.
+ * \param keys Copies of the n snapshot keys in CMPH byte-vector format
+ *             (a cmph_uint32 length followed by the key bytes).
+ * \param source source[i] is the index in entries of snapshot pair i.
+ * \param mph The MPH built by the worker (NULL if the build failed).
+ * \param perm perm[i] is the MPH slot of snapshot pair i.
+ * \param ops The MPH algorithm, chosen from n when the job was created.
+ * \param ctx Context of the PHT, which the build is counted and traced in
+ *            (it outlives the worker), or NULL.
+ * \param bucket Directory index of the PHT, for the trace.
+ */
+typedef struct PHTRebuildJob {
+    rebuild_job_t base;
+    unsigned int generation;
+    int n;
+    int span;
+    cmph_uint8** keys;
+    int* source;
+    cmph_t* mph;
+    int* perm;
+    const pht_mph_ops_t* ops;
+    const pht_context_t* ctx;
+    int bucket;
+} pht_rebuild_job_t;
+
+/** Builds an MPH over a set of keys with one CMPH algorithm.
+ *
+ * \param algo The CMPH algorithm.
+ * \param keys Array of keys in CMPH byte-vector format.
+ * \param n Number of keys.
+ * \returns The new MPH, or NULL if construction failed.
+ */
+static cmph_t* pht_build_cmph(CMPH_ALGO algo, cmph_uint8** keys, int n) {
+    // Create an input adapter that allows CMPH to read the binary keys
+    cmph_io_adapter_t* source = cmph_io_byte_vector_adapter(keys, n);
 
     // Create a new CMPH confgiuration object using the provided keys
     // Used to specify the parameters for building the MPH
     cmph_config_t* config = cmph_config_new(source);
 
-    // Set the algorithm to CHD for building the MOH
-    cmph_config_set_algo(config, CMPH_CHD);
+    // Set the algorithm used to build the MPH
+    cmph_config_set_algo(config, algo);
 
     // No additional information should be printed during the build process
     cmph_config_set_verbosity(config, 0);
@@ -58,145 +499,753 @@ static void pht_rebuild(PHT* pht) {
     // Destroy (free) the configuration object and the input adapter
     // as they are no longer needed after the MPH is built
     cmph_config_destroy(config);
-    cmph_io_vector_adapter_destroy(source);
+    cmph_io_byte_vector_adapter_destroy(source);
+    return mph;
+}
+
+// Builders of the algorithms offered as pht_mph_ops_t
+static cmph_t* pht_build_chd(cmph_uint8** keys, int n) {
+    return pht_build_cmph(CMPH_CHD, keys, n);
+}
 
-    // Free the keys array as it is no longer needed
-    free(keys);
+static cmph_t* pht_build_bdz(cmph_uint8** keys, int n) {
+    return pht_build_cmph(CMPH_BDZ, keys, n);
+}
+
+static cmph_t* pht_build_bmz(cmph_uint8** keys, int n) {
+    return pht_build_cmph(CMPH_BMZ, keys, n);
+}
 
-    // Allocate a new array of entries
-    pair_t** new_entries = (pair_t**)calloc(pht->size, sizeof(pair_t*));
-    if (!new_entries) {
-        cmph_destroy(mph);  // Free the mph if memory allocation failed
+static cmph_t* pht_build_chm(cmph_uint8** keys, int n) {
+    return pht_build_cmph(CMPH_CHM, keys, n);
+}
+
+const pht_mph_ops_t pht_mph_chd = { "chd", pht_build_chd };
+const pht_mph_ops_t pht_mph_bdz = { "bdz", pht_build_bdz };
+const pht_mph_ops_t pht_mph_bmz = { "bmz", pht_build_bmz };
+const pht_mph_ops_t pht_mph_chm = { "chm", pht_build_chm };
+
+void pht_mph_policy_init(pht_mph_policy_t* policy) {
+    if (!policy) {
         return;
     }
+    policy->seed_max_keys = PHT_SEED_MAX_KEYS;
+    policy->count = 0;
+    policy->large = &pht_mph_chd;
+}
 
-    // Populate the new entries array using the MPH
-    for (int i = 0; i < pht->size; i++) {
-        pair_t* entry = pht->entries[i];
-        unsigned int hash = cmph_search(mph, entry->key, (cmph_uint32)strlen(entry->key));
-        hash = hash % pht->size;
-        new_entries[hash] = entry;
+int pht_mph_policy_add_tier(pht_mph_policy_t* policy, int max_keys, const pht_mph_ops_t* ops) {
+    if (!policy || !ops || policy->count >= PHT_MPH_POLICY_TIERS) {
+        return 0; // Invalid parameters or no tier left
+    }
+    if (policy->count > 0 && max_keys <= policy->tiers[policy->count - 1].max_keys) {
+        return 0; // Tiers must be added in ascending order
+    }
+    policy->tiers[policy->count].max_keys = max_keys;
+    policy->tiers[policy->count].ops = ops;
+    policy->count++;
+    return 1;
+}
+
+const pht_mph_ops_t* pht_mph_policy_select(const pht_mph_policy_t* policy, int n) {
+    if (!policy) {
+        return &pht_mph_chd;
+    }
+    for (int i = 0; i < policy->count; i++) {
+        if (n <= policy->tiers[i].max_keys) {
+            return policy->tiers[i].ops;
+        }
+    }
+    return policy->large ? policy->large : &pht_mph_chd;
+}
+
+cmph_t* pht_build_mph(cmph_uint8** keys, int n) {
+    return pht_build_chd(keys, n);
+}
+
+cmph_t* pht_build_mph_with(const pht_mph_ops_t* ops, cmph_uint8** keys, int n) {
+    if (!ops) {
+        ops = &pht_mph_chd;
+    }
+    cmph_t* mph = ops->build(keys, n);
+    if (!mph && ops != &pht_mph_chd) {
+        mph = pht_build_chd(keys, n); // The algorithm gave up on these keys
+    }
+    return mph;
+}
+
+/** Installs a new MPH built over the pairs of a rebuild job's snapshot.
+ *
+ * The snapshot pairs are permuted into their MPH slots and the delta area
+ * (entries span to size) is kept behind them; tombstones the snapshot left
+ * out are dropped. A snapshot pair removed since then leaves a tombstone in
+ * its new slot. The entries array is trimmed to the new size. On failure the
+ * PHT is left unchanged.
+ *
+ * \param pht Pointer to the PHT.
+ * \param job The finished job; its mph passes to the PHT on success.
+ * \returns 1 on success, 0 on failure (memory allocation error).
+ */
+static int pht_install_mph(PHT* pht, pht_rebuild_job_t* job) {
+    int n = job->n;
+    int new_size = n + (pht->size - job->span);
+
+    // Allocate new arrays of entries and fingerprints
+    int new_capacity = (new_size > 0) ? new_size : 1;
+    pair_t** new_entries = (pair_t**)calloc(new_capacity, sizeof(pair_t*));
+    uint8_t* new_tags = (uint8_t*)calloc(new_capacity, sizeof(uint8_t));
+    if (!new_entries || !new_tags) {
+        free(new_entries);
+        free(new_tags);
+        return 0;
+    }
+
+    // Populate the new entries array using the MPH, then append the delta area
+    int tombstones = 0;
+    for (int i = 0; i < n; i++) {
+        new_entries[job->perm[i]] = pht->entries[job->source[i]];
+        new_tags[job->perm[i]] = pht->tags[job->source[i]];
+        tombstones += (pht->entries[job->source[i]] == NULL);
+    }
+    for (int i = job->span; i < pht->size; i++) {
+        new_entries[n + i - job->span] = pht->entries[i];
+        new_tags[n + i - job->span] = pht->tags[i];
     }
 
     free(pht->entries); // Free the old entries array
+    free(pht->tags);
     pht->entries = new_entries; // Assign the new entries array
-    pht->capacity = pht->size; // Update the capacity to the current size
+    pht->tags = new_tags;
+    pht->capacity = new_capacity; // Update the capacity to the current size
+    pht->size = new_size;
+    pht->tombstones = tombstones;
 
     // Replace the old MPH (if it exists) with the new one
     if (pht->mph) {
-        cmph_destroy(pht->mph);
+        pht_release_mph(pht, pht->mph);
     }
-    pht->mph = mph;
+    pht->mph = job->mph;
+    pht->mph_size = n;
+    job->mph = NULL; // Ownership moved to the PHT
+    return 1;
 }
 
-PHT* pht_create(int initial_capacity) {
-    if (initial_capacity < 1) {
-        initial_capacity = PHT_DEFAULT_CAPACITY;
+/** Runs a rebuild job, either on the worker thread or inline.
+ *
+ * \param base Pointer to the pht_rebuild_job_t.
+ */
+static void pht_job_run(rebuild_job_t* base) {
+    pht_rebuild_job_t* job = (pht_rebuild_job_t*)base;
+    uint64_t start = pht_build_begin(job->ctx, TRACE_BUILD_CMPH, job->bucket, job->n);
+    job->mph = pht_build_mph_with(job->ops, job->keys, job->n);
+    pht_build_end(job->ctx, TRACE_BUILD_CMPH, job->bucket, job->n, start, job->mph != NULL);
+    if (!job->mph) {
+        return; // Build failed, the owner keeps its delta area
+    }
+    for (int i = 0; i < job->n; i++) {
+        cmph_uint32 len;
+        memcpy(&len, job->keys[i], sizeof(len));
+        unsigned int hash = cmph_search(job->mph, (const char*)job->keys[i] + sizeof(len), len);
+        job->perm[i] = hash % job->n;
     }
+}
 
-    PHT* pht = (PHT*)malloc(sizeof(PHT));
-    if (!pht) {
-        return NULL; // Memory allocation failed
+/** Frees a rebuild job and the MPH it still owns, if any.
+ *
+ * \param base Pointer to the pht_rebuild_job_t.
+ */
+static void pht_job_destroy(rebuild_job_t* base) {
+    pht_rebuild_job_t* job = (pht_rebuild_job_t*)base;
+    if (job->mph) {
+        cmph_destroy(job->mph);
     }
+    free(job);
+}
 
-    // Initialize the PHT with the given initial capacity and default values
-    pht->capacity = initial_capacity;
-    pht->size = 0;
-    pht->entries = (pair_t**)calloc(initial_capacity, sizeof(pair_t*));
+/** Creates a rebuild job over all current pairs of a PHT.
+ *
+ * The job, its key pointers, its source indexes, its result permutation and
+ * the key bytes are carved out of a single allocation. Tombstones are skipped.
+ *
+ * \param pht Pointer to the PHT.
+ * \returns The new job, or NULL on failure (memory allocation error).
+ */
+static pht_rebuild_job_t* pht_make_job(const PHT* pht) {
+    int n = pht->size - pht->tombstones;
+    size_t key_bytes = 0;
+    for (int i = 0; i < pht->size; i++) {
+        if (pht->entries[i]) {
+            key_bytes += sizeof(cmph_uint32) + pht->entries[i]->key_len;
+        }
+    }
 
-    if (!pht->entries) {
-        free(pht);
+    size_t header = sizeof(pht_rebuild_job_t) + sizeof(cmph_uint8*) * n + 2 * sizeof(int) * n;
+    pht_rebuild_job_t* job = (pht_rebuild_job_t*)malloc(header + key_bytes);
+    if (!job) {
         return NULL; // Memory allocation failed
     }
+    job->base.run = pht_job_run;
+    job->base.destroy = pht_job_destroy;
+    job->generation = pht->generation;
+    job->n = n;
+    job->span = pht->size;
+    job->keys = (cmph_uint8**)(job + 1);
+    job->source = (int*)(job->keys + n);
+    job->perm = job->source + n;
+    job->mph = NULL;
+    job->ops = pht_mph_policy_select(pht->ctx ? pht->ctx->mph_policy : NULL, n);
+    job->ctx = pht->ctx;
+    job->bucket = pht->bucket;
 
-    // Initialize the entries array to NULL
-    for (int i = 0; i < initial_capacity; i++) {
-        pht->entries[i] = NULL;
+    // Copy the keys so the worker never reads pairs owned by the PHT
+    cmph_uint8* cursor = (cmph_uint8*)job + header;
+    int k = 0;
+    for (int i = 0; i < pht->size; i++) {
+        const pair_t* pair = pht->entries[i];
+        if (!pair) {
+            continue; // Tombstone
+        }
+        cmph_uint32 len = (cmph_uint32)pair->key_len;
+        memcpy(cursor, &len, sizeof(len));
+        memcpy(cursor + sizeof(len), pair->key, len);
+        job->keys[k] = cursor;
+        job->source[k++] = i;
+        cursor += sizeof(len) + len;
     }
-
-    pht->mph = NULL; // Initialize the MPH to NULL
-    return pht;
+    return job;
 }
 
 /** Resizes the PHT to a new capacity.
  *
- * This function reallocates the entries array to accommodate more entries.
+ * This function reallocates the entries array to accommodate more entries,
+ * or to give back the room of entries that are no longer used.
  *
  * \param pht Pointer to the PHT to be resized.
- * \param new_capacity The new capacity for the PHT.
+ * \param new_capacity The new capacity for the PHT, at least its size.
  * \returns 1 on success, 0 on failure (e.g., memory allocation error).
  */
 static int pht_resize(PHT* pht, int new_capacity) {
-    if (!pht || new_capacity <= pht->size) {
+    if (!pht || new_capacity < 1 || new_capacity < pht->size) {
         return 0; // Invalid parameters
     }
+    int growing = new_capacity > pht->capacity;
 
     // Allocate a new array with the new capacity
     // Realloc resizes the memory block pointed to by pht->entries
     // and frees the old memory block if successful
     pair_t** new_entries = (pair_t**)realloc(pht->entries, sizeof(pair_t*) * new_capacity);
-    if (!new_entries) {
+    if (new_entries) {
+        pht->entries = new_entries;
+    }
+    else if (growing) {
         return 0; // Memory allocation failed
     }
 
-    pht->entries = new_entries;
+    // CMPH fingerprints run parallel to the entries array
+    if (pht->backend == PHT_BACKEND_CMPH) {
+        uint8_t* new_tags = (uint8_t*)realloc(pht->tags, new_capacity);
+        if (new_tags) {
+            pht->tags = new_tags;
+        }
+        else if (growing) {
+            return 0; // Memory allocation failed, the larger entries array is kept
+        }
+    }
+
+    // A shrink that failed keeps the larger blocks, which still fit
     pht->capacity = new_capacity;
     return 1; // Success
 }
 
+/** Gives back the room of an entries array that has emptied out.
+ *
+ * Arrays double when they fill up; they are only trimmed once at most a
+ * quarter of them is used, and keep room to double the pairs they hold, so
+ * that a bucket hovering around one size is never resized back and forth.
+ * An FKS bucket re-seeds a slot array sized for the new capacity, so its
+ * quadratic slot array shrinks with it.
+ *
+ * \param pht Pointer to the PHT, with no tombstones.
+ * \param exact If nonzero, trim to exactly the pairs held regardless of the
+ *              hysteresis (as dpht_compact() does).
+ */
+static void pht_trim(PHT* pht, int exact) {
+    int new_capacity = exact ? pht->size : 2 * pht->size;
+    if (!exact) {
+        if (pht->size * 4 > pht->capacity) {
+            return; // Still mostly used
+        }
+        if (new_capacity < PHT_DEFAULT_CAPACITY) {
+            new_capacity = PHT_DEFAULT_CAPACITY;
+        }
+    }
+    if (new_capacity < 1) {
+        new_capacity = 1;
+    }
+    if (new_capacity >= pht->capacity) {
+        return; // Nothing to give back
+    }
+    if (pht->backend == PHT_BACKEND_FKS && !pht_fks_rebuild(pht, new_capacity)) {
+        return; // No seed fits the smaller slot array, keep the current one
+    }
+    pht_resize(pht, new_capacity);
+}
+
+/** Rebuilds the MPH for the current set of keys in the PHT.
+ *
+ * This function reorders the entries array so that the MPH returns the
+ * correct index for each key, leaving the delta area empty. Small buckets
+ * get a seed-search MPH; larger ones (or small ones whose seed search
+ * fails) get a CMPH function.
+ *
+ * \param pht Pointer to the PHT whose MPH needs to be rebuilt.
+ */
+static void pht_rebuild(PHT* pht) {
+    if (!pht) {
+        return; // Invalid PHT
+    }
+
+    // Squeeze out the tombstones first; the new MPH covers live pairs only
+    pht_compact(pht);
+    pht_trim(pht, 0);
+
+    // For a single entry or empty table, skip rebuilding
+    if (pht->size <= 1) {
+        if (pht->mph) { // Free the MPH if it exists
+            pht_release_mph(pht, pht->mph);
+            pht->mph = NULL;
+        }
+        pht->mph_size = 0;
+        return;
+    }
+    if (pht->size <= pht_seed_max_keys(pht) && pht_seed_rebuild(pht)) {
+        return;
+    }
+
+    // Run the same job a background worker would, but inline
+    pht_rebuild_job_t* job = pht_make_job(pht);
+    if (!job) {
+        return; // Memory allocation failed
+    }
+    pht_job_run(&job->base);
+    if (job->mph) {
+        pht_install_mph(pht, job);
+    }
+    pht_job_destroy(&job->base);
+}
+
+/** Submits a background rebuild over all current entries of a PHT.
+ *
+ * \param pht Pointer to the PHT (must have a context with a worker).
+ * \returns 1 on success, 0 on failure (memory allocation error).
+ */
+static int pht_submit_rebuild(PHT* pht) {
+    pht_rebuild_job_t* job = pht_make_job(pht);
+    if (!job) {
+        return 0; // Memory allocation failed
+    }
+    rebuild_worker_submit(pht->ctx->worker, &job->base);
+    pht->job = &job->base;
+    return 1;
+}
+
+/** Installs the result of a finished background rebuild, if there is one.
+ *
+ * Results whose snapshot no longer matches the entries array (the generation
+ * changed) are dropped.
+ *
+ * \param pht Pointer to the PHT.
+ */
+static void pht_poll_rebuild(PHT* pht) {
+    if (!pht->job || !rebuild_job_done(pht->job)) {
+        return; // Nothing finished
+    }
+    pht_rebuild_job_t* job = (pht_rebuild_job_t*)pht->job;
+    if (job->mph && job->generation == pht->generation && job->span <= pht->size) {
+        pht_install_mph(pht, job);
+    }
+    rebuild_worker_release(pht->ctx->worker, pht->job);
+    pht->job = NULL;
+}
+
+/** Rebuilds the MPH of a CMPH PHT now or on the background worker.
+ *
+ * With a background worker the rebuild is submitted as a job and installed
+ * by a later operation; otherwise it runs inline.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ */
+static void pht_schedule_rebuild(PHT* pht) {
+    // Seed searches are cheaper than handing the bucket to the worker
+    int n = pht->size - pht->tombstones;
+    if (!pht->ctx || !pht->ctx->worker || n <= pht_seed_max_keys(pht)) {
+        pht_rebuild(pht);
+        return;
+    }
+
+    // Let a pending rebuild finish unless its snapshot has gone stale
+    if (pht->job) {
+        pht_rebuild_job_t* job = (pht_rebuild_job_t*)pht->job;
+        if (job->generation == pht->generation) {
+            return;
+        }
+        rebuild_worker_release(pht->ctx->worker, pht->job);
+        pht->job = NULL;
+    }
+    pht_submit_rebuild(pht);
+}
+
+/** Rebuilds the MPH if the delta area has grown past the threshold.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ */
+static void pht_maybe_rebuild(PHT* pht) {
+    int threshold = pht->ctx ? pht->ctx->delta_threshold : PHT_DELTA_THRESHOLD;
+    if (pht->size - pht->mph_size <= threshold) {
+        return; // The delta area is still small enough to scan
+    }
+    pht_schedule_rebuild(pht);
+}
+
+/** Compacts and rebuilds the bucket if tombstones fill too many MPH slots.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ */
+static void pht_maybe_compact(PHT* pht) {
+    int percent = pht->ctx ? pht->ctx->tombstone_percent : PHT_TOMBSTONE_PERCENT;
+    if ((long)pht->tombstones * 100 <= (long)pht->mph_size * percent) {
+        return; // Tombstones are still cheaper than a rebuild
+    }
+    pht_schedule_rebuild(pht);
+}
+
+/** Evaluates the MPH of a CMPH PHT for a key.
+ *
+ * Only the MPH itself is read; the candidate entry is not touched. A
+ * seed-search MPH needs nothing but the hash of the key.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns The MPH-indexed slot the key would occupy, or -1 if there is no MPH.
+ */
+static int pht_mph_slot(const PHT* pht, const void* key, size_t len, uint64_t hash) {
+    if (pht->mph_size == 0) {
+        return -1;
+    }
+    if (!pht->mph) {
+        return pht_seed_slot(hash, (uint32_t)pht->seed, pht->mph_size);
+    }
+    unsigned int slot = cmph_search(pht->mph, (const char*)key, (cmph_uint32)len);
+    return (int)(slot % pht->mph_size); // Ensure the slot is within the indexed entries
+}
+
+/** Resolves a key in the entries array of a CMPH PHT from its MPH slot.
+ *
+ * The MPH slot is checked first, then the delta area is scanned.
+ * Fingerprints are compared before any pair is dereferenced, so a miss
+ * normally touches only the tag array.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ * \param slot The MPH slot of the key (see pht_mph_slot()), or -1.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns The index of the key in entries, or -1 if it is not present.
+ */
+static int pht_resolve_index(const PHT* pht, int slot, const void* key, size_t len, uint64_t hash) {
+    uint8_t tag = pht_tag(hash);
+
+    if (slot >= 0 && pht->tags[slot] == tag && pair_matches(pht->entries[slot], key, len, hash)) {
+        return slot;
+    }
+    for (int i = pht->mph_size; i < pht->size; i++) {
+        if (pht->tags[i] == tag && pair_matches(pht->entries[i], key, len, hash)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** Finds the index of a key in the entries array of a CMPH PHT.
+ *
+ * A finished background rebuild is installed first, then the key is
+ * resolved through the MPH and the delta area.
+ *
+ * \param pht Pointer to a CMPH PHT.
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns The index of the key in entries, or -1 if it is not present.
+ */
+static int pht_find_index(PHT* pht, const void* key, size_t len, uint64_t hash) {
+    pht_poll_rebuild(pht);
+    return pht_resolve_index(pht, pht_mph_slot(pht, key, len, hash), key, len, hash);
+}
+
+PHT* pht_create(int initial_capacity) {
+    return pht_create_with_backend(initial_capacity, PHT_BACKEND_CMPH);
+}
+
+PHT* pht_create_with_backend(int initial_capacity, pht_backend_t backend) {
+    if (initial_capacity < 1) {
+        initial_capacity = PHT_DEFAULT_CAPACITY;
+    }
+    if (backend == PHT_BACKEND_FKS && initial_capacity > PHT_FKS_MAX_CAPACITY) {
+        return NULL; // The slot array would be too large
+    }
+
+    PHT* pht = (PHT*)malloc(sizeof(PHT));
+    if (!pht) {
+        return NULL; // Memory allocation failed
+    }
+
+    // Initialize the PHT with the given initial capacity and default values
+    pht->capacity = initial_capacity;
+    pht->size = 0;
+    pht->entries = (pair_t**)calloc(initial_capacity, sizeof(pair_t*));
+    pht->tags = NULL;
+    if (backend == PHT_BACKEND_CMPH) {
+        pht->tags = (uint8_t*)calloc(initial_capacity, sizeof(uint8_t));
+    }
+
+    if (!pht->entries || (backend == PHT_BACKEND_CMPH && !pht->tags)) {
+        free(pht->entries);
+        free(pht->tags);
+        free(pht);
+        return NULL; // Memory allocation failed
+    }
+
+    // Initialize the entries array to NULL
+    for (int i = 0; i < initial_capacity; i++) {
+        pht->entries[i] = NULL;
+    }
+
+    pht->mph = NULL; // Initialize the MPH to NULL
+    pht->backend = backend;
+    pht->slots = NULL;
+    pht->slot_count = 0;
+    pht->seed = PHT_FKS_INITIAL_SEED;
+    pht->mph_size = 0;
+    pht->tombstones = 0;
+    pht->generation = 0;
+    pht->job = NULL;
+    pht->ctx = NULL;
+    pht->bucket = -1;
+
+    // The FKS backend keeps a quadratic slot array next to the entries
+    if (backend == PHT_BACKEND_FKS) {
+        pht->slot_count = (int)((size_t)initial_capacity * (size_t)initial_capacity);
+        pht->slots = (pair_t**)calloc(pht->slot_count, sizeof(pair_t*));
+        pht->tags = (uint8_t*)calloc(pht->slot_count, sizeof(uint8_t));
+        if (!pht->slots || !pht->tags) {
+            free(pht->slots);
+            free(pht->tags);
+            free(pht->entries);
+            free(pht);
+            return NULL; // Memory allocation failed
+        }
+    }
+    return pht;
+}
+
 int pht_insert(PHT* pht, pair_t* new_pair) {
     if (!pht || !new_pair) {
         return 0; // Invalid parameters
     }
 
     // Resize if necessary
+    int grown = 0;
     if (pht->size >= pht->capacity) {
-        if (!pht_resize(pht, pht->capacity * 2)) {
+        int new_capacity = pht->capacity * 2;
+        if (new_capacity < PHT_DEFAULT_CAPACITY) {
+            new_capacity = PHT_DEFAULT_CAPACITY;
+        }
+        if (pht->backend == PHT_BACKEND_FKS && new_capacity > PHT_FKS_MAX_CAPACITY) {
+            if (pht->capacity >= PHT_FKS_MAX_CAPACITY) {
+                return 0; // The bucket would outgrow its slot array
+            }
+            new_capacity = PHT_FKS_MAX_CAPACITY;
+        }
+        if (!pht_resize(pht, new_capacity)) {
             return 0; // Memory allocation failed
         }
+        grown = 1;
     }
     // Insert the new pair at the end of the entries array
     pht->entries[pht->size] = new_pair;
     pht->size++;
 
-    // Invalidate the MPH to force a rebuild on next operation
-    pht->mph = NULL;
+    if (pht->backend == PHT_BACKEND_FKS) {
+        // Place the pair in its slot directly if the slot is free and the
+        // slot array still matches the entries capacity
+        if (!grown) {
+            int slot = pht_fks_slot(pht, new_pair->key, new_pair->key_len);
+            if (!pht->slots[slot]) {
+                pht->slots[slot] = new_pair;
+                pht->tags[slot] = pht_tag(new_pair->hash);
+                return 1;
+            }
+        }
+        // Otherwise re-seed (and regrow) the slot array
+        if (!pht_fks_rebuild(pht, pht->capacity)) {
+            pht->size--; // Undo the insertion
+            pht->entries[pht->size] = NULL;
+            return 0;
+        }
+        return 1;
+    }
+
+    // The new pair stays in the delta area until the next rebuild
+    pht->tags[pht->size - 1] = pht_tag(new_pair->hash);
+    pht_maybe_rebuild(pht);
     return 1;
 }
 
-char* pht_search(PHT* pht, const char* key) {
-    if (!pht || !key || pht->size == 0) {
-        return NULL; // Invalid PHT or key
+int pht_insert_batch(PHT* pht, pair_t** pairs, int n) {
+    if (!pht || !pairs || n < 0) {
+        return 0; // Invalid parameters
+    }
+    if (n == 0) {
+        return 1; // Nothing to insert
     }
 
-    // If there's only one element, return its value if the key matches.
-    if (pht->size == 1) {
-        if (strcmp(pht->entries[0]->key, key) == 0) {
-            return pht->entries[0]->value;
+    if (pht->backend == PHT_BACKEND_FKS && n > PHT_FKS_MAX_CAPACITY - pht->size) {
+        return 0; // The bucket would outgrow its slot array
+    }
+
+    // Make room for the whole batch at once
+    if (pht->size + n > pht->capacity) {
+        int new_capacity = pht->capacity * 2;
+        if (new_capacity < pht->size + n) {
+            new_capacity = pht->size + n;
         }
-        else {
-            return NULL;
+        if (!pht_resize(pht, new_capacity)) {
+            return 0; // Memory allocation failed
         }
     }
 
-    // Lazy rebuild: if the MPH is not built, build it now
-    if (!pht->mph) {
+    // Append every pair behind the current entries
+    int old_size = pht->size;
+    for (int i = 0; i < n; i++) {
+        pht->entries[old_size + i] = pairs[i];
+        if (pht->backend == PHT_BACKEND_CMPH) {
+            pht->tags[old_size + i] = pht_tag(pairs[i]->hash);
+        }
+    }
+    pht->size += n;
+
+    if (pht->backend == PHT_BACKEND_FKS) {
+        // Place the whole bucket with a single seed search
+        if (!pht_fks_rebuild(pht, pht->capacity)) {
+            pht->size = old_size; // Undo the insertion
+            return 0;
+        }
+        return 1;
+    }
+
+    // Index the whole bucket with a single MPH build
+    if (!pht->ctx || !pht->ctx->worker || pht->size <= pht_seed_max_keys(pht)) {
         pht_rebuild(pht);
+        return 1;
     }
-    if (!pht->mph) {
-        return NULL; // Memory allocation failed for MPH
+    if (pht->job) {
+        rebuild_worker_release(pht->ctx->worker, pht->job); // Covers only part of the bucket
+        pht->job = NULL;
     }
+    pht_submit_rebuild(pht);
+    return 1;
+}
 
-    unsigned int hash = cmph_search(pht->mph, key, (cmph_uint32)strlen(key));
-    hash = hash % pht->size; // Ensure the hash is within the bounds of the entries array
-    pair_t* entry = pht->entries[hash];
+char* pht_search(PHT* pht, const char* key) {
+    if (!pht || !key) {
+        return NULL; // Invalid PHT or key
+    }
+    size_t len = strlen(key);
+    return (char*)pht_search_n(pht, key, len, hash_bytes(key, len), NULL);
+}
+
+pair_t* pht_find_n(PHT* pht, const void* key, size_t key_len, uint64_t hash) {
+    if (!pht || !key || pht->size == 0) {
+        return NULL; // Invalid PHT or key
+    }
+
+    if (pht->backend == PHT_BACKEND_FKS) {
+        // FKS: a single slot probe, no rebuild required
+        int slot = pht_fks_find(pht, key, key_len, hash);
+        return (slot >= 0) ? pht->slots[slot] : NULL;
+    }
+
+    // Probe the MPH-indexed entries, then scan the delta area
+    int index = pht_find_index(pht, key, key_len, hash);
+    return (index >= 0) ? pht->entries[index] : NULL;
+}
+
+void* pht_search_n(PHT* pht, const void* key, size_t key_len, uint64_t hash, size_t* value_len) {
+    pair_t* entry = pht_find_n(pht, key, key_len, hash);
+    if (!entry) {
+        return NULL; // Key not found
+    }
+    if (value_len) {
+        *value_len = entry->value_len;
+    }
+    return entry->value;
+}
+
+void pht_sync(PHT* pht) {
+    if (pht && pht->backend == PHT_BACKEND_CMPH) {
+        pht_poll_rebuild(pht);
+    }
+}
+
+int pht_probe(const PHT* pht, const void* key, size_t key_len, uint64_t hash) {
+    if (!pht || !key || pht->size == 0) {
+        return -1;
+    }
+
+    int slot = (pht->backend == PHT_BACKEND_FKS) ? pht_fks_slot(pht, key, key_len)
+                                                 : pht_mph_slot(pht, key, key_len, hash);
+    if (slot >= 0) {
+        // Start loading the fingerprint and the pair pointer of the candidate
+        __builtin_prefetch(&pht->tags[slot]);
+        __builtin_prefetch((pht->backend == PHT_BACKEND_FKS) ? &pht->slots[slot] : &pht->entries[slot]);
+    }
+    return slot;
+}
+
+void pht_prefetch_candidate(const PHT* pht, int slot, uint64_t hash) {
+    if (!pht || slot < 0 || pht->tags[slot] != pht_tag(hash)) {
+        return; // Nothing worth loading
+    }
+    __builtin_prefetch((pht->backend == PHT_BACKEND_FKS) ? pht->slots[slot] : pht->entries[slot]);
+}
+
+void* pht_search_candidate(const PHT* pht, int slot, const void* key, size_t key_len,
+                           uint64_t hash, size_t* value_len) {
+    if (!pht || !key || pht->size == 0) {
+        return NULL;
+    }
+
+    pair_t* entry = NULL;
+    if (pht->backend == PHT_BACKEND_FKS) {
+        if (slot >= 0 && pht->tags[slot] == pht_tag(hash) &&
+            pair_matches(pht->slots[slot], key, key_len, hash)) {
+            entry = pht->slots[slot];
+        }
+    }
+    else {
+        int index = pht_resolve_index(pht, slot, key, key_len, hash);
+        entry = (index >= 0) ? pht->entries[index] : NULL;
+    }
 
-    // If the entry exists and the key matches, return its value
-    // Otherwise, return NULL
-    if (entry && strcmp(entry->key, key) == 0) {
-        return entry->value;
+    if (!entry) {
+        return NULL; // Key not found
     }
-    return NULL;
+    if (value_len) {
+        *value_len = entry->value_len;
+    }
+    return entry->value;
 }
 
 int pht_lookup(PHT* pht, const char* key) {
@@ -204,84 +1253,288 @@ int pht_lookup(PHT* pht, const char* key) {
 }
 
 int pht_update(PHT* pht, const char* key, const char* new_value) {
-    if (!pht || !key || !new_value || pht->size == 0) {
+    if (!pht || !key || !new_value) {
         return 0; // Invalid parameters
     }
-    if (pht->size == 1) { // Check that the key matches
-        if (strcmp(pht->entries[0]->key, key) == 0) {
-            return pair_update_value(pht->entries[0], new_value);
-        }
-        return 0;
+    size_t len = strlen(key);
+    return pht_update_n(pht, key, len, hash_bytes(key, len), new_value, strlen(new_value));
+}
+
+int pht_update_n(PHT* pht, const void* key, size_t key_len, uint64_t hash,
+                 const void* new_value, size_t value_len) {
+    if (!pht || !key || !new_value || pht->size == 0) {
+        return 0; // Invalid parameters
     }
 
-    // Lazy rebuild if needed
-    if (!pht->mph) {
-        pht_rebuild(pht);
+    pair_t** location = NULL;
+    if (pht->backend == PHT_BACKEND_FKS) {
+        int slot = pht_fks_find(pht, key, key_len, hash);
+        location = (slot >= 0) ? &pht->slots[slot] : NULL;
     }
-    if (!pht->mph) {
-        return 0; // Memory allocation failed for MPH
+    else {
+        int index = pht_find_index(pht, key, key_len, hash);
+        location = (index >= 0) ? &pht->entries[index] : NULL;
+    }
+    if (!location) {
+        return 0; // Key not found
     }
 
-    unsigned int hash = cmph_search(pht->mph, key, (cmph_uint32)strlen(key));
-    pair_t* entry = pht->entries[hash];
+    pair_t* entry = *location;
+    if (!pht_epoch(pht)) {
+        return pair_update_value_n(pht_arena(pht), entry, new_value, value_len);
+    }
 
-    if (entry && strcmp(entry->key, key) == 0) {    // Key found
-        return pair_update_value(entry, new_value);
+    // Concurrent readers may be reading the value: swap in a new pair instead
+    pair_t* copy = pair_create_n(pht_arena(pht), entry->key, entry->key_len,
+                                 new_value, value_len, entry->hash);
+    if (!copy) {
+        return 0; // Memory allocation failed
     }
-    return 0; // Key not found
+    *location = copy;
+    if (pht->backend == PHT_BACKEND_FKS) {
+        // The unordered entries list of an FKS PHT references the pair too
+        for (int i = 0; i < pht->size; i++) {
+            if (pht->entries[i] == entry) {
+                pht->entries[i] = copy;
+                break;
+            }
+        }
+    }
+    pht_release_pair(pht, entry);
+    return 1;
 }
 
 void pht_remove_entry(PHT* pht, const char* key) {
-    if (!pht || !key || pht->size == 0) {
+    if (!pht || !key) {
         return; // Invalid parameters
     }
+    size_t len = strlen(key);
+    pht_remove_n(pht, key, len, hash_bytes(key, len));
+}
 
-    // If there's only one element, delete the only entry and free the MPH
-    if (pht->size == 1) {
-        if (strcmp(pht->entries[0]->key, key) == 0) {
-            pair_free(pht->entries[0]);
-            pht->entries[0] = NULL;
-            pht->size = 0;
-            if (pht->mph) {
-                cmph_destroy(pht->mph);
-                pht->mph = NULL;
+int pht_remove_n(PHT* pht, const void* key, size_t key_len, uint64_t hash) {
+    if (!pht || !key || pht->size == 0) {
+        return 0; // Invalid parameters
+    }
+
+    // FKS: clear the slot and remove the pair from the unordered entries list
+    if (pht->backend == PHT_BACKEND_FKS) {
+        int slot = pht_fks_find(pht, key, key_len, hash);
+        if (slot < 0) {
+            return 0; // Key not found
+        }
+        pair_t* entry = pht->slots[slot];
+        pht->slots[slot] = NULL;
+        pht->tags[slot] = 0;
+        for (int i = 0; i < pht->size; i++) {
+            if (pht->entries[i] == entry) {
+                pht->entries[i] = pht->entries[pht->size - 1];
+                pht->entries[pht->size - 1] = NULL;
+                break;
             }
         }
-        return;
+        pht->size--;
+        pht_release_pair(pht, entry);
+        pht_trim(pht, 0);
+        return 1;
+    }
+
+    int index = pht_find_index(pht, key, key_len, hash);
+    if (index < 0) {
+        return 0; // Key not found
     }
+    pht_release_pair(pht, pht->entries[index]);
 
-    // For 2 or more elements, use the MPH to find the key
-    // Lazy rebuild if needed
-    if (pht->mph == NULL) {
+    // An MPH-indexed entry leaves a tombstone, so the MPH stays valid and
+    // no entry moves (a pending rebuild still matches)
+    if (index < pht->mph_size) {
+        pht->entries[index] = NULL;
+        pht->tags[index] = 0;
+        pht->tombstones++;
+        pht_maybe_compact(pht);
+        return 1;
+    }
+
+    // Replace the deleted element with the last element
+    // because all entries are stored in a contiguous array
+    pht->entries[index] = pht->entries[pht->size - 1];
+    pht->tags[index] = pht->tags[pht->size - 1];
+    pht->entries[pht->size - 1] = NULL;
+    pht->size--;
+    pht->generation++; // Snapshots of pending rebuilds no longer match
+    pht_maybe_rebuild(pht);
+    return 1;
+}
+
+int pht_move_entries(PHT* source, PHT* target, int (*moves)(const pair_t* pair, void* arg), void* arg) {
+    if (!source || !target || !moves || source == target) {
+        return 0; // Invalid parameters
+    }
+    if (source->backend == PHT_BACKEND_CMPH) {
+        pht_poll_rebuild(source);
+    }
+
+    // Compact the entries that stay to the front of the array
+    int kept = 0;
+    int moved = 0;
+    for (int i = 0; i < source->size; i++) {
+        pair_t* entry = source->entries[i];
+        if (entry && moves(entry, arg) && pht_insert(target, entry)) {
+            if (source->backend == PHT_BACKEND_FKS) {
+                // The remaining keys stay collision-free under the current seed
+                int slot = pht_fks_slot(source, entry->key, entry->key_len);
+                source->slots[slot] = NULL;
+                source->tags[slot] = 0;
+            }
+            moved++;
+            continue;
+        }
+        if (source->backend == PHT_BACKEND_CMPH) {
+            source->tags[kept] = source->tags[i];
+        }
+        source->entries[kept++] = entry;
+    }
+    if (moved == 0) {
+        return 0; // Nothing changed, the MPH stays valid
+    }
+    for (int i = kept; i < source->size; i++) {
+        source->entries[i] = NULL;
+    }
+    source->size = kept;
+
+    if (source->backend == PHT_BACKEND_FKS) {
+        pht_trim(source, 0);
+        return moved;
+    }
+
+    // Every remaining entry is now staged until the next rebuild
+    pht_compact(source);
+    if (source->mph) {
+        pht_release_mph(source, source->mph);
+        source->mph = NULL;
+    }
+    source->mph_size = 0;
+    source->generation++;
+    pht_maybe_rebuild(source);
+    return moved;
+}
+
+int pht_repack(PHT* pht) {
+    if (!pht) {
+        return 0; // Invalid PHT
+    }
+    if (pht->backend == PHT_BACKEND_FKS) {
+        pht_trim(pht, 1);
+        return 1;
+    }
+
+    // Drop a pending background rebuild: the bucket is indexed here and now
+    pht_poll_rebuild(pht);
+    if (pht->job) {
+        rebuild_worker_release(pht->ctx->worker, pht->job);
+        pht->job = NULL;
+    }
+    if (pht->tombstones > 0 || pht->mph_size < pht->size) {
         pht_rebuild(pht);
     }
-    if (!pht->mph) {
-        return; // Memory allocation failed for MPH
+    if (pht->tombstones == 0) {
+        pht_trim(pht, 1);
     }
+    return (pht->size <= 1 || pht->mph_size == pht->size) ? 1 : 0;
+}
 
-    unsigned int hash = cmph_search(pht->mph, key, (cmph_uint32)strlen(key));
-    pair_t* entry = pht->entries[hash];
-    if (entry && strcmp(entry->key, key) == 0) {
-        pair_free(entry);
-        // Replace the deleted element with the last element
-        // because all entries are stored in a contiguous array
-        pht->entries[hash] = pht->entries[pht->size - 1];
-        pht->size--;
-        pht->mph = NULL; // Invalidate the MPH to force a rebuild on next operation
+PHT* pht_clone(const PHT* pht) {
+    if (!pht) {
+        return NULL; // Invalid PHT
+    }
+
+    PHT* copy = (PHT*)malloc(sizeof(PHT));
+    if (!copy) {
+        return NULL; // Memory allocation failed
+    }
+    *copy = *pht;
+    copy->job = NULL;
+    copy->slots = NULL;
+
+    // The fingerprints run parallel to the slots for FKS, to the entries otherwise
+    size_t tag_count = (pht->backend == PHT_BACKEND_FKS) ? (size_t)pht->slot_count : (size_t)pht->capacity;
+    copy->entries = (pair_t**)malloc(sizeof(pair_t*) * pht->capacity);
+    copy->tags = (uint8_t*)malloc(tag_count);
+    if (pht->slots) {
+        copy->slots = (pair_t**)malloc(sizeof(pair_t*) * pht->slot_count);
+    }
+    if (!copy->entries || !copy->tags || (pht->slots && !copy->slots)) {
+        pht_delete_shell(copy);
+        return NULL; // Memory allocation failed
+    }
+    memcpy(copy->entries, pht->entries, sizeof(pair_t*) * pht->capacity);
+    memcpy(copy->tags, pht->tags, tag_count);
+    if (pht->slots) {
+        memcpy(copy->slots, pht->slots, sizeof(pair_t*) * pht->slot_count);
+    }
+    return copy;
+}
+
+void pht_add_usage(const PHT* pht, pht_usage_t* usage) {
+    if (!pht || !usage) {
+        return;
+    }
+    usage->tombstones += (size_t)pht->tombstones;
+    usage->pending += (pht->job != NULL);
+    usage->table_bytes += sizeof(PHT);
+    usage->entries_bytes += (size_t)pht->capacity * sizeof(pair_t*);
+    if (pht->backend == PHT_BACKEND_FKS) {
+        // FKS fingerprints run parallel to the slots, not to the entries
+        usage->entries_bytes += (size_t)pht->slot_count * (sizeof(pair_t*) + sizeof(uint8_t));
+    }
+    else {
+        usage->entries_bytes += (size_t)pht->capacity * sizeof(uint8_t);
+        usage->staged += (size_t)(pht->size - pht->mph_size);
+    }
+    if (pht->mph) {
+        usage->mph_bytes += cmph_packed_size(pht->mph);
+    }
+    for (int i = 0; i < pht->size; i++) {
+        const pair_t* pair = pht->entries[i];
+        if (!pair) {
+            continue; // Tombstone
+        }
+        usage->keys++;
+        usage->pair_bytes += sizeof(pair_t);
+        usage->key_bytes += pair->key_len + 1;
+        usage->value_bytes += pair->value_len + 1;
     }
 }
 
+void pht_delete_shell(PHT* pht) {
+    if (!pht) {
+        return;
+    }
+    free(pht->entries);
+    free(pht->slots);
+    free(pht->tags);
+    free(pht);
+}
+
 void pht_delete(PHT* pht) {
     if (!pht) {
         return; // Nothing to delete
     }
-    // Free all entries
-    for (int i = 0; i < pht->size; i++) {
-        if (pht->entries[i]) {
-            pair_free(pht->entries[i]);
+    // Hand a pending background rebuild back to the worker
+    if (pht->job) {
+        rebuild_worker_release(pht->ctx->worker, pht->job);
+    }
+    // Free all entries, unless they live in an arena that is freed in bulk
+    if (!pht_arena(pht)) {
+        for (int i = 0; i < pht->size; i++) {
+            if (pht->entries[i]) {
+                pair_free(pht->entries[i]);
+            }
         }
     }
     free(pht->entries); // Free the entries array
+    free(pht->slots);   // Free the FKS slot array (NULL for CMPH)
+    free(pht->tags);    // Free the fingerprints
     if (pht->mph) {
         cmph_destroy(pht->mph); // Free the MPH
     }
@@ -289,19 +1542,25 @@ void pht_delete(PHT* pht) {
 }
 
 PHT* pht_create_from_array(PHT* source, int new_capacity) {
-    if (!source || new_capacity < source->size) {
+    if (!source || new_capacity < source->size - source->tombstones) {
         return NULL; // Invalid parameters
     }
-    // Create a new PHT with the specified capacity
-    PHT* new_pht = pht_create(new_capacity);
+    // Create a new PHT with the specified capacity and the same backend
+    PHT* new_pht = pht_create_with_backend(new_capacity, source->backend);
     if (!new_pht) {
         return NULL; // Memory allocation failed for new PHT
     }
+    new_pht->ctx = source->ctx;
+    new_pht->bucket = source->bucket;
     // Copy (duplicate) entries from the source PHT to the new PHT
     for (int i = 0; i < source->size; i++) {
         pair_t* entry = source->entries[i];
+        if (!entry) {
+            continue; // Tombstone
+        }
         // Duplicate the pair (create a new pair with the same key and value)
-        pair_t* new_entry = pair_create(entry->key, entry->value);
+        pair_t* new_entry = pair_create_n(pht_arena(new_pht), entry->key, entry->key_len,
+                                          entry->value, entry->value_len, entry->hash);
         if (!new_entry) {
             pht_delete(new_pht);  // Memory allocation failed for new entry
             return NULL;
@@ -1,23 +1,288 @@
 #ifndef PHT_H
 #define PHT_H
 
+#include <stdint.h>
 #include "cmph.h"
 #include "pair.h"
+#include "hash.h"
+#include "rebuild_worker.h"
+#include "epoch.h"
+#include "trace.h"
 
-/** Structure for the small perfect hash table (bucket) that uses CMPH.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Second-level hashing scheme used by a PHT bucket.
+ *
+ * PHT_BACKEND_CMPH builds a minimal perfect hash with CMPH over the bucket's
+ * keys, with the algorithm chosen by the context's pht_mph_policy_t. New keys
+ * are staged in an unsorted delta area that lookups scan next to the
+ * MPH-indexed entries; the MPH is only rebuilt once the delta area grows past
+ * a threshold.
+ *
+ * PHT_BACKEND_FKS uses a native FKS-style second level: a seeded universal
+ * hash into a slot array of quadratic size. The seed only changes when an
+ * insert collides, so inserts are amortized O(1) and lookups are worst-case O(1)
+ * without calling into CMPH.
+ */
+typedef enum {
+    PHT_BACKEND_CMPH,
+    PHT_BACKEND_FKS
+} pht_backend_t;
+
+/** Operations of a minimal perfect hash algorithm for PHT_BACKEND_CMPH buckets.
+ *
+ * Every algorithm produces a cmph_t, so lookups, snapshots and table files
+ * work the same whichever algorithm built a bucket's MPH.
+ *
+ * \param name Short name of the algorithm.
+ * \param build Builds an MPH over n keys in CMPH byte-vector format (a
+ *              cmph_uint32 length followed by the key bytes); returns NULL
+ *              if construction failed. Must be safe to call from the
+ *              background rebuild worker.
+ */
+typedef struct PHTMphOps {
+    const char* name;
+    cmph_t* (*build)(cmph_uint8** keys, int n);
+} pht_mph_ops_t;
+
+extern const pht_mph_ops_t pht_mph_chd;   // CHD: compact, fast to evaluate (the default)
+extern const pht_mph_ops_t pht_mph_bdz;   // BDZ: 3-hypergraph, fast to build
+extern const pht_mph_ops_t pht_mph_bmz;   // BMZ: 2-graph, fast to evaluate, larger
+extern const pht_mph_ops_t pht_mph_chm;   // CHM: 2-graph, order preserving, largest
+
+#define PHT_MPH_POLICY_TIERS 4   // Size tiers of a pht_mph_policy_t before the last one
+#define PHT_SEED_MAX_KEYS 8      // Default largest bucket indexed by a seed search
+#define PHT_SEED_LIMIT 10        // Largest bucket a seed search may be asked to index
+#define PHT_FKS_MAX_CAPACITY 4096 // Largest FKS bucket (its slot array is quadratic)
+
+/** One size tier of a pht_mph_policy_t.
+ *
+ * \param max_keys Largest bucket (in keys) that uses this tier.
+ * \param ops The algorithm of the tier.
+ */
+typedef struct PHTMphTier {
+    int max_keys;
+    const pht_mph_ops_t* ops;
+} pht_mph_tier_t;
+
+/** Chooses the MPH algorithm of a bucket from the number of keys it indexes.
+ *
+ * Buckets of up to seed_max_keys keys do not use CMPH at all: a brute-force
+ * search finds a seed under which a fixed hash of the stored key hashes maps
+ * the keys to distinct slots, and the seed kept in the PHT is the whole
+ * index. A larger bucket of n keys uses the first tier with n <= max_keys,
+ * or the large algorithm if no tier matches. If the chosen algorithm fails
+ * to build, the bucket falls back to CHD.
+ *
+ * A seed search over n keys takes about n^n / n! tries: about 400 at 8 keys,
+ * 2,800 at 10, but already 885,000 at 16. seed_max_keys is therefore capped
+ * at PHT_SEED_LIMIT, past which CMPH builds faster.
+ *
+ * \param seed_max_keys Largest bucket indexed by a seed search
+ *                      (PHT_SEED_MAX_KEYS by default, at most PHT_SEED_LIMIT;
+ *                      0 disables seed searches).
+ * \param count Number of tiers in use, in ascending order of max_keys.
+ * \param tiers The tiers.
+ * \param large Algorithm of the buckets larger than every tier.
+ */
+typedef struct PHTMphPolicy {
+    int seed_max_keys;
+    int count;
+    pht_mph_tier_t tiers[PHT_MPH_POLICY_TIERS];
+    const pht_mph_ops_t* large;
+} pht_mph_policy_t;
+
+/** Event counters of a DPHT, one stripe of PHT_COUNTER_STRIPES.
+ *
+ * Counting is compiled in only when the library is built with DPHT_STATS;
+ * otherwise PHT_COUNT() expands to nothing and no counter array exists.
+ * Every thread adds to its own stripe with relaxed atomics, so threads do
+ * not share counter cache lines; dpht_get_stats() sums the stripes.
+ *
+ * \param rebuilds Second-level index builds of every kind.
+ * \param cmph_builds CMPH MPH builds, inline or on the background worker.
+ * \param seed_builds Seed-search MPH builds of small buckets.
+ * \param fks_builds FKS slot array re-seeds.
+ * \param rebuild_failures Builds that failed (the bucket kept its old index).
+ * \param rebuild_ns Total time spent building, in nanoseconds.
+ * \param rebuild_max_ns Longest single build, in nanoseconds.
+ * \param compactions Buckets compacted to drop their tombstones.
+ * \param splits Bucket splits of the linear-hashing directory.
+ * \param merges Bucket merges of the directory shrinking back.
+ * \param probes Keys looked up in a bucket by any operation.
+ * \param hits Searches that found their key.
+ * \param misses Searches that did not.
+ */
+typedef struct PHTCounters {
+    uint64_t rebuilds;
+    uint64_t cmph_builds;
+    uint64_t seed_builds;
+    uint64_t fks_builds;
+    uint64_t rebuild_failures;
+    uint64_t rebuild_ns;
+    uint64_t rebuild_max_ns;
+    uint64_t compactions;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t misses;
+} __attribute__((aligned(64))) pht_counters_t;
+
+#define PHT_COUNTER_STRIPES 16   // Counter stripes of a DPHT built with DPHT_STATS
+
+/** Returns the calling thread's stripe of a counter array.
+ *
+ * Threads are assigned stripes round robin on first use.
+ *
+ * \param counters Array of PHT_COUNTER_STRIPES stripes.
+ * \returns The stripe the calling thread adds to.
+ */
+pht_counters_t* pht_counters_local(pht_counters_t* counters);
+
+/** Adds to one event counter of a context's counter array, if it has one. */
+#ifdef DPHT_STATS
+#define PHT_COUNT(counters, field, amount)                                              \
+    do {                                                                                \
+        if (counters) {                                                                 \
+            __atomic_fetch_add(&pht_counters_local(counters)->field, (uint64_t)(amount), \
+                               __ATOMIC_RELAXED);                                       \
+        }                                                                               \
+    } while (0)
+#else
+#define PHT_COUNT(counters, field, amount) ((void)sizeof(amount))
+#endif
+
+/** Running totals of the time spent building bucket indexes.
+ *
+ * Every build of a bucket whose context has one adds to it, from whichever
+ * thread ran the build; the DPHT's load controller reads and resets it.
+ *
+ * \param ns Time spent building, in nanoseconds.
+ * \param keys Keys indexed by those builds.
+ */
+typedef struct PHTBuildCost {
+    uint64_t ns;
+    uint64_t keys;
+} pht_build_cost_t;
+
+/** Settings and services shared by all buckets of a DPHT.
  *
- * \param mph Pointer to the minimal perfect hash function object generated by CMPH.
+ * A PHT without a context (ctx == NULL) uses the defaults: a delta threshold
+ * of PHT_DELTA_THRESHOLD, a tombstone threshold of PHT_TOMBSTONE_PERCENT and
+ * synchronous rebuilds.
+ *
+ * \param delta_threshold Number of staged keys that triggers an MPH rebuild.
+ * \param tombstone_percent Share of MPH-indexed slots, in percent, that may
+ *                          hold tombstones before the bucket is compacted and
+ *                          its MPH rebuilt.
+ * \param worker Background worker that builds MPHs, or NULL to rebuild inline.
+ * \param arena Arena the pairs are allocated from, or NULL for malloc. Pairs
+ *              in an arena are not freed individually by pht_delete().
+ * \param epoch Reclamation domain of concurrent readers, or NULL. When set,
+ *              pairs and MPHs that readers may still be using are retired
+ *              to the domain instead of being freed, and updates replace a
+ *              pair instead of changing its value in place.
+ * \param mph_policy Algorithm choice of MPH rebuilds, or NULL for CHD everywhere.
+ * \param counters PHT_COUNTER_STRIPES event counter stripes, or NULL if the
+ *                 library is built without DPHT_STATS.
+ * \param trace Ring recording index builds, splits, merges and build failures,
+ *              or NULL.
+ * \param build_cost Build time totals of the load controller, or NULL.
+ */
+typedef struct PHTContext {
+    int delta_threshold;
+    int tombstone_percent;
+    rebuild_worker_t* worker;
+    arena_t* arena;
+    epoch_t* epoch;
+    const pht_mph_policy_t* mph_policy;
+    pht_counters_t* counters;
+    trace_ring_t* trace;
+    pht_build_cost_t* build_cost;
+} pht_context_t;
+
+#define PHT_DELTA_THRESHOLD 4     // Default number of staged keys before a rebuild
+#define PHT_TOMBSTONE_PERCENT 25  // Default share of tombstones before a rebuild
+
+/** Computes the 8-bit fingerprint of a key from its full hash.
+ *
+ * The hash is mixed with a multiplicative constant so that the fingerprint
+ * depends on all of its bits, not just the bits that select the bucket.
+ * Fingerprints are never 0, which marks an empty FKS slot.
+ *
+ * \param hash Full hash of the key.
+ * \returns The fingerprint, in [1, 255].
+ */
+static inline uint8_t pht_tag(uint64_t hash) {
+    uint8_t tag = (uint8_t)((hash * 0x9e3779b97f4a7c15ULL) >> 56);
+    return tag ? tag : 1;
+}
+
+/** Maps a key hash to its slot under a seed-search MPH.
+ *
+ * \param hash Full hash of the key.
+ * \param seed The seed of the MPH.
+ * \param n Number of indexed entries.
+ * \returns The slot, in [0, n).
+ */
+static inline int pht_seed_slot(uint64_t hash, uint32_t seed, int n) {
+    uint64_t mixed = hash_mix(hash ^ HASH_SECRET0, (seed * 0x9e3779b97f4a7c15ULL) ^ HASH_SECRET1);
+    return (int)(((mixed & 0xffffffffULL) * (uint64_t)n) >> 32);
+}
+
+/** Structure for the small perfect hash table (bucket).
+ *
+ * \param mph Pointer to the minimal perfect hash function object generated by
+ *            CMPH, or NULL if the bucket is indexed by a seed search.
+ *            Only used by the CMPH backend.
  * \param entries Array of pointers to key-value pairs.
- *                This array is ordered so that for each key, cmph_search()
- *                returns its unique index.
- * \param size Current number of key-value pairs stored in this bucket.
+ *                With the CMPH backend the first mph_size entries are ordered so
+ *                that for each of their keys cmph_search() returns its unique index,
+ *                and the remaining entries form the unsorted delta area. A removed
+ *                MPH-indexed entry leaves a tombstone: a NULL entry with tag 0,
+ *                so that the MPH stays valid. With the FKS backend it is an
+ *                unordered list of the stored pairs.
+ * \param size Number of used entries, tombstones included; the bucket holds
+ *             size - tombstones key-value pairs.
  * \param capacity Allocated capacity of the entries array.
+ * \param backend The second-level hashing scheme used by this bucket.
+ * \param slots FKS slot array of slot_count entries (NULL for CMPH). Each key
+ *              occupies the slot selected by its seeded hash.
+ * \param slot_count Number of FKS slots, always capacity * capacity.
+ * \param tags 8-bit key fingerprints (see pht_tag()), parallel to entries for
+ *             CMPH and to slots for FKS. A lookup compares the fingerprint
+ *             before following any pair pointer; empty FKS slots have tag 0.
+ * \param seed Seed of the FKS hash function currently in use, or of the
+ *             seed-search MPH of a CMPH bucket whose mph is NULL.
+ * \param mph_size Number of leading entries indexed by the MPH (CMPH only);
+ *                 0 if no entry is indexed.
+ * \param tombstones Number of tombstones among the MPH-indexed entries.
+ * \param generation Incremented whenever entries indexed by a pending rebuild
+ *                   are moved, so that stale rebuild results are discarded.
+ * \param job Pending background rebuild, or NULL.
+ * \param ctx Shared settings of the owning DPHT, or NULL.
+ * \param bucket Index of the bucket in the owning DPHT's directory, or -1.
+ *               Only used to label traced events.
  */
 typedef struct PerfectHashTable {
     cmph_t* mph;
     pair_t** entries;
     int size;
     int capacity;
+    pht_backend_t backend;
+    pair_t** slots;
+    int slot_count;
+    uint8_t* tags;
+    uint64_t seed;
+    int mph_size;
+    int tombstones;
+    unsigned int generation;
+    rebuild_job_t* job;
+    pht_context_t* ctx;
+    int bucket;
 } PHT;
 
 /** Creates a new perfect hash table (PHT) with the given initial capacity.
@@ -30,11 +295,28 @@ typedef struct PerfectHashTable {
  */
 PHT* pht_create(int initial_capacity);
 
+/** Creates a new perfect hash table (PHT) that uses the given backend.
+ *
+ * pht_create() is equivalent to calling this function with PHT_BACKEND_CMPH.
+ * For PHT_BACKEND_FKS the slot array is allocated up front with
+ * initial_capacity * initial_capacity slots, so an FKS PHT cannot be created
+ * (or grown) past PHT_FKS_MAX_CAPACITY entries.
+ *
+ * \param initial_capacity The initial capacity of the PHT.
+ * \param backend The second-level hashing scheme to use.
+ * \returns A pointer to the newly created PHT, or NULL on failure.
+ */
+PHT* pht_create_with_backend(int initial_capacity, pht_backend_t backend);
+
 /** Inserts a new key-value pair into the perfect hash table.
  *
  * This function appends a new key-value pair to the internal array.
- * If the capacity is exceeded, the array is resized. The MPH is invalidated
- * and will be rebuilt lazily on the next search or update operation.
+ * If the capacity is exceeded, the array is resized. With the CMPH backend the
+ * pair goes to the delta area; once the delta area exceeds the context's
+ * threshold the MPH is rebuilt, either inline or on the context's background
+ * worker. With the FKS backend the pair is placed in its slot directly; the
+ * slot array is only re-seeded on a collision or regrown when the entries
+ * array grows, which it cannot do past PHT_FKS_MAX_CAPACITY entries.
  *
  * \param pht Pointer to the PHT where the key-value pair will be inserted.
  * \param new_pair Pointer to the key-value pair to be inserted.
@@ -42,6 +324,20 @@ PHT* pht_create(int initial_capacity);
  */
 int pht_insert(PHT* pht, pair_t* new_pair);
 
+/** Inserts a batch of new key-value pairs into the PHT.
+ *
+ * The entries array grows once for the whole batch, and the bucket is then
+ * indexed by a single MPH build (or a single FKS seed search) instead of one
+ * rebuild per delta threshold. The keys must not already be in the PHT nor
+ * appear twice in the batch.
+ *
+ * \param pht Pointer to the PHT where the pairs will be inserted.
+ * \param pairs Array of n pairs; the PHT takes ownership of them on success.
+ * \param n Number of pairs in the batch.
+ * \returns 1 on success, 0 on failure (nothing is inserted).
+ */
+int pht_insert_batch(PHT* pht, pair_t** pairs, int n);
+
 /** Updates the value of an existing key in the PHT.
  *
  * \param pht Pointer to the PHT where the key-value pair will be updated.
@@ -51,10 +347,27 @@ int pht_insert(PHT* pht, pair_t* new_pair);
  */
 int pht_update(PHT* pht, const char* key, const char* new_value);
 
+/** Updates the value of an existing binary key in the PHT.
+ *
+ * \param pht Pointer to the PHT where the key-value pair will be updated.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \param new_value Pointer to the new value bytes.
+ * \param value_len Number of bytes in the new value.
+ * \returns 1 on success, 0 on failure (e.g., key not found).
+ */
+int pht_update_n(PHT* pht, const void* key, size_t key_len, uint64_t hash,
+                 const void* new_value, size_t value_len);
+
 /** Searches for a given key in the PHT.
  *
- * This function locates the value associated with a given key using the MPH.
- * If the MPH has not yet been built or is outdated, it will be rebuilt automatically.
+ * This function locates the value associated with a given key using the MPH,
+ * then scans the delta area if the MPH-indexed entries do not contain the key.
+ * Searching never builds an MPH; it only installs a finished background rebuild.
+ *
+ * Like the other string functions of the PHT, it hashes the key with
+ * hash_bytes() (seed 0), the hash that pair_create() stores in new pairs.
  *
  * \param pht Pointer to the PHT where the key will be searched.
  * \param key The key string to search for.
@@ -62,6 +375,82 @@ int pht_update(PHT* pht, const char* key, const char* new_value);
  */
 char* pht_search(PHT* pht, const char* key);
 
+/** Searches for a binary key in the PHT.
+ *
+ * Candidate pairs are rejected on their stored hash and length before any
+ * key bytes are compared, so keys may contain zero bytes.
+ *
+ * \param pht Pointer to the PHT where the key will be searched.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key (the one stored in its pair).
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes if found, NULL otherwise.
+ */
+void* pht_search_n(PHT* pht, const void* key, size_t key_len, uint64_t hash, size_t* value_len);
+
+/** Finds the pair holding a binary key in the PHT.
+ *
+ * Like pht_search_n(), but returns the pair itself, so that a caller can
+ * update the value or decide to insert without probing the bucket again.
+ *
+ * \param pht Pointer to the PHT where the key will be searched.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key (the one stored in its pair).
+ * \returns Pointer to the pair if found, NULL otherwise.
+ */
+pair_t* pht_find_n(PHT* pht, const void* key, size_t key_len, uint64_t hash);
+
+/** Installs a finished background rebuild of the PHT, if any.
+ *
+ * Batched lookups call this once per bucket before probing, so that the slots
+ * returned by pht_probe() stay valid until pht_search_candidate() runs.
+ *
+ * \param pht Pointer to the PHT.
+ */
+void pht_sync(PHT* pht);
+
+/** First stage of a batched lookup: computes the candidate slot of a key.
+ *
+ * Evaluates the MPH (or the FKS hash) and prefetches the fingerprint and the
+ * pair pointer of the candidate slot, without touching any pair. The PHT must
+ * not be modified or synced until the matching pht_search_candidate() call.
+ *
+ * \param pht Pointer to the PHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns The candidate slot, or -1 if the key can only be in the delta area.
+ */
+int pht_probe(const PHT* pht, const void* key, size_t key_len, uint64_t hash);
+
+/** Second stage of a batched lookup: prefetches the candidate pair.
+ *
+ * The pair is only loaded if the fingerprint of the slot matches the key.
+ *
+ * \param pht Pointer to the PHT.
+ * \param slot Slot returned by pht_probe().
+ * \param hash Full hash of the key.
+ */
+void pht_prefetch_candidate(const PHT* pht, int slot, uint64_t hash);
+
+/** Last stage of a batched lookup: resolves a key from its candidate slot.
+ *
+ * Compares the candidate pair, then scans the delta area of a CMPH PHT.
+ * The result is the same as pht_search_n() for the same key.
+ *
+ * \param pht Pointer to the PHT.
+ * \param slot Slot returned by pht_probe().
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes if found, NULL otherwise.
+ */
+void* pht_search_candidate(const PHT* pht, int slot, const void* key, size_t key_len,
+                           uint64_t hash, size_t* value_len);
+
 /** Checks if a key exists in the PHT.
  *
  * \param pht Pointer to the PHT where the key will be checked.
@@ -72,31 +461,182 @@ int pht_lookup(PHT* pht, const char* key);
 
 /** Deletes a key-value pair from the PHT based on its key.
  *
- * This function frees the memory of the deleted pair, updates the internal array,
- * and invalidates the MPH so it is rebuilt on the next access.
+ * This function frees the memory of the deleted pair and updates the internal array.
+ * Removing a staged pair keeps the MPH. Removing an MPH-indexed pair leaves a
+ * tombstone in its slot, which also keeps the MPH; once tombstones fill more
+ * than the tombstone threshold of the slots, the bucket is compacted and its
+ * MPH rebuilt.
  *
  * \param pht Pointer to the PHT where the key-value pair will be deleted.
  * \param key The key string of the pair to be deleted.
  */
 void pht_remove_entry(PHT* pht, const char* key);
 
+/** Deletes the pair holding a binary key from the PHT.
+ *
+ * \param pht Pointer to the PHT where the key-value pair will be deleted.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns 1 if a pair was deleted, 0 if the key was not found.
+ */
+int pht_remove_n(PHT* pht, const void* key, size_t key_len, uint64_t hash);
+
+/** Moves the pairs selected by a predicate from one PHT to another.
+ *
+ * Pairs are moved by pointer; nothing is copied or freed. Pairs that cannot be
+ * inserted into the target (memory allocation failure) stay in the source.
+ * If anything moved, a CMPH source has its MPH invalidated and its remaining
+ * entries staged in the delta area.
+ *
+ * \param source Pointer to the PHT to take pairs from.
+ * \param target Pointer to the PHT to move pairs into.
+ * \param moves Predicate returning nonzero for pairs that must move.
+ * \param arg Opaque argument passed to the predicate.
+ * \returns The number of pairs moved.
+ */
+int pht_move_entries(PHT* source, PHT* target, int (*moves)(const pair_t* pair, void* arg), void* arg);
+
+/** Repacks a PHT into the least memory that indexes all of its pairs.
+ *
+ * Tombstones are squeezed out, every staged pair is indexed by a new MPH
+ * built inline (a pending background rebuild is dropped), and the entries,
+ * fingerprint and FKS slot arrays are trimmed to exactly the pairs held.
+ * Buckets otherwise trim their arrays only when a rebuild finds them at most
+ * a quarter full.
+ *
+ * \param pht Pointer to the PHT.
+ * \returns 1 if every pair is indexed afterwards, 0 if the PHT is NULL or its
+ *          MPH could not be built (its pairs stay in the delta area).
+ */
+int pht_repack(PHT* pht);
+
+/** Shape and memory of one bucket, as added up by pht_add_usage().
+ *
+ * \param keys Live key-value pairs.
+ * \param tombstones Tombstones left by MPH-indexed removals.
+ * \param staged Entries in the delta area, not yet indexed by an MPH.
+ * \param pending Background rebuilds submitted and not yet installed.
+ * \param table_bytes PHT structures.
+ * \param entries_bytes Entries and fingerprint arrays, FKS slot arrays included.
+ * \param pair_bytes pair_t structures.
+ * \param key_bytes Key bytes and their NUL terminators.
+ * \param value_bytes Value bytes and their NUL terminators.
+ * \param mph_bytes CMPH functions, as reported by cmph_packed_size().
+ */
+typedef struct PHTUsage {
+    size_t keys;
+    size_t tombstones;
+    size_t staged;
+    size_t pending;
+    size_t table_bytes;
+    size_t entries_bytes;
+    size_t pair_bytes;
+    size_t key_bytes;
+    size_t value_bytes;
+    size_t mph_bytes;
+} pht_usage_t;
+
+/** Adds the shape and memory of a PHT to running totals.
+ *
+ * Walks every entry of the PHT, so it costs as much as a scan. The caller
+ * must keep writers out of the PHT meanwhile.
+ *
+ * \param pht Pointer to the PHT (NULL is ignored).
+ * \param usage Totals to add to.
+ */
+void pht_add_usage(const PHT* pht, pht_usage_t* usage);
+
 /** Frees all memory associated with a perfect hash table.
  *
  * This function deletes all key-value pairs, destroys the MPH (if present),
- * and frees the table structure itself.
+ * and frees the table structure itself. Pairs allocated from the context's
+ * arena are left for the arena to release in bulk.
  *
  * \param pht Pointer to the PHT to be destroyed.
  */
 void pht_delete(PHT* pht);
 
+/** Creates a private copy of a PHT for copy-on-write updates.
+ *
+ * The copy has its own entries, fingerprint and slot arrays but shares the
+ * pairs and the MPH with the original. Changes to the copy never touch what
+ * the original references: pairs and MPHs that the copy drops are released
+ * through the context's epoch domain. No background rebuild is carried over.
+ *
+ * \param pht Pointer to the PHT to copy.
+ * \returns A pointer to the copy, or NULL on failure.
+ */
+PHT* pht_clone(const PHT* pht);
+
+/** Frees a PHT version that has been replaced by a copy.
+ *
+ * Only the PHT structure and its arrays are freed; the pairs and the MPH may
+ * still be referenced by the copy that replaced it.
+ *
+ * \param pht Pointer to the PHT version to free (NULL is ignored).
+ */
+void pht_delete_shell(PHT* pht);
+
+/** Initializes the default policy: seed searches for buckets of up to
+ * PHT_SEED_MAX_KEYS keys, CHD for every larger bucket.
+ *
+ * \param policy Pointer to the policy to initialize.
+ */
+void pht_mph_policy_init(pht_mph_policy_t* policy);
+
+/** Adds a size tier to a policy.
+ *
+ * \param policy Pointer to the policy.
+ * \param max_keys Largest bucket that uses the tier; must exceed the
+ *                 max_keys of the tiers added before.
+ * \param ops The algorithm of the tier.
+ * \returns 1 on success, 0 if the policy is full or the tier is out of order.
+ */
+int pht_mph_policy_add_tier(pht_mph_policy_t* policy, int max_keys, const pht_mph_ops_t* ops);
+
+/** Returns the algorithm a policy uses for a bucket of n keys.
+ *
+ * \param policy Pointer to the policy, or NULL for CHD everywhere.
+ * \param n Number of keys the MPH indexes.
+ * \returns The algorithm.
+ */
+const pht_mph_ops_t* pht_mph_policy_select(const pht_mph_policy_t* policy, int n);
+
+/** Builds a CMPH minimal perfect hash function over a set of keys.
+ *
+ * \param keys Array of keys in CMPH byte-vector format (a cmph_uint32 length
+ *             followed by the key bytes).
+ * \param n Number of keys.
+ * \returns The new MPH, or NULL if construction failed.
+ */
+cmph_t* pht_build_mph(cmph_uint8** keys, int n);
+
+/** Builds a minimal perfect hash function with a given algorithm.
+ *
+ * Falls back to CHD if the algorithm fails on these keys.
+ *
+ * \param ops The algorithm to use (NULL selects CHD).
+ * \param keys Array of keys in CMPH byte-vector format.
+ * \param n Number of keys.
+ * \returns The new MPH, or NULL if construction failed.
+ */
+cmph_t* pht_build_mph_with(const pht_mph_ops_t* ops, cmph_uint8** keys, int n);
+
 /** Creates a new PHT by copying the contents of an existing PHT.
 *
 * This is useful when resizing the PHT to a larger capacity.
+* The copy uses the same backend as the source and leaves out tombstones.
 *
 * \param source        Pointer to the source PHT to be copied.
-* \param new_capacity  The new capacity for the copied PHT.
+* \param new_capacity  The new capacity for the copied PHT (at least the
+*                      number of pairs, size - tombstones).
 * \returns A pointer to the newly created PHT, or NULL on failure.
 */
 PHT* pht_create_from_array(PHT* source, int new_capacity);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // PHT_H
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_SLAB_SIZE (64 * 1024)             // Slab size with regular pages
+#define ARENA_HUGE_SLAB_SIZE (2 * 1024 * 1024)  // Slab size with huge pages
+#define ARENA_ROUND_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Block sizes served from slabs, spaced so that at most a third is wasted
+static const size_t arena_class_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, ARENA_MAX_SMALL
+};
+#define ARENA_CLASS_COUNT ((int)(sizeof(arena_class_sizes) / sizeof(arena_class_sizes[0])))
+
+/** Header at the start of every slab.
+ *
+ * \param next Next slab owned by the arena.
+ * \param size Size of the slab in bytes, header included.
+ * \param mapped 1 if the slab was obtained with mmap, 0 if with malloc.
+ */
+typedef struct ArenaSlab {
+    struct ArenaSlab* next;
+    size_t size;
+    int mapped;
+} arena_slab_t;
+
+/** Header in front of every large (malloc'ed) block.
+ *
+ * \param prev Previous large block of the arena.
+ * \param next Next large block of the arena.
+ * \param size Size of the block in bytes, header included.
+ */
+typedef struct ArenaLarge {
+    struct ArenaLarge* prev;
+    struct ArenaLarge* next;
+    size_t size;
+} arena_large_t;
+
+#define ARENA_SLAB_HEADER ARENA_ROUND_UP(sizeof(arena_slab_t))
+#define ARENA_LARGE_HEADER ARENA_ROUND_UP(sizeof(arena_large_t))
+
+/** Structure for the arena.
+ *
+ * \param free_lists Per-class singly linked lists of freed blocks; the link
+ *                   is stored in the first word of each block.
+ * \param slabs List of slabs owned by the arena.
+ * \param cursor Next free byte in the current slab.
+ * \param limit End of the current slab.
+ * \param large List of large blocks owned by the arena.
+ * \param huge_pages 1 if slabs should be backed by huge pages.
+ * \param reserved Bytes obtained from the system (slabs and large blocks).
+ */
+struct Arena {
+    void* free_lists[ARENA_CLASS_COUNT];
+    arena_slab_t* slabs;
+    char* cursor;
+    char* limit;
+    arena_large_t* large;
+    int huge_pages;
+    size_t reserved;
+};
+
+/** Finds the size class serving a block size.
+ *
+ * \param size The requested block size.
+ * \returns The class index, or -1 if the block is too large for slabs.
+ */
+static int arena_class(size_t size) {
+    for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+        if (size <= arena_class_sizes[c]) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/** Obtains a new slab from the system and makes it the current one.
+ *
+ * \param arena Pointer to the arena.
+ * \returns 1 on success, 0 on failure (out of memory).
+ */
+static int arena_add_slab(arena_t* arena) {
+    size_t size = arena->huge_pages ? ARENA_HUGE_SLAB_SIZE : ARENA_SLAB_SIZE;
+    arena_slab_t* slab = NULL;
+    int mapped = 0;
+
+    if (arena->huge_pages) {
+        void* mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // Explicit huge pages first; this fails unless hugetlbfs pages are reserved
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (mem == MAP_FAILED) {
+            mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (mem != MAP_FAILED) {
+                madvise(mem, size, MADV_HUGEPAGE); // Transparent huge pages, best effort
+            }
+#endif
+        }
+        if (mem != MAP_FAILED) {
+            slab = (arena_slab_t*)mem;
+            mapped = 1;
+        }
+    }
+    if (!slab) {
+        slab = (arena_slab_t*)malloc(size);
+        if (!slab) {
+            return 0; // Memory allocation failed
+        }
+    }
+
+    slab->next = arena->slabs;
+    slab->size = size;
+    slab->mapped = mapped;
+    arena->slabs = slab;
+    arena->cursor = (char*)slab + ARENA_SLAB_HEADER;
+    arena->limit = (char*)slab + size;
+    arena->reserved += size;
+    return 1;
+}
+
+arena_t* arena_create(int huge_pages) {
+    arena_t* arena = (arena_t*)calloc(1, sizeof(arena_t));
+    if (!arena) {
+        return NULL; // Memory allocation failed
+    }
+    arena->huge_pages = huge_pages ? 1 : 0;
+    return arena;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    if (!arena || size == 0) {
+        return NULL; // Invalid parameters
+    }
+
+    int c = arena_class(size);
+    if (c < 0) {
+        // Large block: malloc with a header linking it into the arena
+        arena_large_t* block = (arena_large_t*)malloc(ARENA_LARGE_HEADER + size);
+        if (!block) {
+            return NULL; // Memory allocation failed
+        }
+        block->prev = NULL;
+        block->next = arena->large;
+        block->size = ARENA_LARGE_HEADER + size;
+        if (arena->large) {
+            arena->large->prev = block;
+        }
+        arena->large = block;
+        arena->reserved += block->size;
+        return (char*)block + ARENA_LARGE_HEADER;
+    }
+
+    // Reuse a freed block of the same class if there is one
+    void* block = arena->free_lists[c];
+    if (block) {
+        arena->free_lists[c] = *(void**)block;
+        return block;
+    }
+
+    // Otherwise carve a new block out of the current slab
+    size_t rounded = arena_class_sizes[c];
+    if (!arena->cursor || (size_t)(arena->limit - arena->cursor) < rounded) {
+        if (!arena_add_slab(arena)) {
+            return NULL;
+        }
+    }
+    block = arena->cursor;
+    arena->cursor += rounded;
+    return block;
+}
+
+void arena_free(arena_t* arena, void* ptr, size_t size) {
+    if (!arena || !ptr) {
+        return;
+    }
+
+    int c = arena_class(size);
+    if (c < 0) {
+        // Unlink and release a large block
+        arena_large_t* block = (arena_large_t*)((char*)ptr - ARENA_LARGE_HEADER);
+        if (block->prev) {
+            block->prev->next = block->next;
+        }
+        else {
+            arena->large = block->next;
+        }
+        if (block->next) {
+            block->next->prev = block->prev;
+        }
+        arena->reserved -= block->size;
+        free(block);
+        return;
+    }
+
+    // Push the block onto its class free list
+    *(void**)ptr = arena->free_lists[c];
+    arena->free_lists[c] = ptr;
+}
+
+int arena_same_class(size_t a, size_t b) {
+    int c = arena_class(a);
+    return c >= 0 && c == arena_class(b);
+}
+
+size_t arena_reserved_bytes(const arena_t* arena) {
+    return arena ? arena->reserved : 0;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+
+    // Release every slab
+    arena_slab_t* slab = arena->slabs;
+    while (slab) {
+        arena_slab_t* next = slab->next;
+        if (slab->mapped) {
+            munmap(slab, slab->size);
+        }
+        else {
+            free(slab);
+        }
+        slab = next;
+    }
+
+    // Release every large block
+    arena_large_t* block = arena->large;
+    while (block) {
+        arena_large_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
@@ -0,0 +1,78 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure for a size-classed slab allocator.
+ *
+ * Small blocks (up to ARENA_MAX_SMALL bytes) are rounded up to a size class
+ * and carved out of large slabs owned by the arena. Freed blocks go to a
+ * per-class free list and are reused by later allocations of the same class.
+ * Larger blocks fall back to malloc but are still tracked by the arena.
+ * Everything is released at once by arena_destroy().
+ *
+ * An arena is not thread-safe; it is meant to be owned by a single table.
+ */
+typedef struct Arena arena_t;
+
+#define ARENA_MAX_SMALL 2048    // Largest block served from slabs
+
+/** Creates a new, empty arena.
+ *
+ * \param huge_pages If nonzero, slabs are 2 MiB and backed by huge pages when
+ *                   the system allows it (falling back to transparent huge
+ *                   pages, then to regular pages).
+ * \returns A pointer to the new arena, or NULL on failure.
+ */
+arena_t* arena_create(int huge_pages);
+
+/** Allocates a block from the arena.
+ *
+ * \param arena Pointer to the arena.
+ * \param size Number of bytes requested (must be at least 1).
+ * \returns A 16-byte aligned block, or NULL on failure.
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/** Returns a block to the arena for reuse.
+ *
+ * \param arena Pointer to the arena the block was allocated from.
+ * \param ptr Pointer to the block (NULL is ignored).
+ * \param size The size that was passed to arena_alloc() for this block.
+ */
+void arena_free(arena_t* arena, void* ptr, size_t size);
+
+/** Checks whether two block sizes share the same size class.
+ *
+ * A block can be reused in place for any size of the same class.
+ *
+ * \param a First size in bytes.
+ * \param b Second size in bytes.
+ * \returns 1 if both sizes are served by the same slab class, 0 otherwise.
+ */
+int arena_same_class(size_t a, size_t b);
+
+/** Returns the number of bytes the arena has obtained from the system.
+ *
+ * \param arena Pointer to the arena.
+ * \returns Total bytes of slabs and large blocks currently held.
+ */
+size_t arena_reserved_bytes(const arena_t* arena);
+
+/** Frees every slab and large block of the arena, then the arena itself.
+ *
+ * All blocks allocated from the arena become invalid.
+ *
+ * \param arena Pointer to the arena to destroy.
+ */
+void arena_destroy(arena_t* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENA_H
@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "DPHT.h"
+
+/**
+ * Workload benchmark of the DPHT: fixed, seeded scenarios for comparing
+ * configurations and catching regressions.
+ *
+ * Every scenario loads keys, then runs its operation mix on each thread and
+ * times it in batches with the cycle counter, so that the clock costs a few
+ * cycles per batch instead of a system call per operation. Each batch yields
+ * one sample of the average latency of its operations; the samples of all
+ * threads give the percentiles. The scenarios are:
+ *   uniform     Lookups of loaded keys, uniformly at random.
+ *   zipf        Lookups of loaded keys, Zipfian (theta 0.99) over scrambled ranks.
+ *   read_heavy  95% uniform lookups, 5% value updates.
+ *   churn       Each operation inserts a new key and expires the oldest one,
+ *               so the number of live keys stays constant.
+ *   growth      Inserts every key into a table of default size, through
+ *               every bucket split (nothing is loaded beforehand).
+ *   miss_heavy  90% lookups of absent keys, 10% of loaded keys.
+ *
+ * Keys are 16 random-looking bytes derived from a key number and the seed, so
+ * a run is reproducible from its parameters. With more than one thread the
+ * table is a concurrent DPHT: each lookup runs lock-free in its own read
+ * section and writers take the table's writer lock.
+ *
+ * Usage: bench_dpht [-s scenario|all] [-n keys] [-o ops] [-t threads]
+ *                   [-r seed] [-B batch] [-b cmph|fks] [-l max_load] [-A] [-a] [-w]
+ *   -n  Keys loaded (or inserted by growth), 1000000 by default.
+ *   -o  Operations per thread, 1000000 by default (growth inserts n keys in all).
+ *   -B  Operations per timed batch, 32 by default.
+ *   -A  Let the adaptive load controller tune max_load (starting from -l).
+ *   -a  Allocate pairs from an arena.
+ *   -w  Create the table with a fixed key width of 16 bytes.
+ *
+ * The results are printed as one JSON object: the parameters, then for every
+ * scenario the operations run, the throughput, the p50/p99/p99.9/max latency
+ * in nanoseconds, the heap bytes per live key and the max_load in effect at
+ * the end.
+ *
+ * \returns 0 on successful execution.
+ */
+#define BENCH_DEFAULT_KEYS 1000000
+#define BENCH_DEFAULT_OPS 1000000
+#define BENCH_DEFAULT_BATCH 32
+#define BENCH_DEFAULT_SEED 0x2545f4914f6cdd1dULL
+#define BENCH_KEY_LEN 16            // Bytes of every key
+#define BENCH_ZIPF_THETA 0.99       // Skew of the zipf scenario
+#define BENCH_READ_PERCENT 95       // Lookups among the operations of read_heavy
+#define BENCH_MISS_PERCENT 90       // Absent keys among the lookups of miss_heavy
+#define BENCH_CALIBRATION 0.02      // Seconds spent calibrating the cycle counter
+
+typedef enum {
+    BENCH_UNIFORM,
+    BENCH_ZIPF,
+    BENCH_READ_HEAVY,
+    BENCH_CHURN,
+    BENCH_GROWTH,
+    BENCH_MISS_HEAVY,
+    BENCH_SCENARIOS
+} bench_scenario_t;
+
+static const char* bench_names[BENCH_SCENARIOS] = {
+    "uniform", "zipf", "read_heavy", "churn", "growth", "miss_heavy"
+};
+
+/** Zipfian generator over [0, n) (Gray et al., as used by YCSB).
+ *
+ * \param n Number of items.
+ * \param theta Skew; larger values concentrate more draws on the first ranks.
+ * \param alpha 1 / (1 - theta).
+ * \param zetan Generalized harmonic number of n.
+ * \param eta Constant of the inverse transform.
+ */
+typedef struct BenchZipf {
+    size_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} bench_zipf_t;
+
+/** Parameters of a run, shared by every scenario. */
+typedef struct BenchOptions {
+    size_t keys;
+    size_t ops;
+    int threads;
+    int batch;
+    uint64_t seed;
+    dpht_config_t config;
+} bench_options_t;
+
+/** State of one scenario run.
+ *
+ * \param scenario The scenario.
+ * \param options Parameters of the run.
+ * \param dpht The table under test.
+ * \param zipf Rank generator of the zipf scenario.
+ * \param barrier Starts every thread at the same time.
+ */
+typedef struct BenchRun {
+    bench_scenario_t scenario;
+    const bench_options_t* options;
+    DPHT* dpht;
+    bench_zipf_t zipf;
+    pthread_barrier_t barrier;
+} bench_run_t;
+
+/** State of one benchmark thread.
+ *
+ * \param run The scenario run.
+ * \param index Index of the thread, from 0 to threads - 1.
+ * \param ops Number of operations the thread runs.
+ * \param samples Cycles per operation of each batch.
+ * \param count Number of samples taken.
+ * \param start Wall time at which the thread started its operations.
+ * \param end Wall time at which it finished.
+ * \param sink Accumulates looked-up values, so that no lookup is optimized away.
+ * \param reader Read-section handle of a concurrent table, or NULL.
+ */
+typedef struct BenchThread {
+    bench_run_t* run;
+    int index;
+    size_t ops;
+    uint64_t* samples;
+    size_t count;
+    double start;
+    double end;
+    uint64_t sink;
+    epoch_reader_t* reader;
+} bench_thread_t;
+
+/* Helper function: Reads the cycle counter (nanoseconds where there is none) */
+static inline uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/* Helper function: Returns a monotonic time in seconds */
+static double bench_time(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+/* Helper function: Measures the cycle counter against the monotonic clock */
+static double bench_cycles_per_ns(void) {
+    double start = bench_time();
+    uint64_t first = bench_cycles();
+    double now;
+    do {
+        now = bench_time();
+    } while (now - start < BENCH_CALIBRATION);
+    uint64_t last = bench_cycles();
+    return (double)(last - first) / ((now - start) * 1e9);
+}
+
+/* Helper function: Next value of an xorshift64* generator */
+static inline uint64_t bench_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Helper function: Derives an independent nonzero generator state (splitmix64) */
+static uint64_t bench_stream(uint64_t seed, uint64_t stream) {
+    uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+/* Helper function: Builds the key of key number id */
+static inline void bench_key(uint64_t id, uint64_t seed, uint64_t key[2]) {
+    key[0] = hash_mix(id ^ seed, 0x9e3779b97f4a7c15ULL);
+    key[1] = id; // Keeps the keys of distinct numbers distinct
+}
+
+/* Helper function: Returns the bytes currently allocated on the heap */
+static size_t bench_heap_bytes(void) {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* Helper function: Generalized harmonic number sum(1 / i^theta), i = 1..n */
+static double bench_zeta(size_t n, double theta) {
+    double sum = 0.0;
+    for (size_t i = 1; i <= n; i++) {
+        sum += 1.0 / pow((double)i, theta);
+    }
+    return sum;
+}
+
+/* Helper function: Prepares a Zipfian generator over [0, n) */
+static void bench_zipf_init(bench_zipf_t* zipf, size_t n, double theta) {
+    zipf->n = n;
+    zipf->theta = theta;
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->zetan = bench_zeta(n, theta);
+    double zeta2 = bench_zeta(2, theta);
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+}
+
+/* Helper function: Draws a Zipfian rank; rank 0 is the most frequent */
+static size_t bench_zipf_next(const bench_zipf_t* zipf, uint64_t* state) {
+    double u = (double)(bench_random(state) >> 11) / 9007199254740992.0;
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + pow(0.5, zipf->theta)) {
+        return 1;
+    }
+    size_t rank = (size_t)((double)zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+/* Helper function: Number of keys owned by a thread when key numbers are dealt round robin */
+static size_t bench_share(size_t keys, int threads, int index) {
+    return (keys > (size_t)index) ? (keys - (size_t)index + threads - 1) / threads : 0;
+}
+
+/* Helper function: Looks a key number up, adding its value to the thread's sink */
+static inline void bench_lookup(bench_thread_t* thread, uint64_t id) {
+    const bench_options_t* options = thread->run->options;
+    uint64_t key[2];
+    bench_key(id, options->seed, key);
+    dpht_read_begin(thread->reader);
+    uint64_t* value = (uint64_t*)dpht_search_n(thread->run->dpht, key, BENCH_KEY_LEN, NULL);
+    if (value) {
+        thread->sink += *value;
+    }
+    dpht_read_end(thread->reader);
+}
+
+/* Helper function: Inserts or updates a key number */
+static inline void bench_store(bench_thread_t* thread, uint64_t id, uint64_t value) {
+    uint64_t key[2];
+    bench_key(id, thread->run->options->seed, key);
+    dpht_insert_n(thread->run->dpht, key, BENCH_KEY_LEN, &value, sizeof(value));
+}
+
+/* Helper function: Removes a key number */
+static inline void bench_expire(bench_thread_t* thread, uint64_t id) {
+    uint64_t key[2];
+    bench_key(id, thread->run->options->seed, key);
+    dpht_remove_n(thread->run->dpht, key, BENCH_KEY_LEN);
+}
+
+/* Runs operation i of a thread */
+static inline void bench_op(bench_thread_t* thread, size_t i, uint64_t* state) {
+    const bench_options_t* options = thread->run->options;
+    uint64_t n = options->keys;
+    uint64_t threads = (uint64_t)options->threads;
+    switch (thread->run->scenario) {
+    case BENCH_UNIFORM:
+        bench_lookup(thread, bench_random(state) % n);
+        break;
+    case BENCH_ZIPF: {
+        // Scramble the ranks so that popular keys are spread over the buckets
+        uint64_t rank = bench_zipf_next(&thread->run->zipf, state);
+        bench_lookup(thread, hash_mix(rank ^ options->seed, 0xc2b2ae3d27d4eb4fULL) % n);
+        break;
+    }
+    case BENCH_READ_HEAVY: {
+        uint64_t r = bench_random(state);
+        if (r % 100 < BENCH_READ_PERCENT) {
+            bench_lookup(thread, (r >> 8) % n);
+        }
+        else {
+            bench_store(thread, (r >> 8) % n, r);
+        }
+        break;
+    }
+    case BENCH_CHURN: {
+        // The thread's keys are index, index + threads, ...: expire the
+        // oldest one and insert the next one past its live window
+        uint64_t window = bench_share(options->keys, options->threads, thread->index);
+        bench_expire(thread, (uint64_t)i * threads + (uint64_t)thread->index);
+        bench_store(thread, ((uint64_t)i + window) * threads + (uint64_t)thread->index, i);
+        break;
+    }
+    case BENCH_GROWTH:
+        bench_store(thread, (uint64_t)i * threads + (uint64_t)thread->index, i);
+        break;
+    case BENCH_MISS_HEAVY: {
+        uint64_t r = bench_random(state);
+        uint64_t id = (r >> 8) % n;
+        bench_lookup(thread, (r % 100 < BENCH_MISS_PERCENT) ? n + id : id);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* Thread body: runs the thread's operations in timed batches */
+static void* bench_worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    bench_run_t* run = thread->run;
+    int batch = run->options->batch;
+    uint64_t state = bench_stream(run->options->seed, (uint64_t)run->scenario * 1024 + thread->index);
+    thread->reader = dpht_reader_register(run->dpht); // NULL unless concurrent
+
+    pthread_barrier_wait(&run->barrier);
+    thread->start = bench_time();
+    for (size_t done = 0; done < thread->ops; done += batch) {
+        size_t count = thread->ops - done;
+        if (count > (size_t)batch) {
+            count = batch;
+        }
+        uint64_t first = bench_cycles();
+        for (size_t i = done; i < done + count; i++) {
+            bench_op(thread, i, &state);
+        }
+        uint64_t last = bench_cycles();
+        thread->samples[thread->count++] = (last - first) / count;
+    }
+    thread->end = bench_time();
+    dpht_reader_unregister(thread->reader);
+    return NULL;
+}
+
+/* Helper function: qsort() comparison of latency samples */
+static int bench_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Helper function: Returns a percentile of sorted samples, in nanoseconds */
+static double bench_percentile(const uint64_t* sorted, size_t n, double p, double cycles_per_ns) {
+    size_t index = (size_t)(p * (double)(n - 1) + 0.5);
+    return (double)sorted[index] / cycles_per_ns;
+}
+
+/* Runs one scenario and prints its JSON result; returns 0 on failure */
+static int bench_scenario(bench_scenario_t scenario, const bench_options_t* options,
+                          double cycles_per_ns, int first) {
+    bench_run_t run;
+    run.scenario = scenario;
+    run.options = options;
+    if (scenario == BENCH_ZIPF) {
+        bench_zipf_init(&run.zipf, options->keys, BENCH_ZIPF_THETA);
+    }
+
+    int threads = options->threads;
+    bench_thread_t* workers = (bench_thread_t*)calloc(threads, sizeof(bench_thread_t));
+    pthread_t* handles = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    size_t total = 0;
+    int ok = workers && handles;
+    for (int t = 0; ok && t < threads; t++) {
+        workers[t].run = &run;
+        workers[t].index = t;
+        workers[t].ops = (scenario == BENCH_GROWTH) ? bench_share(options->keys, threads, t) : options->ops;
+        workers[t].samples = (uint64_t*)malloc(sizeof(uint64_t) * (workers[t].ops / options->batch + 1));
+        ok = workers[t].samples != NULL;
+        total += workers[t].ops;
+    }
+
+    // Create the table and load every key, except when measuring growth
+    size_t heap = bench_heap_bytes();
+    run.dpht = ok ? dpht_create_with_config(&options->config) : NULL;
+    if (!run.dpht) {
+        fprintf(stderr, "Error: Could not allocate the table or the latency samples\n");
+        ok = 0;
+    }
+    if (ok && scenario != BENCH_GROWTH) {
+        uint64_t key[2];
+        for (uint64_t id = 0; id < options->keys; id++) {
+            bench_key(id, options->seed, key);
+            dpht_insert_n(run.dpht, key, BENCH_KEY_LEN, &id, sizeof(id));
+        }
+    }
+
+    // Run the operations on every thread at once
+    int started = 0;
+    if (ok) {
+        pthread_barrier_init(&run.barrier, NULL, threads);
+        for (started = 0; started < threads; started++) {
+            if (pthread_create(&handles[started], NULL, bench_worker, &workers[started]) != 0) {
+                break;
+            }
+        }
+        if (started < threads) {
+            fprintf(stderr, "Error: Could not start %d threads\n", threads);
+            exit(EXIT_FAILURE); // The started threads wait at the barrier forever
+        }
+        for (int t = 0; t < threads; t++) {
+            pthread_join(handles[t], NULL);
+        }
+        pthread_barrier_destroy(&run.barrier);
+    }
+    size_t bytes = bench_heap_bytes() - heap;
+
+    // Merge the samples of all threads and summarize them
+    uint64_t* samples = NULL;
+    size_t count = 0;
+    for (int t = 0; ok && t < threads; t++) {
+        count += workers[t].count;
+    }
+    samples = ok ? (uint64_t*)malloc(sizeof(uint64_t) * (count ? count : 1)) : NULL;
+    if (samples && count > 0) {
+        double start = workers[0].start, end = workers[0].end;
+        uint64_t sink = 0;
+        size_t next = 0;
+        for (int t = 0; t < threads; t++) {
+            memcpy(samples + next, workers[t].samples, sizeof(uint64_t) * workers[t].count);
+            next += workers[t].count;
+            start = (workers[t].start < start) ? workers[t].start : start;
+            end = (workers[t].end > end) ? workers[t].end : end;
+            sink += workers[t].sink;
+        }
+        qsort(samples, count, sizeof(uint64_t), bench_compare);
+        double seconds = end - start;
+        printf("%s\n    {\"name\": \"%s\", \"ops\": %zu, \"seconds\": %.6f, \"mops\": %.3f, "
+               "\"latency_ns\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}, "
+               "\"keys\": %d, \"buckets\": %d, \"bytes_per_key\": %.1f, \"max_load\": %.2f, "
+               "\"checksum\": %llu}",
+               first ? "" : ",", bench_names[scenario], total, seconds,
+               seconds > 0.0 ? total / seconds / 1e6 : 0.0,
+               bench_percentile(samples, count, 0.50, cycles_per_ns),
+               bench_percentile(samples, count, 0.99, cycles_per_ns),
+               bench_percentile(samples, count, 0.999, cycles_per_ns),
+               (double)samples[count - 1] / cycles_per_ns,
+               run.dpht->size, run.dpht->capacity,
+               run.dpht->size > 0 ? (double)bytes / run.dpht->size : 0.0, run.dpht->max_load,
+               (unsigned long long)sink);
+    }
+    else if (ok) {
+        printf("%s\n    {\"name\": \"%s\", \"ops\": 0}", first ? "" : ",", bench_names[scenario]);
+    }
+
+    free(samples);
+    for (int t = 0; workers && t < threads; t++) {
+        free(workers[t].samples);
+    }
+    free(workers);
+    free(handles);
+    dpht_free(run.dpht);
+    return ok;
+}
+
+/* Helper function: Prints the usage line */
+static void bench_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-s scenario|all] [-n keys] [-o ops] [-t threads] [-r seed] "
+                    "[-B batch] [-b cmph|fks] [-l max_load] [-A] [-a] [-w]\n", program);
+}
+
+int main(int argc, char** argv) {
+    bench_options_t options;
+    options.keys = BENCH_DEFAULT_KEYS;
+    options.ops = BENCH_DEFAULT_OPS;
+    options.threads = 1;
+    options.batch = BENCH_DEFAULT_BATCH;
+    options.seed = BENCH_DEFAULT_SEED;
+    dpht_config_init(&options.config);
+    const char* only = "all";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:o:t:r:B:b:l:Aaw")) != -1) {
+        switch (opt) {
+        case 's': only = optarg; break;
+        case 'n': options.keys = strtoull(optarg, NULL, 10); break;
+        case 'o': options.ops = strtoull(optarg, NULL, 10); break;
+        case 't': options.threads = atoi(optarg); break;
+        case 'r': options.seed = strtoull(optarg, NULL, 0); break;
+        case 'B': options.batch = atoi(optarg); break;
+        case 'b': options.config.backend = strcmp(optarg, "fks") == 0 ? PHT_BACKEND_FKS : PHT_BACKEND_CMPH; break;
+        case 'l': options.config.max_load = atof(optarg); break;
+        case 'A': options.config.adaptive_load = 1; break;
+        case 'a': options.config.use_arena = 1; break;
+        case 'w': options.config.key_width = BENCH_KEY_LEN; break;
+        default:
+            bench_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.keys < 1 || options.threads < 1 || options.batch < 1) {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    options.config.seed = options.seed;             // Same buckets on every run
+    options.config.concurrent = options.threads > 1; // Lock-free readers next to writers
+
+    int selected = -1;
+    for (int s = 0; s < BENCH_SCENARIOS; s++) {
+        if (strcmp(only, bench_names[s]) == 0) {
+            selected = s;
+        }
+    }
+    if (selected < 0 && strcmp(only, "all") != 0) {
+        fprintf(stderr, "Error: Unknown scenario %s\n", only);
+        return EXIT_FAILURE;
+    }
+
+    double cycles_per_ns = bench_cycles_per_ns();
+    printf("{\n  \"benchmark\": \"dpht\", \"keys\": %zu, \"ops_per_thread\": %zu, \"threads\": %d, "
+           "\"seed\": %llu, \"batch\": %d,\n"
+           "  \"config\": {\"backend\": \"%s\", \"max_load\": %.2f, \"adaptive\": %d, \"arena\": %d, "
+           "\"key_width\": %d, \"concurrent\": %d},\n  \"cycles_per_ns\": %.3f,\n  \"scenarios\": [",
+           options.keys, options.ops, options.threads, (unsigned long long)options.seed, options.batch,
+           options.config.backend == PHT_BACKEND_FKS ? "fks" : "cmph", options.config.max_load,
+           options.config.adaptive_load, options.config.use_arena, options.config.key_width, options.config.concurrent, cycles_per_ns);
+
+    int first = 1;
+    for (int s = 0; s < BENCH_SCENARIOS; s++) {
+        if (selected >= 0 && s != selected) {
+            continue;
+        }
+        if (!bench_scenario((bench_scenario_t)s, &options, cycles_per_ns, first)) {
+            return EXIT_FAILURE;
+        }
+        first = 0;
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
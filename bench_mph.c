@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "DPHT.h"
+
+/**
+ * Compares the MPH algorithms and size policies of PHT_BACKEND_CMPH buckets.
+ *
+ * CMPH's algorithms trade construction speed, evaluation speed and space
+ * differently, and the balance depends on how many keys a bucket holds. This
+ * program measures both sides of the choice:
+ *   1. For each algorithm and bucket size: build time per bucket, evaluation
+ *      time per lookup, and packed MPH bytes per key.
+ *   2. For each dpht_config_t mph_policy (with and without seed searches for
+ *      small buckets): the time to load a DPHT one key at a
+ *      time (rebuild bound), then the time to look every key up (lookup bound).
+ *
+ * Usage: bench_mph [keys]   (200000 keys by default)
+ *
+ * \returns 0 on successful execution.
+ */
+#define BENCH_SEED 0x2545f4914f6cdd1dULL   // Fixed seed, so runs are reproducible
+#define BENCH_KEY_LEN 40                    // Buffer size of a generated key
+#define BENCH_BUILD_KEYS 65536              // Keys built into MPHs per bucket size
+#define BENCH_LOOKUP_ROUNDS 4               // Lookup passes per measurement
+
+/* Helper function: Returns a monotonic time in seconds */
+static double bench_time(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+/* Helper function: Next value of an xorshift64* generator */
+static uint64_t bench_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Helper function: Fills keys[i] with n distinct flow-like keys */
+static char* bench_make_keys(size_t n, char** keys) {
+    char* storage = (char*)malloc(n * BENCH_KEY_LEN);
+    if (!storage) {
+        return NULL;
+    }
+    uint64_t state = BENCH_SEED;
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = storage + i * BENCH_KEY_LEN;
+        snprintf(keys[i], BENCH_KEY_LEN, "flow_%zu_%u", i, (unsigned)bench_random(&state));
+    }
+    return storage;
+}
+
+/* Part 1: one algorithm on buckets of a given size */
+static void bench_algorithm(const pht_mph_ops_t* ops, int bucket, char** keys) {
+    int buckets = BENCH_BUILD_KEYS / bucket;
+    cmph_uint8** records = (cmph_uint8**)malloc(sizeof(cmph_uint8*) * bucket);
+    cmph_uint8* bytes = (cmph_uint8*)malloc((size_t)bucket * (sizeof(cmph_uint32) + BENCH_KEY_LEN));
+    cmph_t** mphs = (cmph_t**)calloc(buckets, sizeof(cmph_t*));
+    if (!records || !bytes || !mphs) {
+        free(records);
+        free(bytes);
+        free(mphs);
+        return;
+    }
+
+    // Build one MPH per bucket of consecutive keys
+    double build = 0.0;
+    size_t packed = 0;
+    int failed = 0;
+    for (int b = 0; b < buckets; b++) {
+        cmph_uint8* cursor = bytes;
+        for (int i = 0; i < bucket; i++) {
+            const char* key = keys[b * bucket + i];
+            cmph_uint32 len = (cmph_uint32)strlen(key);
+            memcpy(cursor, &len, sizeof(len));
+            memcpy(cursor + sizeof(len), key, len);
+            records[i] = cursor;
+            cursor += sizeof(len) + len;
+        }
+        double start = bench_time();
+        mphs[b] = ops->build(records, bucket);
+        build += bench_time() - start;
+        if (mphs[b]) {
+            packed += cmph_packed_size(mphs[b]);
+        }
+        else {
+            failed++;
+        }
+    }
+
+    // Evaluate every MPH on its own keys
+    volatile cmph_uint32 sink = 0;
+    double start = bench_time();
+    for (int round = 0; round < BENCH_LOOKUP_ROUNDS; round++) {
+        for (int b = 0; b < buckets; b++) {
+            if (!mphs[b]) {
+                continue;
+            }
+            for (int i = 0; i < bucket; i++) {
+                const char* key = keys[b * bucket + i];
+                sink += cmph_search(mphs[b], key, (cmph_uint32)strlen(key));
+            }
+        }
+    }
+    double lookup = bench_time() - start;
+    int built = buckets - failed;
+
+    printf("%-4s %6d keys/bucket: build %9.1f us/bucket, eval %6.1f ns/key, %7.2f bytes/key",
+           ops->name, bucket, built ? build / built * 1e6 : 0.0,
+           built ? lookup / ((double)BENCH_LOOKUP_ROUNDS * built * bucket) * 1e9 : 0.0,
+           built ? (double)packed / ((double)built * bucket) : 0.0);
+    printf(failed ? ", %d builds failed\n" : "\n", failed);
+
+    for (int b = 0; b < buckets; b++) {
+        if (mphs[b]) {
+            cmph_destroy(mphs[b]);
+        }
+    }
+    free(records);
+    free(bytes);
+    free(mphs);
+}
+
+/* Part 2: a whole DPHT under one policy */
+static void bench_policy(const char* name, const pht_mph_policy_t* policy, char** keys, size_t n) {
+    dpht_config_t config;
+    dpht_config_init(&config);
+    config.mph_policy = *policy;
+    config.seed = BENCH_SEED;
+    DPHT* dpht = dpht_create_with_config(&config);
+    if (!dpht) {
+        fprintf(stderr, "Error: Could not create the DPHT\n");
+        return;
+    }
+
+    double start = bench_time();
+    for (size_t i = 0; i < n; i++) {
+        dpht_insert(dpht, keys[i], keys[i]);
+    }
+    double load = bench_time() - start;
+
+    size_t found = 0;
+    start = bench_time();
+    for (int round = 0; round < BENCH_LOOKUP_ROUNDS; round++) {
+        for (size_t i = 0; i < n; i++) {
+            found += (dpht_search(dpht, keys[(i * 7919) % n]) != NULL);
+        }
+    }
+    double lookup = bench_time() - start;
+
+    printf("%-24s load %7.1f ns/key, lookup %6.1f ns/key (%zu found)\n", name,
+           load / n * 1e9, lookup / ((double)BENCH_LOOKUP_ROUNDS * n) * 1e9, found);
+    dpht_free(dpht);
+}
+
+int main(int argc, char** argv) {
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+    if (n < BENCH_BUILD_KEYS) {
+        n = BENCH_BUILD_KEYS;
+    }
+    char** keys = (char**)malloc(sizeof(char*) * n);
+    char* storage = keys ? bench_make_keys(n, keys) : NULL;
+    if (!storage) {
+        fprintf(stderr, "Error: Could not allocate %zu keys\n", n);
+        free(keys);
+        return EXIT_FAILURE;
+    }
+
+    // 1. Algorithms by bucket size
+    const pht_mph_ops_t* algorithms[] = { &pht_mph_chd, &pht_mph_bdz, &pht_mph_bmz, &pht_mph_chm };
+    const int sizes[] = { 2, 5, 16, 64, 256, 2048 };
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            bench_algorithm(algorithms[a], sizes[s], keys);
+        }
+    }
+
+    // 2. Policies on a whole DPHT
+    pht_mph_policy_t cmphOnly, chd, bdz, sized, graph;
+    pht_mph_policy_init(&cmphOnly);
+    cmphOnly.seed_max_keys = 0;
+    pht_mph_policy_init(&chd);
+    pht_mph_policy_init(&bdz);
+    bdz.large = &pht_mph_bdz;
+    pht_mph_policy_init(&sized);
+    pht_mph_policy_add_tier(&sized, 64, &pht_mph_bdz);
+    pht_mph_policy_init(&graph);
+    pht_mph_policy_add_tier(&graph, 16, &pht_mph_bmz);
+    pht_mph_policy_add_tier(&graph, 256, &pht_mph_bdz);
+    printf("\n%zu keys, one at a time:\n", n);
+    bench_policy("chd, no seed search", &cmphOnly, keys, n);
+    bench_policy("seed<=8, chd", &chd, keys, n);
+    bench_policy("bdz", &bdz, keys, n);
+    bench_policy("bdz<=64, chd", &sized, keys, n);
+    bench_policy("bmz<=16, bdz<=256, chd", &graph, keys, n);
+
+    free(storage);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,461 @@
+#include "dpht_file.h"
+#include "PHT.h"
+#include "pair.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DPHT_FILE_ALIGN 8   // Alignment of every section and packed MPH
+#define DPHT_FILE_ROUND_UP(n) (((n) + DPHT_FILE_ALIGN - 1) & ~(uint64_t)(DPHT_FILE_ALIGN - 1))
+
+/** Computes the offset of a value from the start of its key in the heap.
+ *
+ * \param key_len Number of bytes in the key.
+ * \returns The offset, rounded up to DPHT_FILE_ALIGN.
+ */
+static uint64_t dpht_file_value_offset(uint64_t key_len) {
+    return DPHT_FILE_ROUND_UP(key_len + 1);
+}
+
+/** Computes the heap bytes taken by a pair, padding included.
+ *
+ * \param pair Pointer to the pair.
+ * \returns The size in bytes, a multiple of DPHT_FILE_ALIGN.
+ */
+static uint64_t dpht_file_record_size(const pair_t* pair) {
+    return DPHT_FILE_ROUND_UP(dpht_file_value_offset(pair->key_len) + pair->value_len + 1);
+}
+
+/** Builds an MPH over all keys of a bucket whose own MPH cannot be saved.
+ *
+ * \param table Pointer to the bucket.
+ * \returns The new MPH, or NULL on failure.
+ */
+static cmph_t* dpht_file_build_mph(const PHT* table) {
+    int n = table->size - table->tombstones;
+    size_t bytes = 0;
+    for (int i = 0; i < table->size; i++) {
+        if (table->entries[i]) {
+            bytes += sizeof(cmph_uint32) + table->entries[i]->key_len;
+        }
+    }
+
+    // Keys in CMPH byte-vector format, all in one allocation
+    cmph_uint8** keys = (cmph_uint8**)malloc(sizeof(cmph_uint8*) * n + bytes);
+    if (!keys) {
+        return NULL; // Memory allocation failed
+    }
+    cmph_uint8* cursor = (cmph_uint8*)(keys + n);
+    int k = 0;
+    for (int i = 0; i < table->size; i++) {
+        const pair_t* pair = table->entries[i];
+        if (!pair) {
+            continue; // Tombstone
+        }
+        cmph_uint32 key_len = (cmph_uint32)pair->key_len;
+        keys[k++] = cursor;
+        memcpy(cursor, &key_len, sizeof(key_len));
+        memcpy(cursor + sizeof(key_len), pair->key, pair->key_len);
+        cursor += sizeof(key_len) + pair->key_len;
+    }
+
+    cmph_t* mph = pht_build_mph(keys, n);
+    free(keys);
+    return mph;
+}
+
+/** Writes zero bytes until the file position reaches an offset.
+ *
+ * \param file The file being written.
+ * \param position Current file position, updated on return.
+ * \param offset Offset to reach.
+ * \returns 1 on success, 0 on a write error.
+ */
+static int dpht_file_pad(FILE* file, uint64_t* position, uint64_t offset) {
+    static const char zeros[DPHT_FILE_ALIGN] = { 0 };
+    while (*position < offset) {
+        size_t chunk = (offset - *position > DPHT_FILE_ALIGN) ? DPHT_FILE_ALIGN : (size_t)(offset - *position);
+        if (fwrite(zeros, 1, chunk, file) != chunk) {
+            return 0;
+        }
+        *position += chunk;
+    }
+    return 1;
+}
+
+/** Writes the sections of a table file whose layout has been computed.
+ *
+ * \param file The file to write.
+ * \param dpht Pointer to the DPHT being saved.
+ * \param header The completed file header.
+ * \param buckets The completed bucket descriptors.
+ * \param mphs The MPH of every bucket (NULL for buckets with fewer than 2 entries).
+ * \returns 1 on success, 0 on failure.
+ */
+static int dpht_file_write(FILE* file, const DPHT* dpht, const dpht_file_header_t* header,
+                           const dpht_file_bucket_t* buckets, cmph_t** mphs) {
+    uint64_t position = 0;
+    if (fwrite(header, sizeof(*header), 1, file) != 1) {
+        return 0;
+    }
+    position += sizeof(*header);
+
+    // Bucket descriptors
+    if (!dpht_file_pad(file, &position, header->buckets_offset) ||
+        fwrite(buckets, sizeof(*buckets), header->capacity, file) != header->capacity) {
+        return 0;
+    }
+    position += sizeof(*buckets) * header->capacity;
+
+    // Entries, each bucket laid out in the order of its MPH
+    if (!dpht_file_pad(file, &position, header->entries_offset)) {
+        return 0;
+    }
+    uint64_t heap_cursor = 0;
+    for (uint32_t b = 0; b < header->capacity; b++) {
+        const PHT* table = dpht->tables[b];
+        int count = (int)buckets[b].count;
+        if (count == 0) {
+            continue;
+        }
+        dpht_file_entry_t* entries = (dpht_file_entry_t*)calloc(count, sizeof(dpht_file_entry_t));
+        if (!entries) {
+            return 0; // Memory allocation failed
+        }
+        int k = 0;
+        for (int i = 0; i < table->size; i++) {
+            const pair_t* pair = table->entries[i];
+            if (!pair) {
+                continue; // Tombstone, only in buckets saved with a new MPH
+            }
+            int slot = k++;
+            if (mphs[b] && mphs[b] != table->mph) {
+                // The MPH was built for the file: entries follow its order
+                slot = (int)(cmph_search(mphs[b], pair->key, (cmph_uint32)pair->key_len) % count);
+            }
+            entries[slot].hash = pair->hash;
+            entries[slot].offset = heap_cursor;
+            entries[slot].key_len = (uint32_t)pair->key_len;
+            entries[slot].value_len = (uint32_t)pair->value_len;
+            entries[slot].tag = pht_tag(pair->hash);
+            heap_cursor += dpht_file_record_size(pair);
+        }
+        size_t written = fwrite(entries, sizeof(dpht_file_entry_t), count, file);
+        free(entries);
+        if (written != (size_t)count) {
+            return 0;
+        }
+        position += sizeof(dpht_file_entry_t) * count;
+    }
+
+    // Heap, in the same order as the entry offsets above
+    if (!dpht_file_pad(file, &position, header->heap_offset)) {
+        return 0;
+    }
+    for (uint32_t b = 0; b < header->capacity; b++) {
+        const PHT* table = dpht->tables[b];
+        for (int i = 0; i < table->size; i++) {
+            const pair_t* pair = table->entries[i];
+            if (!pair) {
+                continue; // Tombstone
+            }
+            // The heap starts aligned, so aligned positions are aligned offsets
+            if (fwrite(pair->key, 1, pair->key_len + 1, file) != pair->key_len + 1) {
+                return 0;
+            }
+            position += pair->key_len + 1;
+            if (!dpht_file_pad(file, &position, DPHT_FILE_ROUND_UP(position)) ||
+                fwrite(pair->value, 1, pair->value_len + 1, file) != pair->value_len + 1) {
+                return 0;
+            }
+            position += pair->value_len + 1;
+            if (!dpht_file_pad(file, &position, DPHT_FILE_ROUND_UP(position))) {
+                return 0;
+            }
+        }
+    }
+
+    // Packed MPHs
+    for (uint32_t b = 0; b < header->capacity; b++) {
+        if (!buckets[b].mph_offset) {
+            continue;
+        }
+        cmph_uint32 packed_size = cmph_packed_size(mphs[b]);
+        void* packed = malloc(packed_size);
+        if (!packed) {
+            return 0; // Memory allocation failed
+        }
+        cmph_pack(mphs[b], packed);
+        int ok = dpht_file_pad(file, &position, buckets[b].mph_offset) &&
+                 fwrite(packed, 1, packed_size, file) == packed_size;
+        free(packed);
+        if (!ok) {
+            return 0;
+        }
+        position += packed_size;
+    }
+    return dpht_file_pad(file, &position, header->file_size);
+}
+
+int dpht_save(DPHT* dpht, const char* path) {
+    if (!dpht || !path) {
+        return 0; // Invalid parameters
+    }
+    if (dpht->hash) {
+        return 0; // Readers of the file could not compute a custom hash
+    }
+
+    int capacity = dpht->capacity;
+    dpht_file_bucket_t* buckets = (dpht_file_bucket_t*)calloc(capacity, sizeof(dpht_file_bucket_t));
+    cmph_t** mphs = (cmph_t**)calloc(capacity, sizeof(cmph_t*));
+    char* temp_path = (char*)malloc(strlen(path) + 5);
+    if (!buckets || !mphs || !temp_path) {
+        free(buckets);
+        free(mphs);
+        free(temp_path);
+        return 0; // Memory allocation failed
+    }
+
+    // Lay out the file: header, buckets, entries, heap, then the packed MPHs
+    dpht_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DPHT_FILE_MAGIC, sizeof(DPHT_FILE_MAGIC));
+    header.version = DPHT_FILE_VERSION;
+    header.header_size = sizeof(header);
+    header.capacity = (uint32_t)capacity;
+    header.base = (uint32_t)dpht->base;
+    header.split = (uint32_t)dpht->split;
+    header.seed = dpht->seed;
+
+    uint64_t heap_size = 0;
+    int ok = 1;
+    for (int b = 0; b < capacity && ok; b++) {
+        PHT* table = dpht->tables[b];
+        pht_sync(table); // Install a finished background rebuild first
+
+        // Buckets with tombstones are saved without them, under a new MPH
+        int count = table->size - table->tombstones;
+        buckets[b].first_entry = header.size;
+        buckets[b].count = (uint32_t)count;
+        if (table->mph && table->tombstones == 0) {
+            mphs[b] = table->mph;
+            buckets[b].mph_size = (uint32_t)table->mph_size;
+        }
+        else if (table->mph_size > 0 && table->tombstones == 0) {
+            buckets[b].mph_size = (uint32_t)table->mph_size; // Seed-search MPH
+            buckets[b].seed = (uint32_t)table->seed;
+        }
+        else if (count > 1) {
+            mphs[b] = dpht_file_build_mph(table);
+            buckets[b].mph_size = (uint32_t)count;
+            ok = (mphs[b] != NULL);
+        }
+        header.size += (uint64_t)count;
+        for (int i = 0; i < table->size; i++) {
+            if (table->entries[i]) {
+                heap_size += dpht_file_record_size(table->entries[i]);
+            }
+        }
+    }
+    header.buckets_offset = DPHT_FILE_ROUND_UP(sizeof(header));
+    header.entries_offset = DPHT_FILE_ROUND_UP(header.buckets_offset + sizeof(dpht_file_bucket_t) * capacity);
+    header.heap_offset = DPHT_FILE_ROUND_UP(header.entries_offset + sizeof(dpht_file_entry_t) * header.size);
+    uint64_t end = header.heap_offset + heap_size;
+    for (int b = 0; b < capacity && ok; b++) {
+        if (mphs[b]) {
+            buckets[b].mph_offset = DPHT_FILE_ROUND_UP(end);
+            end = buckets[b].mph_offset + cmph_packed_size(mphs[b]);
+        }
+    }
+    header.file_size = DPHT_FILE_ROUND_UP(end);
+
+    // Write to a temporary file and rename it into place
+    if (ok) {
+        sprintf(temp_path, "%s.tmp", path);
+        FILE* file = fopen(temp_path, "wb");
+        ok = file && dpht_file_write(file, dpht, &header, buckets, mphs);
+        if (file && fclose(file) != 0) {
+            ok = 0;
+        }
+        if (ok && rename(temp_path, path) != 0) {
+            ok = 0;
+        }
+        if (!ok && file) {
+            remove(temp_path);
+        }
+    }
+
+    // Release the MPHs that were only built for the file
+    for (int b = 0; b < capacity; b++) {
+        if (mphs[b] && mphs[b] != dpht->tables[b]->mph) {
+            cmph_destroy(mphs[b]);
+        }
+    }
+    free(buckets);
+    free(mphs);
+    free(temp_path);
+    return ok;
+}
+
+/** Checks that a mapped file is a complete table file of this version.
+ *
+ * Only the header and the bucket descriptors are checked, so opening a file
+ * does not read its entries or its heap.
+ *
+ * \param base Start of the mapping.
+ * \param length Length of the mapping in bytes.
+ * \returns 1 if the file is usable, 0 otherwise.
+ */
+static int dpht_file_valid(const void* base, size_t length) {
+    const dpht_file_header_t* header = (const dpht_file_header_t*)base;
+    if (length < sizeof(*header) || memcmp(header->magic, DPHT_FILE_MAGIC, sizeof(DPHT_FILE_MAGIC)) != 0 ||
+        header->version != DPHT_FILE_VERSION || header->header_size != sizeof(*header) ||
+        header->file_size != length || header->capacity == 0 || header->base == 0 ||
+        (header->base & (header->base - 1)) != 0 || header->split >= header->base || header->capacity != header->base + header->split) {
+        return 0;
+    }
+    if (header->buckets_offset + sizeof(dpht_file_bucket_t) * header->capacity > header->entries_offset ||
+        header->entries_offset + sizeof(dpht_file_entry_t) * header->size > header->heap_offset ||
+        header->heap_offset > length || header->heap_offset % DPHT_FILE_ALIGN != 0) {
+        return 0;
+    }
+
+    const dpht_file_bucket_t* buckets =
+        (const dpht_file_bucket_t*)((const char*)base + header->buckets_offset);
+    for (uint32_t b = 0; b < header->capacity; b++) {
+        if (buckets[b].first_entry + buckets[b].count > header->size ||
+            buckets[b].mph_size > buckets[b].count || buckets[b].mph_offset >= length ||
+            (buckets[b].mph_size > PHT_SEED_LIMIT && buckets[b].mph_offset == 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+DPHT_mapped* dpht_open_mmap(const char* path) {
+    if (!path) {
+        return NULL; // Invalid parameters
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL; // File cannot be opened
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(dpht_file_header_t)) {
+        close(fd);
+        return NULL; // Not a table file
+    }
+    size_t length = (size_t)st.st_size;
+    void* base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    if (!dpht_file_valid(base, length)) {
+        munmap(base, length);
+        return NULL; // Corrupt file or different version
+    }
+
+    DPHT_mapped* mapped = (DPHT_mapped*)malloc(sizeof(DPHT_mapped));
+    if (!mapped) {
+        munmap(base, length);
+        return NULL; // Memory allocation failed
+    }
+    mapped->base = base;
+    mapped->length = length;
+    mapped->header = (const dpht_file_header_t*)base;
+    mapped->buckets = (const dpht_file_bucket_t*)((const char*)base + mapped->header->buckets_offset);
+    mapped->entries = (const dpht_file_entry_t*)((const char*)base + mapped->header->entries_offset);
+    mapped->heap = (const char*)base + mapped->header->heap_offset;
+    return mapped;
+}
+
+char* dpht_mapped_search(const DPHT_mapped* mapped, const char* key) {
+    if (!mapped || !key) {
+        return NULL; // Invalid parameters
+    }
+    return (char*)dpht_mapped_search_n(mapped, key, strlen(key), NULL);
+}
+
+/** Compares a mapped entry with a key.
+ *
+ * \param mapped Pointer to the mapped table.
+ * \param entry Pointer to the entry.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns 1 if the entry holds the key, 0 otherwise.
+ */
+static int dpht_mapped_matches(const DPHT_mapped* mapped, const dpht_file_entry_t* entry,
+                               const void* key, size_t key_len, uint64_t hash) {
+    if (entry->tag != pht_tag(hash) || entry->hash != hash || entry->key_len != key_len) {
+        return 0;
+    }
+    uint64_t heap_size = mapped->length - mapped->header->heap_offset;
+    if (entry->offset % DPHT_FILE_ALIGN != 0 ||
+        entry->offset + dpht_file_value_offset(entry->key_len) + entry->value_len + 1 > heap_size) {
+        return 0; // Entry misaligned or outside the heap
+    }
+    return memcmp(mapped->heap + entry->offset, key, key_len) == 0;
+}
+
+void* dpht_mapped_search_n(const DPHT_mapped* mapped, const void* key, size_t key_len,
+                           size_t* value_len) {
+    if (!mapped || !key) {
+        return NULL; // Invalid parameters
+    }
+
+    // Locate the bucket exactly as the DPHT that wrote the file did
+    const dpht_file_header_t* header = mapped->header;
+    uint64_t hash = hash_bytes_seeded(key, key_len, header->seed);
+    uint64_t index = hash & ((uint64_t)header->base - 1);
+    if (index < header->split) {
+        index = hash & ((uint64_t)header->base * 2 - 1);
+    }
+    const dpht_file_bucket_t* bucket = &mapped->buckets[index];
+    const dpht_file_entry_t* entries = mapped->entries + bucket->first_entry;
+
+    // Probe the MPH-indexed entries, then scan the delta area
+    const dpht_file_entry_t* found = NULL;
+    if (bucket->mph_size > 0) {
+        cmph_uint32 slot;
+        if (bucket->mph_offset) {
+            void* packed = (char*)mapped->base + bucket->mph_offset;
+            slot = cmph_search_packed(packed, (const char*)key, (cmph_uint32)key_len);
+            slot = slot % bucket->mph_size;
+        }
+        else {
+            slot = (cmph_uint32)pht_seed_slot(hash, bucket->seed, (int)bucket->mph_size);
+        }
+        if (dpht_mapped_matches(mapped, &entries[slot], key, key_len, hash)) {
+            found = &entries[slot];
+        }
+    }
+    for (uint32_t i = bucket->mph_size; !found && i < bucket->count; i++) {
+        if (dpht_mapped_matches(mapped, &entries[i], key, key_len, hash)) {
+            found = &entries[i];
+        }
+    }
+
+    if (!found) {
+        return NULL; // Key not found
+    }
+    if (value_len) {
+        *value_len = found->value_len;
+    }
+    return (void*)(mapped->heap + found->offset + dpht_file_value_offset(found->key_len));
+}
+
+void dpht_mapped_close(DPHT_mapped* mapped) {
+    if (!mapped) {
+        return;
+    }
+    munmap(mapped->base, mapped->length);
+    free(mapped);
+}
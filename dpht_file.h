@@ -0,0 +1,169 @@
+#ifndef DPHT_FILE_H
+#define DPHT_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "DPHT.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DPHT_FILE_MAGIC "DPHTMAP"   // First bytes of every table file (NUL included)
+#define DPHT_FILE_VERSION 3         // Layout version written by dpht_save()
+
+/** Header at the start of a table file.
+ *
+ * Every position in the file is a byte offset from the start of the file, so
+ * the file can be mapped at any address and used in place. All integers are
+ * stored in the byte order of the machine that wrote the file.
+ *
+ * \param magic DPHT_FILE_MAGIC.
+ * \param version DPHT_FILE_VERSION of the writer.
+ * \param header_size sizeof(dpht_file_header_t) of the writer.
+ * \param file_size Total size of the file in bytes.
+ * \param size Number of key-value pairs.
+ * \param capacity Number of buckets.
+ * \param base Linear-hashing base of the directory (a power of two).
+ * \param split Linear-hashing split pointer of the directory.
+ * \param buckets_offset Offset of the capacity bucket descriptors.
+ * \param entries_offset Offset of the size entries, grouped by bucket.
+ * \param heap_offset Offset of the key and value bytes.
+ * \param seed Seed of the table's hash_bytes_seeded() hash.
+ */
+typedef struct DPHTFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t size;
+    uint32_t capacity;
+    uint32_t base;
+    uint32_t split;
+    uint32_t reserved;
+    uint64_t buckets_offset;
+    uint64_t entries_offset;
+    uint64_t heap_offset;
+    uint64_t seed;
+} dpht_file_header_t;
+
+/** Descriptor of one bucket in a table file.
+ *
+ * The first mph_size entries of a bucket are in MPH order; the remaining
+ * count - mph_size entries form a small delta area that is scanned. Small
+ * buckets are indexed by a seed-search MPH (pht_seed_slot()) and store no
+ * CMPH function.
+ *
+ * \param mph_offset Offset of the packed CMPH function (cmph_pack()), or 0 if
+ *                   the bucket has none.
+ * \param first_entry Index of the bucket's first entry.
+ * \param count Number of entries in the bucket.
+ * \param mph_size Number of entries indexed by the MPH.
+ * \param seed Seed of the seed-search MPH, if mph_size > 0 and mph_offset is 0.
+ */
+typedef struct DPHTFileBucket {
+    uint64_t mph_offset;
+    uint64_t first_entry;
+    uint32_t count;
+    uint32_t mph_size;
+    uint32_t seed;
+    uint32_t reserved;
+} dpht_file_bucket_t;
+
+/** One key-value pair in a table file.
+ *
+ * The key and the value are stored one after the other in the heap, each
+ * followed by a NUL byte. The key starts on an 8-byte boundary and the value
+ * starts at the next 8-byte boundary after the key's NUL, so binary values
+ * can be read in place from the mapping.
+ *
+ * \param hash Full hash of the key.
+ * \param offset Offset of the key bytes in the heap (a multiple of 8).
+ * \param key_len Number of bytes in the key.
+ * \param value_len Number of bytes in the value.
+ * \param tag 8-bit fingerprint of the key (pht_tag()).
+ */
+typedef struct DPHTFileEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t key_len;
+    uint32_t value_len;
+    uint8_t tag;
+    uint8_t padding[7];
+} dpht_file_entry_t;
+
+/** Structure for a table file mapped into memory.
+ *
+ * Lookups read the mapping directly: nothing is deserialized when the file is
+ * opened, so the cost of opening does not depend on the number of keys and
+ * only the pages touched by lookups are read from disk.
+ *
+ * \param base Start of the mapping.
+ * \param length Length of the mapping in bytes.
+ * \param header The file header.
+ * \param buckets The bucket descriptors.
+ * \param entries The entries of all buckets.
+ * \param heap The key and value bytes.
+ */
+typedef struct DPHTMapped {
+    void* base;
+    size_t length;
+    const dpht_file_header_t* header;
+    const dpht_file_bucket_t* buckets;
+    const dpht_file_entry_t* entries;
+    const char* heap;
+} DPHT_mapped;
+
+/** Writes the contents of a DPHT to a table file.
+ *
+ * Buckets keep their MPH, which is stored packed. A bucket without an MPH
+ * (e.g. an FKS bucket) gets one built for the file. The file is written to a
+ * temporary name and renamed into place, so a reader never sees half of it.
+ * The file records the seed of the table's hash; only tables using the
+ * default hash function (hash_bytes_seeded()) can be saved.
+ *
+ * \param dpht Pointer to the DPHT to save.
+ * \param path Path of the file to write.
+ * \returns 1 on success, 0 on failure.
+ */
+int dpht_save(DPHT* dpht, const char* path);
+
+/** Maps a table file written by dpht_save() for lookups.
+ *
+ * \param path Path of the file to map.
+ * \returns A pointer to the mapped table, or NULL if the file cannot be mapped
+ *          or is not a valid table file of this version.
+ */
+DPHT_mapped* dpht_open_mmap(const char* path);
+
+/** Searches for a key in a mapped table.
+ *
+ * \param mapped Pointer to the mapped table.
+ * \param key The key string to search for.
+ * \returns Pointer to the value string in the mapping if found, or NULL otherwise.
+ */
+char* dpht_mapped_search(const DPHT_mapped* mapped, const char* key);
+
+/** Searches for a binary key in a mapped table.
+ *
+ * \param mapped Pointer to the mapped table.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes in the mapping if found, or NULL otherwise.
+ *          The value is 8-byte aligned.
+ */
+void* dpht_mapped_search_n(const DPHT_mapped* mapped, const void* key, size_t key_len,
+                           size_t* value_len);
+
+/** Unmaps a table file.
+ *
+ * \param mapped Pointer to the mapped table (NULL is ignored).
+ */
+void dpht_mapped_close(DPHT_mapped* mapped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DPHT_FILE_H
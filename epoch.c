@@ -0,0 +1,173 @@
+#include "epoch.h"
+#include <stdlib.h>
+
+#define EPOCH_QUIESCENT 0   // Announced epoch of a reader outside any critical section
+
+/** Structure for the slot of one reader thread.
+ *
+ * \param epoch The global epoch announced on entry, or EPOCH_QUIESCENT.
+ * \param global Pointer to the global epoch of the owning domain.
+ * \param in_use 1 while the slot is claimed by a thread.
+ */
+struct EpochReader {
+    uint64_t epoch;
+    const uint64_t* global;
+    int in_use;
+} __attribute__((aligned(64)));   // One cache line per reader, no false sharing
+
+/** Structure for one object waiting to be freed.
+ *
+ * \param ptr The object.
+ * \param release Function freeing the object.
+ * \param arg Extra argument of release.
+ * \param epoch Global epoch at the time the object was retired.
+ * \param next Next (older) retired object.
+ */
+typedef struct EpochRetired {
+    void* ptr;
+    void (*release)(void* ptr, void* arg);
+    void* arg;
+    uint64_t epoch;
+    struct EpochRetired* next;
+} epoch_retired_t;
+
+/** Structure for a reclamation domain.
+ *
+ * \param readers The reader slots.
+ * \param global The current global epoch (starts at 1).
+ * \param retired Objects waiting to be freed, newest first.
+ * \param pending Number of objects in retired.
+ */
+struct Epoch {
+    struct EpochReader readers[EPOCH_MAX_READERS];
+    uint64_t global;
+    epoch_retired_t* retired;
+    int pending;
+};
+
+epoch_t* epoch_create(void) {
+    epoch_t* epoch = (epoch_t*)aligned_alloc(64, sizeof(epoch_t));
+    if (!epoch) {
+        return NULL; // Memory allocation failed
+    }
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        epoch->readers[i].epoch = EPOCH_QUIESCENT;
+        epoch->readers[i].global = &epoch->global;
+        epoch->readers[i].in_use = 0;
+    }
+    epoch->global = 1;
+    epoch->retired = NULL;
+    epoch->pending = 0;
+    return epoch;
+}
+
+epoch_reader_t* epoch_register(epoch_t* epoch) {
+    if (!epoch) {
+        return NULL;
+    }
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&epoch->readers[i].in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return &epoch->readers[i];
+        }
+    }
+    return NULL; // Every slot is taken
+}
+
+void epoch_unregister(epoch_reader_t* reader) {
+    if (!reader) {
+        return;
+    }
+    __atomic_store_n(&reader->epoch, EPOCH_QUIESCENT, __ATOMIC_RELEASE);
+    __atomic_store_n(&reader->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_enter(epoch_reader_t* reader) {
+    // Announce the current epoch; the full fence orders the announcement
+    // before every shared pointer the reader loads afterwards
+    uint64_t global = __atomic_load_n(reader->global, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&reader->epoch, global, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_reader_t* reader) {
+    // Everything read in the critical section happens before the release
+    __atomic_store_n(&reader->epoch, EPOCH_QUIESCENT, __ATOMIC_RELEASE);
+}
+
+int epoch_retire(epoch_t* epoch, void* ptr, void (*release)(void* ptr, void* arg), void* arg) {
+    if (!epoch || !ptr || !release) {
+        return 0; // Invalid parameters
+    }
+    epoch_retired_t* retired = (epoch_retired_t*)malloc(sizeof(epoch_retired_t));
+    if (!retired) {
+        return 0; // Memory allocation failed
+    }
+    retired->ptr = ptr;
+    retired->release = release;
+    retired->arg = arg;
+    retired->epoch = __atomic_load_n(&epoch->global, __ATOMIC_RELAXED);
+    retired->next = epoch->retired;
+    epoch->retired = retired;
+    epoch->pending++;
+    return 1;
+}
+
+int epoch_reclaim(epoch_t* epoch) {
+    if (!epoch || !epoch->retired) {
+        return 0; // Nothing to free
+    }
+
+    // Order the unlinking of the retired objects before reading the slots
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // The oldest epoch any reader may still be working in
+    uint64_t global = __atomic_load_n(&epoch->global, __ATOMIC_RELAXED);
+    uint64_t oldest = global;
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        uint64_t announced = __atomic_load_n(&epoch->readers[i].epoch, __ATOMIC_ACQUIRE);
+        if (announced != EPOCH_QUIESCENT && announced < oldest) {
+            oldest = announced;
+        }
+    }
+
+    // Objects retired before that epoch are unreachable for every reader
+    int freed = 0;
+    epoch_retired_t** link = &epoch->retired;
+    while (*link) {
+        epoch_retired_t* retired = *link;
+        if (retired->epoch < oldest) {
+            *link = retired->next;
+            retired->release(retired->ptr, retired->arg);
+            free(retired);
+            freed++;
+        }
+        else {
+            link = &retired->next;
+        }
+    }
+    epoch->pending -= freed;
+
+    // Start a new epoch so that the objects retired so far can go next time
+    __atomic_store_n(&epoch->global, global + 1, __ATOMIC_RELEASE);
+    return freed;
+}
+
+int epoch_pending(const epoch_t* epoch) {
+    return epoch ? epoch->pending : 0;
+}
+
+void epoch_destroy(epoch_t* epoch) {
+    if (!epoch) {
+        return;
+    }
+    epoch_retired_t* retired = epoch->retired;
+    while (retired) {
+        epoch_retired_t* next = retired->next;
+        retired->release(retired->ptr, retired->arg);
+        free(retired);
+        retired = next;
+    }
+    free(epoch);
+}
@@ -0,0 +1,101 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure for epoch-based memory reclamation.
+ *
+ * Readers bracket every access to shared data with epoch_enter() and
+ * epoch_exit(); they never block and never write shared state other than
+ * their own slot. A writer that unlinks an object hands it to epoch_retire()
+ * instead of freeing it. epoch_reclaim() frees the retired objects once no
+ * reader that could still hold a reference to them remains inside its
+ * critical section, then advances the global epoch.
+ *
+ * Retiring and reclaiming must be serialized by the caller (e.g. done under
+ * the writer lock); entering and exiting may happen from any number of
+ * registered reader threads.
+ */
+typedef struct Epoch epoch_t;
+
+/** Opaque structure for the slot of one reader thread. */
+typedef struct EpochReader epoch_reader_t;
+
+#define EPOCH_MAX_READERS 128   // Reader slots per epoch_t
+
+/** Creates a new reclamation domain.
+ *
+ * \returns A pointer to the new domain, or NULL on failure.
+ */
+epoch_t* epoch_create(void);
+
+/** Claims a reader slot for the calling thread.
+ *
+ * \param epoch Pointer to the domain.
+ * \returns The reader slot, or NULL if all EPOCH_MAX_READERS slots are in use.
+ */
+epoch_reader_t* epoch_register(epoch_t* epoch);
+
+/** Gives a reader slot back. The reader must not be inside a critical section.
+ *
+ * \param reader The reader slot (NULL is ignored).
+ */
+void epoch_unregister(epoch_reader_t* reader);
+
+/** Starts a read-side critical section.
+ *
+ * Objects reachable from shared pointers loaded after this call stay valid
+ * until the matching epoch_exit().
+ *
+ * \param reader The reader slot of the calling thread.
+ */
+void epoch_enter(epoch_reader_t* reader);
+
+/** Ends a read-side critical section.
+ *
+ * \param reader The reader slot of the calling thread.
+ */
+void epoch_exit(epoch_reader_t* reader);
+
+/** Defers the release of an object that readers may still be using.
+ *
+ * \param epoch Pointer to the domain.
+ * \param ptr The object, already unreachable for new readers.
+ * \param release Function freeing the object; receives ptr and arg.
+ * \param arg Extra argument passed to release.
+ * \returns 1 on success, 0 if the retire record could not be allocated (the
+ *          object is then leaked rather than freed under a reader).
+ */
+int epoch_retire(epoch_t* epoch, void* ptr, void (*release)(void* ptr, void* arg), void* arg);
+
+/** Frees every retired object that no reader can reference any more.
+ *
+ * \param epoch Pointer to the domain.
+ * \returns The number of objects freed.
+ */
+int epoch_reclaim(epoch_t* epoch);
+
+/** Returns the number of retired objects not freed yet.
+ *
+ * \param epoch Pointer to the domain.
+ * \returns The number of pending objects.
+ */
+int epoch_pending(const epoch_t* epoch);
+
+/** Frees every retired object, then the domain itself.
+ *
+ * No reader may be inside a critical section.
+ *
+ * \param epoch Pointer to the domain (NULL is ignored).
+ */
+void epoch_destroy(epoch_t* epoch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EPOCH_H
@@ -0,0 +1,192 @@
+#ifndef FLOW_KEY_H
+#define FLOW_KEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLOW_KEY4_WIDTH 16   // Bytes of an IPv4 flow key: 13 bytes of fields, 3 of padding
+#define FLOW_KEY6_WIDTH 40   // Bytes of an IPv6 flow key: 37 bytes of fields, 3 of padding
+
+/** IPv4 5-tuple, used as a fixed-width binary key.
+ *
+ * The fields are laid out without compiler padding and the explicit padding
+ * is always zero, so two keys are equal exactly when their bytes are.
+ * Addresses and ports are stored as given (usually in network byte order).
+ * Build keys with flow_key4_init() so that the padding is cleared.
+ *
+ * \param src_addr Source address.
+ * \param dst_addr Destination address.
+ * \param src_port Source port.
+ * \param dst_port Destination port.
+ * \param protocol IP protocol number (e.g. 6 for TCP, 17 for UDP).
+ * \param pad Padding up to FLOW_KEY4_WIDTH bytes, always zero.
+ */
+typedef struct FlowKey4 {
+    uint32_t src_addr;
+    uint32_t dst_addr;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t protocol;
+    uint8_t pad[3];
+} flow_key4_t;
+
+/** IPv6 5-tuple, used as a fixed-width binary key.
+ *
+ * Same rules as flow_key4_t; build keys with flow_key6_init().
+ *
+ * \param src_addr Source address.
+ * \param dst_addr Destination address.
+ * \param src_port Source port.
+ * \param dst_port Destination port.
+ * \param protocol IP protocol number (next header).
+ * \param pad Padding up to FLOW_KEY6_WIDTH bytes, always zero.
+ */
+typedef struct FlowKey6 {
+    uint8_t src_addr[16];
+    uint8_t dst_addr[16];
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t protocol;
+    uint8_t pad[3];
+} flow_key6_t;
+
+#ifndef __cplusplus
+_Static_assert(sizeof(flow_key4_t) == FLOW_KEY4_WIDTH, "flow_key4_t must not be padded");
+_Static_assert(sizeof(flow_key6_t) == FLOW_KEY6_WIDTH, "flow_key6_t must not be padded");
+#endif
+
+/** Fills an IPv4 flow key, clearing its padding.
+ *
+ * \param key Pointer to the key to fill.
+ * \param src_addr Source address.
+ * \param dst_addr Destination address.
+ * \param src_port Source port.
+ * \param dst_port Destination port.
+ * \param protocol IP protocol number.
+ */
+static inline void flow_key4_init(flow_key4_t* key, uint32_t src_addr, uint32_t dst_addr,
+                                  uint16_t src_port, uint16_t dst_port, uint8_t protocol) {
+    memset(key, 0, sizeof(*key));
+    key->src_addr = src_addr;
+    key->dst_addr = dst_addr;
+    key->src_port = src_port;
+    key->dst_port = dst_port;
+    key->protocol = protocol;
+}
+
+/** Fills an IPv6 flow key, clearing its padding.
+ *
+ * \param key Pointer to the key to fill.
+ * \param src_addr The 16 bytes of the source address.
+ * \param dst_addr The 16 bytes of the destination address.
+ * \param src_port Source port.
+ * \param dst_port Destination port.
+ * \param protocol IP protocol number.
+ */
+static inline void flow_key6_init(flow_key6_t* key, const uint8_t* src_addr, const uint8_t* dst_addr,
+                                  uint16_t src_port, uint16_t dst_port, uint8_t protocol) {
+    memset(key, 0, sizeof(*key));
+    memcpy(key->src_addr, src_addr, sizeof(key->src_addr));
+    memcpy(key->dst_addr, dst_addr, sizeof(key->dst_addr));
+    key->src_port = src_port;
+    key->dst_port = dst_port;
+    key->protocol = protocol;
+}
+
+/** Compares two keys whose width is a multiple of 8 bytes, a word at a time.
+ *
+ * With a constant width this compiles to straight-line loads and xors: two
+ * word compares for an IPv4 flow key, five for an IPv6 one, and no call.
+ *
+ * \param a Pointer to the first key.
+ * \param b Pointer to the second key.
+ * \param width Number of bytes in each key (a multiple of 8).
+ * \returns 1 if the keys are equal, 0 otherwise.
+ */
+static inline int flow_key_equal(const void* a, const void* b, size_t width) {
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    uint64_t diff = 0;
+    for (size_t i = 0; i < width; i += 8) {
+        diff |= hash_read64(x + i) ^ hash_read64(y + i);
+    }
+    return diff == 0;
+}
+
+/** Final multiply of hash_bytes_seeded(), shared by the flow key kernels.
+ *
+ * \param a First word of the last 16 bytes.
+ * \param b Second word of the last 16 bytes.
+ * \param seed The mixed seed.
+ * \param width Number of bytes in the key.
+ * \returns The hash value.
+ */
+static inline uint64_t flow_key_hash_final(uint64_t a, uint64_t b, uint64_t seed, size_t width) {
+    __uint128_t product = (__uint128_t)(a ^ HASH_SECRET1) * (b ^ seed);
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+    return hash_mix(a ^ HASH_SECRET0 ^ width, b ^ HASH_SECRET1);
+}
+
+/** Hashes an IPv4 flow key; hash_bytes_seeded() unrolled for 16 bytes.
+ *
+ * \param key Pointer to FLOW_KEY4_WIDTH key bytes.
+ * \param seed Seed selecting one function of the family.
+ * \returns The computed hash value.
+ */
+static inline uint64_t flow_key4_hash(const void* key, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)key;
+    seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+    uint64_t a = (hash_read32(bytes) << 32) | hash_read32(bytes + 8);
+    uint64_t b = (hash_read32(bytes + 12) << 32) | hash_read32(bytes + 4);
+    return flow_key_hash_final(a, b, seed, FLOW_KEY4_WIDTH);
+}
+
+/** Hashes an IPv6 flow key; hash_bytes_seeded() unrolled for 40 bytes.
+ *
+ * \param key Pointer to FLOW_KEY6_WIDTH key bytes.
+ * \param seed Seed selecting one function of the family.
+ * \returns The computed hash value.
+ */
+static inline uint64_t flow_key6_hash(const void* key, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)key;
+    seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+    seed = hash_mix(hash_read64(bytes) ^ HASH_SECRET1, hash_read64(bytes + 8) ^ seed);
+    uint64_t middle = hash_read64(bytes + 24); // Also the start of the last 16 bytes
+    seed = hash_mix(hash_read64(bytes + 16) ^ HASH_SECRET1, middle ^ seed);
+    return flow_key_hash_final(middle, hash_read64(bytes + 32), seed, FLOW_KEY6_WIDTH);
+}
+
+/** Hashes a fixed-width key with a seed.
+ *
+ * Returns the same value as hash_bytes_seeded(). The flow key widths use
+ * straight-line kernels with a fixed set of loads and no length branches,
+ * loop or tail handling; other widths fall back to hash_bytes_seeded().
+ *
+ * \param key Pointer to the key bytes.
+ * \param width Number of bytes in the key.
+ * \param seed Seed selecting one function of the family.
+ * \returns The computed hash value.
+ */
+static inline uint64_t flow_key_hash(const void* key, size_t width, uint64_t seed) {
+    switch (width) {
+    case FLOW_KEY4_WIDTH:
+        return flow_key4_hash(key, seed);
+    case FLOW_KEY6_WIDTH:
+        return flow_key6_hash(key, seed);
+    default:
+        return hash_bytes_seeded(key, width, seed);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLOW_KEY_H
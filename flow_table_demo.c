@@ -3,29 +3,67 @@
 #include <string.h>
 #include <time.h>
 #include "DPHT.h"
+#include "flow_key.h"
 
 /**
  * Simulating a network device's flow table using a DPHT.
  *
  * In network processing, a flow is a group of packets that share common header fields.
  * The flow table stores a flow entry for each flow, where:
- *    - The flow identifier (key) (e.g., "flow_1234") is derived from the packet headers.
- *    - The value (e.g., "next_hop_1234") contains metadata such as the processing
- *      action or next-hop information.
+ *    - The flow identifier (key) is the IPv4 5-tuple of the packet headers
+ *      (source and destination address and port, protocol), stored as a
+ *      fixed-width flow_key4_t.
+ *    - The value (a flow_action_t) contains metadata such as the next hop and
+ *      the number of packets matched.
  *
  * The flow table (implemented via a Dynamic Perfect Hash Table) does not store the actual packets;
  * it stores only the metadata required to quickly decide how to process each arriving packet.
+ * The table is created with a fixed key width, so keys are hashed and compared
+ * as 16-byte words: no key is ever formatted into a string.
  *
  * This program performs the following:
- *   1. Creates a DPHT to simulate a flow table.
+ *   1. Creates a DPHT with FLOW_KEY4_WIDTH keys to simulate a flow table.
  *   2. Inserts 10000 flow entries (each representing a flow) into the DPHT.
- *   3. Looks up flows to simulate the per-packet matching process.
- *   4. Updates certain flow entries to reflect dynamic network changes.
- *   5. Deletes selected flow entries, simulating flow expiry or re-routing.
- *   6. Prints timing and status information.
+ *   3. Matches packets against the flows, one packet at a time and then in
+ *      bursts as delivered by a NIC receive queue, and reports packets per second.
+ *   4. Learns new flows from packets with a single probe per packet.
+ *   5. Updates certain flow entries to reflect dynamic network changes.
+ *   6. Deletes selected flow entries, simulating flow expiry or re-routing.
+ *   7. Prints timing and status information.
  *
  * \returns 0 on successful execution.
  */
+#define BURST_SIZE 32       // Packets handed over by each receive-queue poll
+#define NUM_PACKETS 1000000 // Packets matched by each lookup mode
+#define PROTO_TCP 6
+#define PROTO_UDP 17
+
+/** Per-flow metadata stored as the value of each flow entry. */
+typedef struct FlowAction {
+    uint32_t next_hop;  // Index of the next hop the flow is forwarded to
+    uint32_t packets;   // Packets matched by the flow
+} flow_action_t;
+
+/* Helper function: Builds the 5-tuple of flow number id */
+static void make_flow(flow_key4_t* key, int id) {
+    flow_key4_init(key, 0x0a000000u + (uint32_t)id,             // 10.0.0.0/8 clients
+                   0xc0a80001u + (uint32_t)(id % 256) * 256,    // 192.168.x.1 servers
+                   (uint16_t)(1024 + id % 60000),
+                   (id % 4) ? 443 : 53,
+                   (id % 4) ? PROTO_TCP : PROTO_UDP);
+}
+
+/* Helper function: Returns the flow of packet number p, spread over all flows */
+static int packet_flow(long p, int flows) {
+    return (int)((p * 7919) % flows);
+}
+
+/* Helper function: Prints a packet rate from a CPU time */
+static void print_rate(const char* what, long packets, double seconds) {
+    printf("%s %ld packets in %f seconds (%.2f Mpps).\n", what, packets, seconds,
+           seconds > 0.0 ? packets / seconds / 1e6 : 0.0);
+}
+
 int main(void) {
     const int NUM_FLOW_ENTRIES = 10000;  // Number of distinct flow entries to simulate
     clock_t start, end; // CPU use time tracking
@@ -33,7 +71,11 @@ int main(void) {
 
     // 1. Create a DPHT to simulate the flow table.
     // The DPHT will hold flow entries (not the packet data) for fast lookup.
-    DPHT* flowTable = dpht_create(256);
+    dpht_config_t config;
+    dpht_config_init(&config);
+    config.initial_tables = 256;
+    config.key_width = FLOW_KEY4_WIDTH;
+    DPHT* flowTable = dpht_create_with_config(&config);
     if (!flowTable) {
         fprintf(stderr, "Error: Could not create the DPHT for flow entries\n");
         return EXIT_FAILURE;
@@ -41,85 +83,127 @@ int main(void) {
     printf("Flow Table (DPHT) created with initial capacity: %d buckets\n", flowTable->capacity);
 
     // 2. Insert flow entries into the flow table.
-    // In practice, a flow key is built from packet header fields,
-    // but here we simulate by using "flow_<id>" and assign a next hop value "next_hop_<id>".
+    // Each flow is keyed by its 5-tuple and forwarded to one of 64 next hops.
     start = clock();
     for (int i = 0; i < NUM_FLOW_ENTRIES; i++) {
-        char flowKey[64];
-        char nextHop[64];
-
-        // The flow key uniquely identifies the flow (group of packets).
-        snprintf(flowKey, sizeof(flowKey), "flow_%d", i);
-        // The flow value contains metadata (such as next-hop or action), not the packet itself.
-        snprintf(nextHop, sizeof(nextHop), "next_hop_%d", i);
+        flow_key4_t flowKey;
+        make_flow(&flowKey, i);
+        flow_action_t action = { (uint32_t)(i % 64), 0 };
 
         // Insert the flow entry into the DPHT (flow table)
-        if (!dpht_insert(flowTable, flowKey, nextHop)) {
-            fprintf(stderr, "Insertion error for flow key: %s\n", flowKey);
+        if (!dpht_insert_n(flowTable, &flowKey, sizeof(flowKey), &action, sizeof(action))) {
+            fprintf(stderr, "Insertion error for flow %d\n", i);
         }
     }
     end = clock();
     cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
     printf("Inserted %d flow entries in %f seconds.\n", NUM_FLOW_ENTRIES, cpu_time_used);
 
-    // 3. Lookup flows to simulate matching an incoming packet's header.
-    // For each incoming packet, the device extracts its flow key,
+    // 3. Match packets against the flow table.
+    // For each incoming packet, the device extracts its 5-tuple,
     // then looks it up in the DPHT to decide what action to take.
     start = clock();
-    int lookupSuccess = 0;
-    for (int i = 0; i < NUM_FLOW_ENTRIES; i++) {
-        char flowKey[64];
-        snprintf(flowKey, sizeof(flowKey), "flow_%d", i);
+    long matched = 0;
+    for (long p = 0; p < NUM_PACKETS; p++) {
+        flow_key4_t flowKey;
+        make_flow(&flowKey, packet_flow(p, NUM_FLOW_ENTRIES));
 
-        // Retrieve the next-hop (or action) associated with the flow.
-        char* action = dpht_search(flowTable, flowKey);
+        // Retrieve the next hop (or action) associated with the flow.
+        flow_action_t* action = dpht_search_n(flowTable, &flowKey, sizeof(flowKey), NULL);
         if (action) {
-            lookupSuccess++;
+            action->packets++;
+            matched++;
+        }
+    }
+    end = clock();
+    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
+    print_rate("Matched", matched, cpu_time_used);
+    if (matched != NUM_PACKETS) {
+        fprintf(stderr, "Lookup failed for %ld packets\n", NUM_PACKETS - matched);
+    }
+
+    // Burst mode: packets arrive in bursts, so the whole burst is matched at once
+    // and the memory accesses of its lookups overlap.
+    start = clock();
+    matched = 0;
+    flow_key4_t burst[BURST_SIZE];
+    void* actions[BURST_SIZE];
+    for (long p = 0; p < NUM_PACKETS; p += BURST_SIZE) {
+        int count = (NUM_PACKETS - p < BURST_SIZE) ? (int)(NUM_PACKETS - p) : BURST_SIZE;
+        for (int j = 0; j < count; j++) {
+            make_flow(&burst[j], packet_flow(p + j, NUM_FLOW_ENTRIES));
+        }
+        matched += (long)dpht_search_batch_n(flowTable, burst, count, actions);
+        for (int j = 0; j < count; j++) {
+            if (actions[j]) {
+                ((flow_action_t*)actions[j])->packets++;
+            }
         }
-        else {
-            fprintf(stderr, "Lookup failed for flow key: %s\n", flowKey);
+    }
+    end = clock();
+    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
+    char what[64];
+    snprintf(what, sizeof(what), "Matched (bursts of %d)", BURST_SIZE);
+    print_rate(what, matched, cpu_time_used);
+
+    // 4. Learn flows: packets of unknown flows create their entry on the fly.
+    // One probe per packet finds the flow or inserts it.
+    start = clock();
+    int learned = 0;
+    for (long p = 0; p < NUM_PACKETS; p++) {
+        flow_key4_t flowKey;
+        int id = packet_flow(p, 2 * NUM_FLOW_ENTRIES); // Half of these flows are new
+        make_flow(&flowKey, id);
+        flow_action_t fresh = { (uint32_t)(id % 64), 0 };
+
+        int inserted = 0;
+        pair_t* entry = dpht_get_or_insert_n(flowTable, &flowKey, sizeof(flowKey),
+                                             &fresh, sizeof(fresh), &inserted);
+        if (entry) {
+            ((flow_action_t*)entry->value)->packets++;
+            learned += inserted;
         }
     }
     end = clock();
     cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf("Looked up %d flows in %f seconds.\n", lookupSuccess, cpu_time_used);
+    print_rate("Classified", NUM_PACKETS, cpu_time_used);
+    printf("Learned %d new flows.\n", learned);
 
-    // 4. Update selected flow entries to simulate routing or policy changes.
+    // 5. Update selected flow entries to simulate routing or policy changes.
     // For instance, when a route changes, a flow's next hop might be updated.
     start = clock();
     for (int i = 0; i < NUM_FLOW_ENTRIES; i += 2) { // Update every other flow entry
-        char flowKey[64], newNextHop[64];
-        snprintf(flowKey, sizeof(flowKey), "flow_%d", i);
-        snprintf(newNextHop, sizeof(newNextHop), "next_hop_%d_updated", i);
+        flow_key4_t flowKey;
+        make_flow(&flowKey, i);
+        flow_action_t rerouted = { (uint32_t)(i % 64 + 64), 0 };
 
-        if (!dpht_update(flowTable, flowKey, newNextHop)) {
-            fprintf(stderr, "Update failed for flow key: %s\n", flowKey);
+        if (!dpht_update_n(flowTable, &flowKey, sizeof(flowKey), &rerouted, sizeof(rerouted))) {
+            fprintf(stderr, "Update failed for flow %d\n", i);
         }
     }
     end = clock();
     cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
     printf("Updated %d flow entries in %f seconds.\n", NUM_FLOW_ENTRIES / 2, cpu_time_used);
 
-    // 5. Delete selected flow entries to simulate flow expiry.
+    // 6. Delete selected flow entries to simulate flow expiry.
     // For example, remove flows that are no longer active or have been replaced.
     start = clock();
     int deleteCount = 0;
     for (int i = 0; i < NUM_FLOW_ENTRIES; i++) {
         if (i % 3 == 0) { // Delete flows with indices that are multiples of 3
-            char flowKey[64];
-            snprintf(flowKey, sizeof(flowKey), "flow_%d", i);
-            dpht_remove_entry(flowTable, flowKey);
-            deleteCount++;
+            flow_key4_t flowKey;
+            make_flow(&flowKey, i);
+            deleteCount += dpht_remove_n(flowTable, &flowKey, sizeof(flowKey));
         }
     }
     end = clock();
     cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
     printf("Deleted %d flow entries in %f seconds.\n", deleteCount, cpu_time_used);
 
-    // 6. Final status: Output the final number of flow entries stored in the table.
+    // 7. Final status: Output the final number of flow entries stored in the table.
     printf("Final number of flow entries in the table: %d\n", flowTable->size);
 
-    // 7. Cleanup: Free all allocated memory by deleting the flow table.
+    // 8. Cleanup: Free all allocated memory by deleting the flow table.
     dpht_free(flowTable);
     printf("Flow table deleted. All resources have been freed.\n");
 
@@ -0,0 +1,167 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Signature of a seeded first-level hash function.
+ *
+ * The full 64-bit value is stored in every pair, so every bit of it is used:
+ * the low bits select the bucket, the high bits give the 8-bit fingerprint,
+ * and the whole value rejects most mismatches without reading key bytes.
+ *
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param seed Seed selecting one function of the family.
+ * \returns The hash value.
+ */
+typedef uint64_t (*hash_fn)(const void* key, size_t len, uint64_t seed);
+
+#define HASH_SECRET0 0xa0761d6478bd642fULL
+#define HASH_SECRET1 0xe7037ed1a0b428dbULL
+#define HASH_SECRET2 0x8ebc6af09c88c6e3ULL
+#define HASH_SECRET3 0x589965cc75374cc3ULL
+
+/** Multiplies two 64-bit words and folds the 128-bit product.
+ *
+ * \param a First factor.
+ * \param b Second factor.
+ * \returns The low half of the product xor its high half.
+ */
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/** Reads 8 unaligned bytes in machine byte order. */
+static inline uint64_t hash_read64(const unsigned char* bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+/** Reads 4 unaligned bytes in machine byte order. */
+static inline uint64_t hash_read32(const unsigned char* bytes) {
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+/** Hashes a byte string of known length with a seed.
+ *
+ * This is the default first-level hash: a wyhash-style function that reads
+ * the key a word at a time and mixes with 64x64->128-bit multiplies. Keys of
+ * up to 16 bytes (typical IDs and flow keys) cost two multiplies, and keys
+ * that differ only in their last characters, such as sequential IDs, still
+ * spread over all bits. Keys may contain zero bytes.
+ *
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param seed Seed selecting one function of the family.
+ * \returns The computed hash value.
+ */
+static inline uint64_t hash_bytes_seeded(const void* key, size_t len, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)key;
+    uint64_t a = 0, b = 0;
+    seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two possibly overlapping 4-byte reads from each end
+            size_t middle = (len >> 3) << 2;
+            a = (hash_read32(bytes) << 32) | hash_read32(bytes + middle);
+            b = (hash_read32(bytes + len - 4) << 32) | hash_read32(bytes + len - 4 - middle);
+        }
+        else if (len > 0) {
+            a = ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[len >> 1] << 8) | bytes[len - 1];
+        }
+    }
+    else {
+        size_t remaining = len;
+        if (remaining > 48) {
+            // Three independent lanes of 16 bytes each
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = hash_mix(hash_read64(bytes) ^ HASH_SECRET1, hash_read64(bytes + 8) ^ seed);
+                lane1 = hash_mix(hash_read64(bytes + 16) ^ HASH_SECRET2, hash_read64(bytes + 24) ^ lane1);
+                lane2 = hash_mix(hash_read64(bytes + 32) ^ HASH_SECRET3, hash_read64(bytes + 40) ^ lane2);
+                bytes += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (remaining > 16) {
+            seed = hash_mix(hash_read64(bytes) ^ HASH_SECRET1, hash_read64(bytes + 8) ^ seed);
+            bytes += 16;
+            remaining -= 16;
+        }
+        // The last 16 bytes, overlapping what was already mixed if needed
+        a = hash_read64(bytes + remaining - 16);
+        b = hash_read64(bytes + remaining - 8);
+    }
+    __uint128_t product = (__uint128_t)(a ^ HASH_SECRET1) * (b ^ seed);
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+    return hash_mix(a ^ HASH_SECRET0 ^ len, b ^ HASH_SECRET1);
+}
+
+/** Hashes a byte string of known length with the fixed seed 0.
+ *
+ * The string functions of the PHT (and pair_create()) use this hash.
+ *
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \returns The computed hash value.
+ */
+static inline uint64_t hash_bytes(const void* key, size_t len) {
+    return hash_bytes_seeded(key, len, 0);
+}
+
+/** Hashes a byte string with the djb2 algorithm, one byte at a time.
+ *
+ * The former default hash, kept as an alternative hash_fn for comparisons.
+ * It is much slower on long keys and clusters on sequential keys.
+ *
+ * \param key Pointer to the key bytes.
+ * \param len Number of bytes in the key.
+ * \param seed Added to the djb2 starting value.
+ * \returns The computed hash value.
+ */
+static inline uint64_t hash_djb2(const void* key, size_t len, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)key;
+    uint64_t hash = 5381 + seed;
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + bytes[i];  // hash * 33 + c
+    }
+    return hash;
+}
+
+/** Draws a random nonzero seed for a new table.
+ *
+ * Uses the kernel's random source, falling back to the clock and the address
+ * of a local variable if it is not available.
+ *
+ * \returns The seed.
+ */
+static inline uint64_t hash_random_seed(void) {
+    uint64_t seed = 0;
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != (ssize_t)sizeof(seed)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        seed = hash_mix((uint64_t)now.tv_sec ^ HASH_SECRET2,
+                        (uint64_t)now.tv_nsec ^ (uint64_t)(uintptr_t)&now);
+    }
+    return seed ? seed : HASH_SECRET3;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HASH_H
@@ -1,39 +1,117 @@
 #include "pair.h"
+#include "hash.h"
 #include <stdlib.h>
 #include <string.h>
 
 pair_t* pair_create(const char* key, const char* value) {
+    return pair_create_in(NULL, key, value);
+}
+
+int pair_update_value(pair_t* pair, const char* new_value) {
+    return pair_update_value_in(NULL, pair, new_value);
+}
+
+void pair_free(pair_t* pair) {
+    pair_free_in(NULL, pair);
+}
+
+pair_t* pair_create_in(arena_t* arena, const char* key, const char* value) {
     if (!key || !value) {
         return NULL; // Invalid input
     }
+    size_t key_len = strlen(key);
+    return pair_create_n(arena, key, key_len, value, strlen(value), hash_bytes(key, key_len));
+}
 
-    pair_t* new_pair = (pair_t*)malloc(sizeof(pair_t));
-    if (!new_pair) {
-        return NULL;    // Memory allocation failed
+pair_t* pair_create_n(arena_t* arena, const void* key, size_t key_len,
+                      const void* value, size_t value_len, uint64_t hash) {
+    if (!key || !value) {
+        return NULL; // Invalid input
     }
 
-    new_pair->key = strdup(key);
-    new_pair->value = strdup(value);
+    // The structure and the key share one block, the value has its own
+    pair_t* new_pair;
+    if (!arena) {
+        new_pair = (pair_t*)malloc(sizeof(pair_t) + key_len + 1);
+        if (!new_pair) {
+            return NULL;    // Memory allocation failed
+        }
+        new_pair->value = (char*)malloc(value_len + 1);
+        if (!new_pair->value) {
+            free(new_pair);
+            return NULL;    // Memory allocation failed
+        }
+    }
+    else {
+        new_pair = (pair_t*)arena_alloc(arena, sizeof(pair_t) + key_len + 1);
+        if (!new_pair) {
+            return NULL;    // Memory allocation failed
+        }
+        new_pair->value = (char*)arena_alloc(arena, value_len + 1);
+        if (!new_pair->value) {
+            arena_free(arena, new_pair, sizeof(pair_t) + key_len + 1);
+            return NULL;    // Memory allocation failed
+        }
+    }
+    new_pair->key = (char*)(new_pair + 1);
 
+    // Copy the bytes and keep them NUL-terminated for the string API
+    memcpy(new_pair->key, key, key_len);
+    new_pair->key[key_len] = '\0';
+    memcpy(new_pair->value, value, value_len);
+    new_pair->value[value_len] = '\0';
+    new_pair->key_len = key_len;
+    new_pair->value_len = value_len;
+    new_pair->hash = hash;
     return new_pair;
 }
 
-int pair_update_value(pair_t* pair, const char* new_value) {
+int pair_update_value_in(arena_t* arena, pair_t* pair, const char* new_value) {
     if (!pair || !new_value) {
         return 0;   // Invalid input
     }
+    return pair_update_value_n(arena, pair, new_value, strlen(new_value));
+}
 
-    char* temp = strdup(new_value);
+int pair_update_value_n(arena_t* arena, pair_t* pair, const void* new_value, size_t value_len) {
+    if (!pair || !new_value) {
+        return 0;   // Invalid input
+    }
 
-    free(pair->value);
-    pair->value = temp;
+    // Reuse the current block in place if the new value fits it: an arena
+    // block of the same size class, or a malloc block of the same length
+    if (arena ? arena_same_class(pair->value_len + 1, value_len + 1) : value_len == pair->value_len) {
+        memmove(pair->value, new_value, value_len);
+        pair->value[value_len] = '\0';
+        pair->value_len = value_len;
+        return 1;
+    }
+
+    char* temp = arena ? (char*)arena_alloc(arena, value_len + 1) : (char*)malloc(value_len + 1);
+    if (!temp) {
+        return 0;   // Memory allocation failed
+    }
+    memcpy(temp, new_value, value_len);
+    temp[value_len] = '\0';
 
+    if (arena) {
+        arena_free(arena, pair->value, pair->value_len + 1);
+    }
+    else {
+        free(pair->value);
+    }
+    pair->value = temp;
+    pair->value_len = value_len;
     return 1;
 }
 
-void pair_free(pair_t* pair) {
+void pair_free_in(arena_t* arena, pair_t* pair) {
     if (!pair) return;
-    free(pair->key);
-    free(pair->value);
-    free(pair);
-}
\ No newline at end of file
+    if (!arena) {
+        free(pair->value);
+        free(pair);
+        return;
+    }
+    arena_free(arena, pair->value, pair->value_len + 1);
+    arena_free(arena, pair, sizeof(pair_t) + pair->key_len + 1);
+}
@@ -1,13 +1,31 @@
 #ifndef PAIR_H
 #define PAIR_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+#include "flow_key.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /** Structure representing key-value pair.
  *
- * Both key and value are dynamically allocated strings.
+ * Both key and value are dynamically allocated byte strings of known length.
+ * A NUL byte is always stored after each of them, so keys and values inserted
+ * through the string API can still be used as C strings. The key never
+ * changes, so it is stored inline, in the same block as the structure: once
+ * the hash matches, comparing the key reads the pair's own cache line
+ * instead of following a pointer to another allocation.
  */
 typedef struct pair {
-    char* key;    // Pointer to the key string
-    char* value;  // Pointer to the associated value string
+    char* key;    // Pointer to the key bytes
+    char* value;  // Pointer to the associated value bytes
+    size_t key_len;     // Length of the key in bytes
+    size_t value_len;   // Length of the value in bytes
+    uint64_t hash;      // Full hash of the key, as computed by the owning table
 } pair_t;
 
 /** Creates a new pair_t structure and initializes it with the given key and value.
@@ -32,4 +50,91 @@ int pair_update_value(pair_t* pair, const char* new_value);
  */
 void pair_free(pair_t* pair);
 
+/** Creates a new pair_t structure, allocating it from an arena.
+ *
+ * The structure and the key share one arena block; the value gets its own
+ * block so that it can be replaced independently.
+ *
+ * \param arena Pointer to the arena, or NULL to use malloc (same as pair_create()).
+ * \param key Pointer to the key string.
+ * \param value Pointer to the associated value string.
+ * \returns A pointer to the newly created pair_t structure, or NULL on failure.
+ */
+pair_t* pair_create_in(arena_t* arena, const char* key, const char* value);
+
+/** Creates a new pair_t structure from binary key and value bytes.
+ *
+ * \param arena Pointer to the arena, or NULL to use malloc.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the value bytes.
+ * \param value_len Number of bytes in the value.
+ * \param hash Full hash of the key, stored in the pair.
+ * \returns A pointer to the newly created pair_t structure, or NULL on failure.
+ */
+pair_t* pair_create_n(arena_t* arena, const void* key, size_t key_len,
+                      const void* value, size_t value_len, uint64_t hash);
+
+/** Updates the value in a key-value pair allocated from an arena.
+ *
+ * If the new value fits the size class of the old one, it is copied in place
+ * without any allocation.
+ *
+ * \param arena Pointer to the arena the pair was created in, or NULL.
+ * \param pair Pointer to the pair_t structure to be updated.
+ * \param new_value Pointer to the new value string.
+ * \returns 1 on success, 0 on failure.
+ */
+int pair_update_value_in(arena_t* arena, pair_t* pair, const char* new_value);
+
+/** Updates the value in a key-value pair with binary bytes.
+ *
+ * A value of the same length (or, in an arena, of the same size class) is
+ * copied over the old one in place, so pointers to the value stay valid.
+ *
+ * \param arena Pointer to the arena the pair was created in, or NULL.
+ * \param pair Pointer to the pair_t structure to be updated.
+ * \param new_value Pointer to the new value bytes.
+ * \param value_len Number of bytes in the new value.
+ * \returns 1 on success, 0 on failure.
+ */
+int pair_update_value_n(arena_t* arena, pair_t* pair, const void* new_value, size_t value_len);
+
+/** Returns a pair allocated from an arena to the arena's free lists.
+ *
+ * \param arena Pointer to the arena the pair was created in, or NULL.
+ * \param pair Pointer to the pair_t structure to be freed.
+ */
+void pair_free_in(arena_t* arena, pair_t* pair);
+
+/** Checks whether a pair holds the given key.
+ *
+ * The stored hash and length are compared first, so key bytes are only read
+ * when both match. Keys of a flow key width are compared a word at a time
+ * (see flow_key_equal()), others with memcmp().
+ *
+ * \param pair Pointer to the pair.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param hash Full hash of the key.
+ * \returns 1 if the pair holds the key, 0 otherwise.
+ */
+static inline int pair_matches(const pair_t* pair, const void* key, size_t key_len, uint64_t hash) {
+    if (pair->hash != hash || pair->key_len != key_len) {
+        return 0;
+    }
+    switch (key_len) {
+    case FLOW_KEY4_WIDTH:
+        return flow_key_equal(pair->key, key, FLOW_KEY4_WIDTH);
+    case FLOW_KEY6_WIDTH:
+        return flow_key_equal(pair->key, key, FLOW_KEY6_WIDTH);
+    default:
+        return memcmp(pair->key, key, key_len) == 0;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,171 @@
+#include "rebuild_worker.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+/** Structure for the background rebuild worker.
+ *
+ * \param thread The worker thread.
+ * \param lock Protects the queue, the stop flag and job state transitions
+ *             other than RUNNING -> DONE.
+ * \param wake Signalled when a job is queued or the worker must stop.
+ * \param head First queued job.
+ * \param tail Last queued job.
+ * \param stop Set to 1 when the worker must exit.
+ */
+struct RebuildWorker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    rebuild_job_t* head;
+    rebuild_job_t* tail;
+    int stop;
+};
+
+/** Main loop of the worker thread.
+ *
+ * Pops jobs in FIFO order and runs them without holding the lock.
+ *
+ * \param arg Pointer to the rebuild_worker_t.
+ * \returns NULL.
+ */
+static void* rebuild_worker_main(void* arg) {
+    rebuild_worker_t* worker = (rebuild_worker_t*)arg;
+
+    pthread_mutex_lock(&worker->lock);
+    while (1) {
+        while (!worker->head && !worker->stop) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        if (worker->stop) {
+            break;
+        }
+
+        // Dequeue the next job
+        rebuild_job_t* job = worker->head;
+        worker->head = job->next;
+        if (!worker->head) {
+            worker->tail = NULL;
+        }
+        job->next = NULL;
+        __atomic_store_n(&job->state, REBUILD_JOB_RUNNING, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&worker->lock);
+
+        job->run(job);
+
+        // Publish the result unless the owner gave up on the job meanwhile
+        pthread_mutex_lock(&worker->lock);
+        if (__atomic_load_n(&job->state, __ATOMIC_RELAXED) == REBUILD_JOB_ABANDONED) {
+            job->destroy(job);
+        }
+        else {
+            __atomic_store_n(&job->state, REBUILD_JOB_DONE, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+rebuild_worker_t* rebuild_worker_create(void) {
+    rebuild_worker_t* worker = (rebuild_worker_t*)malloc(sizeof(rebuild_worker_t));
+    if (!worker) {
+        return NULL; // Memory allocation failed
+    }
+    worker->head = NULL;
+    worker->tail = NULL;
+    worker->stop = 0;
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+
+    if (pthread_create(&worker->thread, NULL, rebuild_worker_main, worker) != 0) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        return NULL; // Thread creation failed
+    }
+    return worker;
+}
+
+int rebuild_worker_submit(rebuild_worker_t* worker, rebuild_job_t* job) {
+    if (!worker || !job || !job->run || !job->destroy) {
+        return 0; // Invalid parameters
+    }
+    job->next = NULL;
+    job->state = REBUILD_JOB_QUEUED;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail) {
+        worker->tail->next = job;
+    }
+    else {
+        worker->head = job;
+    }
+    worker->tail = job;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    return 1;
+}
+
+int rebuild_job_done(rebuild_job_t* job) {
+    return __atomic_load_n(&job->state, __ATOMIC_ACQUIRE) == REBUILD_JOB_DONE;
+}
+
+void rebuild_worker_release(rebuild_worker_t* worker, rebuild_job_t* job) {
+    if (!worker || !job) {
+        return;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    int state = __atomic_load_n(&job->state, __ATOMIC_ACQUIRE);
+    if (state == REBUILD_JOB_RUNNING) {
+        // The worker destroys the job once run() returns
+        __atomic_store_n(&job->state, REBUILD_JOB_ABANDONED, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&worker->lock);
+        return;
+    }
+    if (state == REBUILD_JOB_QUEUED) {
+        // Unlink the job from the queue
+        rebuild_job_t* prev = NULL;
+        rebuild_job_t* cur = worker->head;
+        while (cur && cur != job) {
+            prev = cur;
+            cur = cur->next;
+        }
+        if (cur) {
+            if (prev) {
+                prev->next = cur->next;
+            }
+            else {
+                worker->head = cur->next;
+            }
+            if (worker->tail == cur) {
+                worker->tail = prev;
+            }
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+    job->destroy(job);
+}
+
+void rebuild_worker_destroy(rebuild_worker_t* worker) {
+    if (!worker) {
+        return;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->stop = 1;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    // Destroy jobs that never ran
+    rebuild_job_t* job = worker->head;
+    while (job) {
+        rebuild_job_t* next = job->next;
+        job->destroy(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+}
@@ -0,0 +1,91 @@
+#ifndef REBUILD_WORKER_H
+#define REBUILD_WORKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** States of a background rebuild job.
+ *
+ * A job moves from QUEUED to RUNNING to DONE. A job whose owner gives up on it
+ * while it is running is marked ABANDONED and freed by the worker once it finishes.
+ */
+typedef enum {
+    REBUILD_JOB_QUEUED,
+    REBUILD_JOB_RUNNING,
+    REBUILD_JOB_DONE,
+    REBUILD_JOB_ABANDONED
+} rebuild_job_state_t;
+
+/** Structure for a unit of work executed by a rebuild worker.
+ *
+ * The worker only knows how to run and free jobs; what a job computes is up to
+ * its owner. The owner checks for completion with rebuild_job_done(), which does
+ * not take any lock.
+ *
+ * \param run Function executed on the worker thread.
+ * \param destroy Function releasing the job and any result it still owns.
+ * \param state Current rebuild_job_state_t of the job (accessed atomically).
+ * \param next Link in the worker's queue.
+ */
+typedef struct RebuildJob {
+    void (*run)(struct RebuildJob* job);
+    void (*destroy)(struct RebuildJob* job);
+    int state;
+    struct RebuildJob* next;
+} rebuild_job_t;
+
+/** Opaque structure for a background thread that runs rebuild jobs in FIFO order. */
+typedef struct RebuildWorker rebuild_worker_t;
+
+/** Creates a rebuild worker and starts its thread.
+ *
+ * \returns A pointer to the new worker, or NULL on failure.
+ */
+rebuild_worker_t* rebuild_worker_create(void);
+
+/** Queues a job on the worker.
+ *
+ * The job's run and destroy functions must be set. Ownership stays with the
+ * caller, who must eventually pass the job to rebuild_worker_release().
+ *
+ * \param worker Pointer to the worker.
+ * \param job Pointer to the job to queue.
+ * \returns 1 on success, 0 on failure (invalid parameters).
+ */
+int rebuild_worker_submit(rebuild_worker_t* worker, rebuild_job_t* job);
+
+/** Checks whether a submitted job has finished running.
+ *
+ * This is a single atomic load; results written by the job are visible
+ * to the caller once it returns 1.
+ *
+ * \param job Pointer to a submitted job.
+ * \returns 1 if the job is done, 0 otherwise.
+ */
+int rebuild_job_done(rebuild_job_t* job);
+
+/** Gives a job back to the worker once its owner no longer needs it.
+ *
+ * Queued jobs are dequeued and destroyed, finished jobs are destroyed right away
+ * and running jobs are destroyed by the worker as soon as they complete.
+ *
+ * \param worker Pointer to the worker the job was submitted to.
+ * \param job Pointer to the job to release.
+ */
+void rebuild_worker_release(rebuild_worker_t* worker, rebuild_job_t* job);
+
+/** Stops the worker thread and frees the worker.
+ *
+ * Jobs still queued are destroyed without running. All jobs must have been
+ * released by their owners beforehand.
+ *
+ * \param worker Pointer to the worker to destroy.
+ */
+void rebuild_worker_destroy(rebuild_worker_t* worker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REBUILD_WORKER_H
@@ -0,0 +1,235 @@
+#include "sharded.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Selects the shard of a key.
+ *
+ * The top 32 bits of the seeded key hash are mapped onto the shard range
+ * with a multiply instead of a division.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \returns Pointer to the shard of the key.
+ */
+static dpht_shard_t* sharded_select(DPHT_sharded* sharded, const void* key, size_t key_len) {
+    uint64_t high = hash_bytes_seeded(key, key_len, sharded->seed) >> 32;
+    return &sharded->shards[(high * (uint64_t)sharded->count) >> 32];
+}
+
+/** Takes the lock of a shard, counting the times it was already taken.
+ *
+ * \param shard Pointer to the shard.
+ */
+static void sharded_lock(dpht_shard_t* shard) {
+    if (pthread_mutex_trylock(&shard->lock) != 0) {
+        pthread_mutex_lock(&shard->lock);
+        shard->contended++;
+    }
+}
+
+DPHT_sharded* dpht_sharded_create(int shards, const dpht_config_t* config) {
+    if (shards < 1) {
+        shards = DPHT_SHARDED_DEFAULT_SHARDS;
+    }
+
+    DPHT_sharded* sharded = (DPHT_sharded*)malloc(sizeof(DPHT_sharded));
+    if (!sharded) {
+        return NULL; // Memory allocation failed
+    }
+    sharded->count = 0;
+    sharded->seed = hash_random_seed();
+    sharded->shards = (dpht_shard_t*)aligned_alloc(64, sizeof(dpht_shard_t) * shards);
+    if (!sharded->shards) {
+        free(sharded);
+        return NULL; // Memory allocation failed
+    }
+
+    // Every shard starts with its part of the initial tables
+    dpht_config_t shardConfig;
+    if (config) {
+        shardConfig = *config;
+    }
+    else {
+        dpht_config_init(&shardConfig);
+    }
+    shardConfig.initial_tables = shardConfig.initial_tables / shards;
+    if (shardConfig.initial_tables < 1) {
+        shardConfig.initial_tables = 1;
+    }
+    shardConfig.concurrent = 0;
+
+    for (int i = 0; i < shards; i++) {
+        dpht_shard_t* shard = &sharded->shards[i];
+        shard->dpht = dpht_create_with_config(&shardConfig);
+        if (!shard->dpht) {
+            dpht_sharded_free(sharded);
+            return NULL; // Shard creation failed
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->inserts = 0;
+        shard->removes = 0;
+        shard->contended = 0;
+        sharded->count++;
+    }
+    return sharded;
+}
+
+int dpht_sharded_insert(DPHT_sharded* sharded, const char* key, const char* value) {
+    // Validate input parameters
+    if (!sharded || !key || !value) {
+        return 0;
+    }
+    return dpht_sharded_insert_n(sharded, key, strlen(key), value, strlen(value));
+}
+
+int dpht_sharded_insert_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                          const void* value, size_t value_len) {
+    // Validate input parameters
+    if (!sharded || !key || !value) {
+        return 0;
+    }
+
+    dpht_shard_t* shard = sharded_select(sharded, key, key_len);
+    sharded_lock(shard);
+    int size = shard->dpht->size;
+    int status = dpht_insert_n(shard->dpht, key, key_len, value, value_len);
+    if (shard->dpht->size > size) {
+        shard->inserts++; // A new key, not an update
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+char* dpht_sharded_search(DPHT_sharded* sharded, const char* key) {
+    // Validate input parameters
+    if (!sharded || !key) {
+        return NULL;
+    }
+    return (char*)dpht_sharded_search_n(sharded, key, strlen(key), NULL);
+}
+
+void* dpht_sharded_search_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                            size_t* value_len) {
+    // Validate input parameters
+    if (!sharded || !key) {
+        return NULL;
+    }
+
+    // Lookups may install a finished MPH rebuild, so they take the lock too
+    dpht_shard_t* shard = sharded_select(sharded, key, key_len);
+    sharded_lock(shard);
+    void* value = dpht_search_n(shard->dpht, key, key_len, value_len);
+    pthread_mutex_unlock(&shard->lock);
+    return value;
+}
+
+int dpht_sharded_get_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                       void* out, size_t capacity, size_t* value_len) {
+    // Validate input parameters
+    if (!sharded || !key || (!out && capacity > 0)) {
+        return 0;
+    }
+
+    // Copy the value before the lock lets another writer replace it
+    dpht_shard_t* shard = sharded_select(sharded, key, key_len);
+    sharded_lock(shard);
+    size_t length = 0;
+    void* value = dpht_search_n(shard->dpht, key, key_len, &length);
+    if (value && capacity > 0) {
+        memcpy(out, value, length < capacity ? length : capacity);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (value && value_len) {
+        *value_len = length;
+    }
+    return value ? 1 : 0;
+}
+
+int dpht_sharded_update(DPHT_sharded* sharded, const char* key, const char* new_value) {
+    // Validate input parameters
+    if (!sharded || !key || !new_value) {
+        return 0;
+    }
+    return dpht_sharded_update_n(sharded, key, strlen(key), new_value, strlen(new_value));
+}
+
+int dpht_sharded_update_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                          const void* new_value, size_t value_len) {
+    // Validate input parameters
+    if (!sharded || !key || !new_value) {
+        return 0;
+    }
+
+    dpht_shard_t* shard = sharded_select(sharded, key, key_len);
+    sharded_lock(shard);
+    int status = dpht_update_n(shard->dpht, key, key_len, new_value, value_len);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+void dpht_sharded_remove_entry(DPHT_sharded* sharded, const char* key) {
+    // Validate input parameters
+    if (!sharded || !key) {
+        return;
+    }
+    dpht_sharded_remove_n(sharded, key, strlen(key));
+}
+
+int dpht_sharded_remove_n(DPHT_sharded* sharded, const void* key, size_t key_len) {
+    // Validate input parameters
+    if (!sharded || !key) {
+        return 0;
+    }
+
+    dpht_shard_t* shard = sharded_select(sharded, key, key_len);
+    sharded_lock(shard);
+    int status = dpht_remove_n(shard->dpht, key, key_len);
+    if (status) {
+        shard->removes++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+int dpht_sharded_size(DPHT_sharded* sharded) {
+    if (!sharded) {
+        return 0;
+    }
+    int size = 0;
+    for (int i = 0; i < sharded->count; i++) {
+        dpht_shard_t* shard = &sharded->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        size += shard->dpht->size;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return size;
+}
+
+int dpht_sharded_stats(DPHT_sharded* sharded, int shard, dpht_shard_stats_t* stats) {
+    if (!sharded || !stats || shard < 0 || shard >= sharded->count) {
+        return 0; // Invalid parameters
+    }
+    dpht_shard_t* s = &sharded->shards[shard];
+    pthread_mutex_lock(&s->lock);
+    stats->size = s->dpht->size;
+    stats->capacity = s->dpht->capacity;
+    stats->inserts = s->inserts;
+    stats->removes = s->removes;
+    stats->contended = s->contended;
+    pthread_mutex_unlock(&s->lock);
+    return 1;
+}
+
+void dpht_sharded_free(DPHT_sharded* sharded) {
+    if (!sharded) {
+        return;
+    }
+    for (int i = 0; i < sharded->count; i++) {
+        dpht_free(sharded->shards[i].dpht);
+        pthread_mutex_destroy(&sharded->shards[i].lock);
+    }
+    free(sharded->shards);
+    free(sharded);
+}
@@ -0,0 +1,209 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "DPHT.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DPHT_SHARDED_DEFAULT_SHARDS 16   // Shards used when none are requested
+
+/** Structure for one shard of a sharded DPHT.
+ *
+ * Each shard sits on its own cache lines, so that writers working on
+ * different shards never share a line.
+ *
+ * \param dpht The DPHT holding the keys of the shard.
+ * \param lock Serializes every operation on the shard.
+ * \param inserts Number of new keys inserted into the shard.
+ * \param removes Number of keys removed from the shard.
+ * \param contended Number of operations that found the lock already taken.
+ */
+typedef struct DPHTShard {
+    DPHT* dpht;
+    pthread_mutex_t lock;
+    uint64_t inserts;
+    uint64_t removes;
+    uint64_t contended;
+} __attribute__((aligned(64))) dpht_shard_t;
+
+/** Structure for a DPHT split into independently locked shards.
+ *
+ * The high bits of the key hash select the shard, and the shard's DPHT uses
+ * the low bits to select its bucket, so both levels spread keys evenly.
+ * Every shard grows on its own schedule: a bucket split in one shard never
+ * blocks writers of another shard, and writers to different shards run in
+ * parallel.
+ *
+ * \param count The number of shards.
+ * \param shards The shards.
+ * \param seed Random seed of the hash selecting the shard.
+ */
+typedef struct DPHTSharded {
+    int count;
+    dpht_shard_t* shards;
+    uint64_t seed;
+} DPHT_sharded;
+
+/** Statistics of one shard, as returned by dpht_sharded_stats().
+ *
+ * \param size Number of key-value pairs in the shard.
+ * \param capacity Number of PHT buckets of the shard.
+ * \param inserts Number of new keys inserted into the shard.
+ * \param removes Number of keys removed from the shard.
+ * \param contended Number of operations that had to wait for the shard lock.
+ */
+typedef struct DPHTShardStats {
+    int size;
+    int capacity;
+    uint64_t inserts;
+    uint64_t removes;
+    uint64_t contended;
+} dpht_shard_stats_t;
+
+/** Creates a sharded DPHT.
+ *
+ * \param shards The number of shards. If less than 1,
+ *               DPHT_SHARDED_DEFAULT_SHARDS is used.
+ * \param config Options of every shard's DPHT, or NULL for the defaults. The
+ *               initial tables are divided between the shards. The shard
+ *               locks already serialize each shard, so the concurrent option
+ *               is not used.
+ * \returns A pointer to the new sharded DPHT, or NULL on failure.
+ */
+DPHT_sharded* dpht_sharded_create(int shards, const dpht_config_t* config);
+
+/** Inserts or updates a key-value pair; see dpht_insert().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key string.
+ * \param value Pointer to the value string.
+ * \returns 1 on success, 0 on failure.
+ */
+int dpht_sharded_insert(DPHT_sharded* sharded, const char* key, const char* value);
+
+/** Inserts or updates a binary key-value pair; see dpht_insert_n().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value Pointer to the value bytes.
+ * \param value_len Number of bytes in the value.
+ * \returns 1 on success, 0 on failure.
+ */
+int dpht_sharded_insert_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                          const void* value, size_t value_len);
+
+/** Searches for a key; see dpht_search().
+ *
+ * The returned value belongs to the shard: it stays valid until the key is
+ * updated or removed, which the caller must not do concurrently.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key The key string to search for.
+ * \returns Pointer to the value string if found, or NULL otherwise.
+ */
+char* dpht_sharded_search(DPHT_sharded* sharded, const char* key);
+
+/** Searches for a binary key; see dpht_search_n().
+ *
+ * The returned value belongs to the shard: it stays valid until the key is
+ * updated or removed, which the caller must not do concurrently. Writers on
+ * other threads should use dpht_sharded_get_n(), which copies the value out
+ * under the shard's lock.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes if found, or NULL otherwise.
+ */
+void* dpht_sharded_search_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                            size_t* value_len);
+
+/** Copies the value of a binary key out of its shard.
+ *
+ * The copy is made while the shard's lock is held, so it is safe against
+ * concurrent updates and removals of the key on other threads.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param out Buffer receiving the first min(value length, capacity) bytes
+ *            of the value (may be NULL if capacity is 0).
+ * \param capacity Size of out in bytes.
+ * \param value_len If not NULL, receives the full length of the value when
+ *                  found; a value longer than capacity was truncated.
+ * \returns 1 if the key was found, 0 otherwise.
+ */
+int dpht_sharded_get_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                       void* out, size_t capacity, size_t* value_len);
+
+/** Updates the value of an existing key; see dpht_update().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key string.
+ * \param new_value Pointer to the new value string.
+ * \returns 1 if the key was found and updated, 0 otherwise.
+ */
+int dpht_sharded_update(DPHT_sharded* sharded, const char* key, const char* new_value);
+
+/** Updates the value of an existing binary key; see dpht_update_n().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param new_value Pointer to the new value bytes.
+ * \param value_len Number of bytes in the new value.
+ * \returns 1 if the key was found and updated, 0 otherwise.
+ */
+int dpht_sharded_update_n(DPHT_sharded* sharded, const void* key, size_t key_len,
+                          const void* new_value, size_t value_len);
+
+/** Removes a key; see dpht_remove_entry().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key The key string to remove.
+ */
+void dpht_sharded_remove_entry(DPHT_sharded* sharded, const char* key);
+
+/** Removes a binary key; see dpht_remove_n().
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \returns 1 if the key was found and removed, 0 otherwise.
+ */
+int dpht_sharded_remove_n(DPHT_sharded* sharded, const void* key, size_t key_len);
+
+/** Returns the total number of key-value pairs of all shards.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \returns The number of pairs.
+ */
+int dpht_sharded_size(DPHT_sharded* sharded);
+
+/** Reads the statistics of one shard.
+ *
+ * \param sharded Pointer to the sharded DPHT.
+ * \param shard Index of the shard, from 0 to count - 1.
+ * \param stats Receives the statistics.
+ * \returns 1 on success, 0 if the shard does not exist.
+ */
+int dpht_sharded_stats(DPHT_sharded* sharded, int shard, dpht_shard_stats_t* stats);
+
+/** Deletes a sharded DPHT and all of its shards.
+ *
+ * \param sharded Pointer to the sharded DPHT (NULL is ignored).
+ */
+void dpht_sharded_free(DPHT_sharded* sharded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARDED_H
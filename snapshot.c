@@ -0,0 +1,178 @@
+#include "snapshot.h"
+#include "PHT.h"
+#include "pair.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_RECORD_ALIGN 16   // Records and values are aligned like pair_t values
+
+/** Rounds a record offset up to SNAPSHOT_RECORD_ALIGN.
+ *
+ * \param offset The offset in bytes.
+ * \returns The aligned offset.
+ */
+static size_t snapshot_align(size_t offset) {
+    return (offset + SNAPSHOT_RECORD_ALIGN - 1) & ~(size_t)(SNAPSHOT_RECORD_ALIGN - 1);
+}
+
+/** Computes the offset of the value within the heap record of a key.
+ *
+ * \param key_len Number of bytes in the key.
+ * \returns The offset of the value bytes from the start of the record.
+ */
+static size_t snapshot_value_offset(size_t key_len) {
+    return snapshot_align(sizeof(cmph_uint32) + key_len + 1);
+}
+
+/** Computes the size of the heap record of a pair.
+ *
+ * \param pair Pointer to the pair.
+ * \returns The record size in bytes, padding included.
+ */
+static size_t snapshot_record_size(const pair_t* pair) {
+    return snapshot_align(snapshot_value_offset(pair->key_len) + pair->value_len + 1);
+}
+
+DPHT_snapshot* dpht_freeze(DPHT* dpht) {
+    if (!dpht) {
+        return NULL; // Invalid DPHT
+    }
+
+    DPHT_snapshot* snapshot = (DPHT_snapshot*)calloc(1, sizeof(DPHT_snapshot));
+    if (!snapshot) {
+        return NULL; // Memory allocation failed
+    }
+
+    // Size the heap from every pair of every bucket (delta areas included)
+    size_t n = 0;
+    size_t heap_size = 0;
+    for (int b = 0; b < dpht->capacity; b++) {
+        PHT* table = dpht->tables[b];
+        for (int i = 0; i < table->size; i++) {
+            if (table->entries[i]) {
+                heap_size += snapshot_record_size(table->entries[i]);
+            }
+        }
+        n += (size_t)(table->size - table->tombstones);
+    }
+
+    snapshot->size = n;
+    snapshot->hash = dpht->hash;
+    snapshot->seed = dpht->seed;
+    snapshot->heap_size = heap_size;
+    snapshot->entries = (dpht_snapshot_entry_t*)calloc(n ? n : 1, sizeof(dpht_snapshot_entry_t));
+    snapshot->heap = (char*)aligned_alloc(SNAPSHOT_RECORD_ALIGN,
+                                          heap_size ? heap_size : SNAPSHOT_RECORD_ALIGN);
+    cmph_uint8** records = (cmph_uint8**)malloc(sizeof(cmph_uint8*) * (n ? n : 1));
+    uint64_t* offsets = (uint64_t*)malloc(sizeof(uint64_t) * (n ? n : 1));
+    const pair_t** pairs = (const pair_t**)malloc(sizeof(pair_t*) * (n ? n : 1));
+    if (!snapshot->entries || !snapshot->heap || !records || !offsets || !pairs) {
+        free(records);
+        free(offsets);
+        free(pairs);
+        dpht_snapshot_free(snapshot);
+        return NULL; // Memory allocation failed
+    }
+
+    // Copy every pair into its heap record
+    size_t k = 0;
+    uint64_t offset = 0;
+    for (int b = 0; b < dpht->capacity; b++) {
+        PHT* table = dpht->tables[b];
+        for (int i = 0; i < table->size; i++) {
+            const pair_t* pair = table->entries[i];
+            if (!pair) {
+                continue; // Tombstone
+            }
+            char* record = snapshot->heap + offset;
+            cmph_uint32 key_len = (cmph_uint32)pair->key_len;
+            memcpy(record, &key_len, sizeof(key_len));
+            memcpy(record + sizeof(key_len), pair->key, pair->key_len + 1);
+            memset(record + sizeof(key_len) + pair->key_len + 1, 0,
+                   snapshot_value_offset(pair->key_len) - sizeof(key_len) - pair->key_len - 1);
+            memcpy(record + snapshot_value_offset(pair->key_len), pair->value, pair->value_len + 1);
+            records[k] = (cmph_uint8*)record;
+            offsets[k] = offset;
+            pairs[k] = pair;
+            offset += snapshot_record_size(pair);
+            k++;
+        }
+    }
+
+    // Build one MPH over all keys and lay the entries out in MPH order
+    if (n > 1) {
+        snapshot->mph = pht_build_mph(records, (int)n);
+        if (!snapshot->mph) {
+            free(records);
+            free(offsets);
+            free(pairs);
+            dpht_snapshot_free(snapshot);
+            return NULL; // MPH construction failed
+        }
+    }
+    for (k = 0; k < n; k++) {
+        size_t slot = 0;
+        if (snapshot->mph) {
+            slot = cmph_search(snapshot->mph, pairs[k]->key, (cmph_uint32)pairs[k]->key_len) % n;
+        }
+        dpht_snapshot_entry_t* entry = &snapshot->entries[slot];
+        entry->hash = pairs[k]->hash;
+        entry->offset = offsets[k];
+        entry->key_len = (uint32_t)pairs[k]->key_len;
+        entry->value_len = (uint32_t)pairs[k]->value_len;
+        entry->tag = pht_tag(pairs[k]->hash);
+    }
+
+    free(records);
+    free(offsets);
+    free(pairs);
+    return snapshot;
+}
+
+char* dpht_snapshot_search(const DPHT_snapshot* snapshot, const char* key) {
+    if (!snapshot || !key) {
+        return NULL; // Invalid parameters
+    }
+    return (char*)dpht_snapshot_search_n(snapshot, key, strlen(key), NULL);
+}
+
+void* dpht_snapshot_search_n(const DPHT_snapshot* snapshot, const void* key, size_t key_len,
+                             size_t* value_len) {
+    if (!snapshot || !key || snapshot->size == 0) {
+        return NULL; // Invalid parameters or empty snapshot
+    }
+
+    // One MPH evaluation gives the only entry that can hold the key
+    size_t slot = 0;
+    if (snapshot->mph) {
+        slot = cmph_search(snapshot->mph, (const char*)key, (cmph_uint32)key_len) % snapshot->size;
+    }
+    const dpht_snapshot_entry_t* entry = &snapshot->entries[slot];
+
+    // Reject on the fingerprint and length before touching the heap
+    uint64_t hash = snapshot->hash ? snapshot->hash(key, key_len, snapshot->seed)
+                                   : hash_bytes_seeded(key, key_len, snapshot->seed);
+    if (entry->tag != pht_tag(hash) || entry->hash != hash || entry->key_len != key_len) {
+        return NULL;
+    }
+    const char* record = snapshot->heap + entry->offset;
+    if (memcmp(record + sizeof(cmph_uint32), key, key_len) != 0) {
+        return NULL;
+    }
+    if (value_len) {
+        *value_len = entry->value_len;
+    }
+    return (void*)(record + snapshot_value_offset(entry->key_len));
+}
+
+void dpht_snapshot_free(DPHT_snapshot* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    if (snapshot->mph) {
+        cmph_destroy(snapshot->mph);
+    }
+    free(snapshot->entries);
+    free(snapshot->heap);
+    free(snapshot);
+}
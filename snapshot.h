@@ -0,0 +1,100 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmph.h"
+#include "DPHT.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Structure for one key-value pair of a snapshot.
+ *
+ * \param hash Full hash of the key (the DPHT's hash function and seed).
+ * \param offset Offset of the pair's record in the snapshot heap.
+ * \param key_len Number of bytes in the key.
+ * \param value_len Number of bytes in the value.
+ * \param tag 8-bit fingerprint of the key (pht_tag()).
+ */
+typedef struct DPHTSnapshotEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t key_len;
+    uint32_t value_len;
+    uint8_t tag;
+} dpht_snapshot_entry_t;
+
+/** Structure for an immutable, read-only copy of a DPHT.
+ *
+ * A snapshot indexes all of its keys with a single minimal perfect hash
+ * function: the MPH value of a key is directly the index of its entry in a
+ * flat array, so a lookup is one MPH evaluation and one entry probe, with no
+ * bucket directory and no per-bucket MPH. Keys and values live in one
+ * contiguous heap, each pair as a record made of a cmph_uint32 key length,
+ * the key bytes, a NUL, padding up to a 16-byte boundary, the value bytes and
+ * a NUL. Records start on a 16-byte boundary too, so values are aligned like
+ * the values of pair_t and binary values can be read in place. The records
+ * double as the byte-vector keys the MPH was built from.
+ *
+ * \param mph The minimal perfect hash function over all keys (NULL if size < 2).
+ * \param size Number of key-value pairs.
+ * \param entries Array of size entries, indexed by MPH value.
+ * \param heap Records of all key-value pairs.
+ * \param heap_size Number of bytes in the heap.
+ * \param hash The hash function of the frozen DPHT, or NULL for hash_bytes_seeded().
+ * \param seed The seed of the hash function.
+ */
+typedef struct DPHTSnapshot {
+    cmph_t* mph;
+    size_t size;
+    dpht_snapshot_entry_t* entries;
+    char* heap;
+    size_t heap_size;
+    hash_fn hash;
+    uint64_t seed;
+} DPHT_snapshot;
+
+/** Freezes the current contents of a DPHT into a read-only snapshot.
+ *
+ * The snapshot is a deep copy: the DPHT keeps accepting writes, which only
+ * show up in the next snapshot.
+ *
+ * \param dpht Pointer to the DPHT to freeze.
+ * \returns A pointer to the new snapshot, or NULL on failure.
+ */
+DPHT_snapshot* dpht_freeze(DPHT* dpht);
+
+/** Searches for a key in a snapshot.
+ *
+ * \param snapshot Pointer to the snapshot.
+ * \param key The key string to search for.
+ * \returns Pointer to the value string if the key is found, or NULL otherwise.
+ */
+char* dpht_snapshot_search(const DPHT_snapshot* snapshot, const char* key);
+
+/** Searches for a binary key in a snapshot.
+ *
+ * \param snapshot Pointer to the snapshot.
+ * \param key Pointer to the key bytes.
+ * \param key_len Number of bytes in the key.
+ * \param value_len If not NULL, receives the length of the value when found.
+ * \returns Pointer to the value bytes if the key is found, or NULL otherwise.
+ *          The value is 16-byte aligned and followed by a NUL byte that is
+ *          not counted in value_len.
+ */
+void* dpht_snapshot_search_n(const DPHT_snapshot* snapshot, const void* key, size_t key_len,
+                             size_t* value_len);
+
+/** Frees a snapshot and everything it owns.
+ *
+ * \param snapshot Pointer to the snapshot to free (NULL is ignored).
+ */
+void dpht_snapshot_free(DPHT_snapshot* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOT_H
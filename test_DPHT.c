@@ -5,7 +5,26 @@
  * 3. Updates each key's value and verifies the new value.
  * 4. Deletes every second key and verifies that those keys are removed.
  * 5. Creates a new DPHT and checks that resizing is working properly.
- * 6. Cleans up by deleting both PHTs.
+ * 6. Runs the same workload on a DPHT whose buckets use the FKS backend.
+ * 7. Runs the same workload with MPH rebuilds on a background worker.
+ * 8. Runs the same workload with pairs allocated from an arena.
+ * 9. Exercises the length-aware API with binary keys containing zero bytes.
+ * 10. Checks that batched searches agree with single-key searches.
+ * 11. Bulk-loads DPHTs and checks that every bucket is indexed in one build.
+ * 12. Freezes a DPHT into a snapshot and checks it is unaffected by later writes.
+ * 13. Saves DPHTs to table files and serves lookups from the mapped files.
+ * 14. Runs lock-free readers on a concurrent DPHT while a writer modifies it.
+ * 15. Runs several writer threads on a sharded DPHT and checks per-shard stats.
+ * 16. Checks per-table hash seeds, custom hash functions and power-of-two sizing.
+ * 17. Selects bucket MPH algorithms by size and loads a DPHT with a sized policy.
+ * 18. Expires most keys of a DPHT that keeps tombstones and checks every view of it.
+ * 19. Finds or creates flows through value handles with single-probe upserts.
+ * 20. Stores IPv4 and IPv6 5-tuples in fixed-width DPHTs and looks up bursts of them.
+ * 21. Checks the runtime statistics: counters, bucket histogram and memory breakdown.
+ * 22. Traces builds and splits into an event ring and dumps them as Chrome trace JSON.
+ * 23. Lets the adaptive load controller tune a growing DPHT within its bounds.
+ * 24. Drains DPHTs so that they shrink back, then repacks them with dpht_compact().
+ * 25. Cleans up by deleting all DPHTs.
  */
 
 #include <stdio.h>      // For printf
@@ -13,9 +32,16 @@
 #include <string.h>     // For strcmp
 #include <assert.h>     // For assert
 #include <sys/time.h>   // For time functions
+#include <unistd.h>     // For usleep
+#include <pthread.h>    // For the concurrent reader threads
 #include "PHT.h"
 #include "pair.h"
 #include "DPHT.h"
+#include "snapshot.h"
+#include "dpht_file.h"
+#include "sharded.h"
+#include "flow_key.h"
+#include "trace.h"
 
 /* Helper function: Returns the current time in seconds */
 double get_time(void) {
@@ -24,7 +50,117 @@ double get_time(void) {
     return t.tv_sec + t.tv_usec / 1000000.0;
 }
 
+/* Helper for the thread pool test: marks each index of a chunk as visited.
+ * Low indices are made slower so that the other threads have to steal them. */
+static void count_visits(size_t begin, size_t end, void* arg) {
+    int* visits = (int*)arg;
+    for (size_t i = begin; i < end; i++) {
+        if (i < 64) {
+            usleep(100);
+        }
+        __atomic_fetch_add(&visits[i], 1, __ATOMIC_RELAXED);
+    }
+}
+
 #define NUM_KEYS 20 // Number of keys to test with
+#define SHARDED_WRITERS 4
+#define SHARDED_KEYS 2000 // Keys inserted by each writer of the sharded test
+#define STABLE_KEYS 256 // Keys that stay in the concurrent DPHT for the whole test
+#define CHURN_KEYS 256  // Keys that the writer keeps inserting and removing
+#define READER_THREADS 4
+
+/* Shared state of the concurrent reader test */
+typedef struct {
+    DPHT* dpht;
+    int stop;
+    long lookups;
+} concurrent_test_t;
+
+/* Shared state of one writer of the sharded test */
+typedef struct {
+    DPHT_sharded* sharded;
+    int writer;
+} sharded_writer_t;
+
+/* Writer thread of the sharded test: inserts its own keys, updates them and
+ * removes every second one, copying out the keys of the next writer meanwhile. */
+static void* sharded_writer(void* arg) {
+    sharded_writer_t* writer = (sharded_writer_t*)arg;
+    char key[32], value[32], copied[32];
+    for (int i = 0; i < SHARDED_KEYS; i++) {
+        snprintf(key, sizeof(key), "w%d-%d", writer->writer, i);
+        snprintf(value, sizeof(value), "v%d", i);
+        assert(dpht_sharded_insert(writer->sharded, key, value) == 1);
+    }
+    for (int i = 0; i < SHARDED_KEYS; i++) {
+        snprintf(key, sizeof(key), "w%d-%d", writer->writer, i);
+        snprintf(value, sizeof(value), "u%d", i);
+        assert(dpht_sharded_update(writer->sharded, key, value) == 1);
+        if (i % 2 == 0) {
+            assert(dpht_sharded_remove_n(writer->sharded, key, strlen(key)) == 1);
+        }
+        snprintf(key, sizeof(key), "w%d-%d", (writer->writer + 1) % SHARDED_WRITERS, i);
+        size_t copiedLen = 0;
+        if (dpht_sharded_get_n(writer->sharded, key, strlen(key), copied, sizeof(copied), &copiedLen)) {
+            assert(copiedLen < sizeof(copied) && (copied[0] == 'v' || copied[0] == 'u'));
+            copied[copiedLen] = '\0'; // dpht_sharded_get_n() copies no terminator
+            assert(atoi(copied + 1) == i);
+        }
+    }
+    return NULL;
+}
+
+/* Reader thread of the concurrent test: stable keys must always be found with
+ * one of their two values; churn keys may be missing but never wrong. */
+static void* concurrent_reader(void* arg) {
+    concurrent_test_t* test = (concurrent_test_t*)arg;
+    epoch_reader_t* reader = dpht_reader_register(test->dpht);
+    assert(reader != NULL);
+    char key[32], first[32], second[32];
+    long lookups = 0;
+    while (!__atomic_load_n(&test->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < STABLE_KEYS + CHURN_KEYS; i++) {
+            snprintf(key, sizeof(key), "ckey%d", i);
+            dpht_read_begin(reader);
+            char* result = dpht_search(test->dpht, key);
+            if (i < STABLE_KEYS) {
+                snprintf(first, sizeof(first), "a%d", i);
+                snprintf(second, sizeof(second), "b%d", i);
+                assert(result != NULL);
+                assert(strcmp(result, first) == 0 || strcmp(result, second) == 0);
+            }
+            else {
+                snprintf(first, sizeof(first), "c%d", i);
+                assert(result == NULL || strcmp(result, first) == 0);
+            }
+            dpht_read_end(reader);
+            lookups++;
+        }
+    }
+    dpht_reader_unregister(reader);
+    __atomic_fetch_add(&test->lookups, lookups, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+#define TRACE_RECORDS 2000  // Events recorded by each thread of the trace test
+
+/* Recorder thread of the trace test: records numbered split events. */
+static void* trace_recorder(void* arg) {
+    trace_ring_t* ring = (trace_ring_t*)arg;
+    for (int i = 0; i < TRACE_RECORDS; i++) {
+        trace_ring_record(ring, TRACE_SPLIT_BEGIN, 0, i, i, i + 1);
+    }
+    return NULL;
+}
+
+/* Helper function: Counts the occurrences of needle in text */
+static int count_occurrences(const char* text, const char* needle) {
+    int count = 0;
+    for (const char* at = strstr(text, needle); at; at = strstr(at + 1, needle)) {
+        count++;
+    }
+    return count;
+}
 
 int main(void) {
     char key[64], value[64];
@@ -164,9 +300,965 @@ int main(void) {
     }
 
     printf("Resizing test passed.\n");
+
+    // Incremental growth test:
+    // The directory grows one bucket at a time and every key stays reachable.
+    DPHT* growing = dpht_create(2);
+    assert(growing != NULL);
+    int lastCapacity = growing->capacity;
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(dpht_insert(growing, key, value) == 1);
+        assert(growing->capacity - lastCapacity <= 2); // Bounded work per insert
+        assert(growing->capacity == growing->base + growing->split);
+        lastCapacity = growing->capacity;
+    }
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        result = dpht_search(growing, key);
+        assert(result != NULL && strcmp(result, value) == 0);
+    }
+    printf("Incremental growth test passed: capacity = %d\n", growing->capacity);
+    dpht_free(growing);
     printf("Average lookup time during resizing: %f sec\n", total_lookup / 20);
 
-    // Clean up: Delete both DPHTs.
+    // 6. FKS backend test:
+    // Buckets use the native FKS second level instead of CMPH.
+    dpht_config_t config;
+    dpht_config_init(&config);
+    config.initial_tables = 4;
+    config.backend = PHT_BACKEND_FKS;
+    DPHT* dpht3 = dpht_create_with_config(&config);
+    assert(dpht3 != NULL);
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(dpht_insert(dpht3, key, value) == 1);
+        assert(dpht_search(dpht3, key) != NULL);
+    }
+    assert(dpht3->size == 200);
+    for (int i = 0; i < 200; i += 2) {
+        snprintf(key, sizeof(key), "key%d", i);
+        dpht_remove_entry(dpht3, key);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        result = dpht_search(dpht3, key);
+        if (i % 2 == 0) {
+            assert(result == NULL);
+        }
+        else {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "value%d", i);
+            assert(result != NULL && strcmp(result, expected) == 0);
+        }
+    }
+    printf("FKS backend test passed: size = %d, capacity = %d\n", dpht3->size, dpht3->capacity);
+
+    // 7. Background rebuild test:
+    // Lookups must succeed whether or not the worker has finished a bucket.
+    dpht_config_init(&config);
+    config.initial_tables = 4;
+    config.background_rebuild = 1;
+    DPHT* dpht4 = dpht_create_with_config(&config);
+    assert(dpht4 != NULL);
+    assert(dpht4->context.worker != NULL);
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(dpht_insert(dpht4, key, value) == 1);
+        assert(dpht_search(dpht4, key) != NULL);
+    }
+    for (int i = 0; i < 500; i += 3) {
+        snprintf(key, sizeof(key), "key%d", i);
+        dpht_remove_entry(dpht4, key);
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        result = dpht_search(dpht4, key);
+        if (i % 3 == 0) {
+            assert(result == NULL);
+        }
+        else {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "value%d", i);
+            assert(result != NULL && strcmp(result, expected) == 0);
+        }
+    }
+    printf("Background rebuild test passed: size = %d\n", dpht4->size);
+
+    // 8. Arena test:
+    // Pairs come from the DPHT's slabs; deleted pairs are reused by new inserts.
+    dpht_config_init(&config);
+    config.use_arena = 1;
+    config.huge_pages = 1;
+    DPHT* dpht5 = dpht_create_with_config(&config);
+    assert(dpht5 != NULL);
+    assert(dpht5->context.arena != NULL);
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(dpht_insert(dpht5, key, value) == 1);
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        // Alternate between same-class and larger values
+        snprintf(value, sizeof(value), (i % 2) ? "v%d" : "a_much_longer_value_for_key_%d", i);
+        assert(dpht_update(dpht5, key, value) == 1);
+        result = dpht_search(dpht5, key);
+        assert(result != NULL && strcmp(result, value) == 0);
+    }
+    size_t reserved = arena_reserved_bytes(dpht5->context.arena);
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 500; i += 2) {
+            snprintf(key, sizeof(key), "key%d", i);
+            dpht_remove_entry(dpht5, key);
+        }
+        for (int i = 0; i < 500; i += 2) {
+            snprintf(key, sizeof(key), "key%d", i);
+            snprintf(value, sizeof(value), "value%d", i);
+            assert(dpht_insert(dpht5, key, value) == 1);
+        }
+    }
+    assert(arena_reserved_bytes(dpht5->context.arena) == reserved); // Free lists reused
+    assert(dpht5->size == 500);
+    printf("Arena test passed: %zu bytes reserved for %d pairs\n", reserved, dpht5->size);
+
+    // 9. Binary key test:
+    // Keys that only differ after a zero byte must be distinct entries.
+    DPHT* dpht6 = dpht_create(4);
+    assert(dpht6 != NULL);
+    unsigned char binKey[13];
+    unsigned int binValue;
+    for (unsigned int i = 0; i < 300; i++) {
+        memset(binKey, 0, sizeof(binKey));
+        binKey[11] = (unsigned char)(i & 0xff);
+        binKey[12] = (unsigned char)(i >> 8);
+        binValue = i * 7;
+        assert(dpht_insert_n(dpht6, binKey, sizeof(binKey), &binValue, sizeof(binValue)) == 1);
+    }
+    assert(dpht6->size == 300);
+    for (unsigned int i = 0; i < 300; i++) {
+        memset(binKey, 0, sizeof(binKey));
+        binKey[11] = (unsigned char)(i & 0xff);
+        binKey[12] = (unsigned char)(i >> 8);
+        size_t valueLen = 0;
+        unsigned int* found = dpht_search_n(dpht6, binKey, sizeof(binKey), &valueLen);
+        assert(found != NULL && valueLen == sizeof(unsigned int));
+        memcpy(&binValue, found, sizeof(binValue));
+        assert(binValue == i * 7);
+        // A prefix of the key is a different key
+        assert(dpht_search_n(dpht6, binKey, sizeof(binKey) - 1, NULL) == NULL);
+    }
+    for (unsigned int i = 0; i < 300; i += 2) {
+        memset(binKey, 0, sizeof(binKey));
+        binKey[11] = (unsigned char)(i & 0xff);
+        binKey[12] = (unsigned char)(i >> 8);
+        assert(dpht_remove_n(dpht6, binKey, sizeof(binKey)) == 1);
+        assert(dpht_remove_n(dpht6, binKey, sizeof(binKey)) == 0);
+    }
+    assert(dpht6->size == 150);
+    printf("Binary key test passed: size = %d\n", dpht6->size);
+
+    // 10. Batched search test:
+    // A burst of present and missing keys must give the same answers as
+    // dpht_search, whatever the backend or rebuild mode of the buckets.
+    enum { BURST = 150 };
+    char burstKeys[BURST][16];
+    const char* burst[BURST];
+    char* burstOut[BURST];
+    DPHT* batchTables[] = { dpht, dpht3, dpht4 };
+    for (int i = 0; i < BURST; i++) {
+        snprintf(burstKeys[i], sizeof(burstKeys[i]), "key%d", i);
+        burst[i] = burstKeys[i];
+    }
+    burst[BURST - 1] = NULL; // NULL keys are misses
+    for (size_t t = 0; t < sizeof(batchTables) / sizeof(batchTables[0]); t++) {
+        size_t hits = dpht_search_batch(batchTables[t], burst, BURST, burstOut);
+        size_t expectedHits = 0;
+        for (int i = 0; i < BURST; i++) {
+            char* expected = burst[i] ? dpht_search(batchTables[t], burstKeys[i]) : NULL;
+            assert(burstOut[i] == expected);
+            expectedHits += (expected != NULL);
+        }
+        assert(hits == expectedHits);
+    }
+    printf("Batched search test passed.\n");
+
+    // 11. Bulk load test:
+    // dpht_build sizes the directory up front, so no bucket splits during the
+    // load and every bucket ends up fully indexed by its MPH.
+    enum { BULK = 2000 };
+    char (*bulkKeys)[24] = malloc(sizeof(*bulkKeys) * BULK);
+    char (*bulkValues)[24] = malloc(sizeof(*bulkValues) * BULK);
+    const char** bulkKeyPtrs = malloc(sizeof(char*) * BULK);
+    const char** bulkValuePtrs = malloc(sizeof(char*) * BULK);
+    assert(bulkKeys && bulkValues && bulkKeyPtrs && bulkValuePtrs);
+    for (int i = 0; i < BULK; i++) {
+        snprintf(bulkKeys[i], sizeof(bulkKeys[i]), "bulk%d", i);
+        snprintf(bulkValues[i], sizeof(bulkValues[i]), "value%d", i);
+        bulkKeyPtrs[i] = bulkKeys[i];
+        bulkValuePtrs[i] = bulkValues[i];
+    }
+    DPHT* bulk = dpht_build(bulkKeyPtrs, bulkValuePtrs, BULK);
+    assert(bulk != NULL);
+    assert(bulk->size == BULK);
+    assert(bulk->split == 0 && bulk->capacity == bulk->base); // No split happened
+    for (int b = 0; b < bulk->capacity; b++) {
+        PHT* table = bulk->tables[b];
+        assert(table->size <= 1 || table->mph_size == table->size);
+    }
+    for (int i = 0; i < BULK; i++) {
+        result = dpht_search(bulk, bulkKeys[i]);
+        assert(result != NULL && strcmp(result, bulkValues[i]) == 0);
+    }
+
+    // A second batch updates the first half, adds new keys and repeats a key.
+    for (int i = 0; i < BULK; i++) {
+        snprintf(bulkKeys[i], sizeof(bulkKeys[i]), "bulk%d", i + BULK / 2);
+        snprintf(bulkValues[i], sizeof(bulkValues[i]), "second%d", i);
+    }
+    snprintf(bulkKeys[BULK - 1], sizeof(bulkKeys[BULK - 1]), "bulk%d", BULK + 7);
+    assert(dpht_insert_batch(bulk, bulkKeyPtrs, bulkValuePtrs, BULK) == BULK);
+    assert(bulk->size == BULK + BULK / 2 - 1);
+    result = dpht_search(bulk, "bulk0");
+    assert(result != NULL && strcmp(result, "value0") == 0);
+    snprintf(key, sizeof(key), "bulk%d", BULK + 7);
+    snprintf(value, sizeof(value), "second%d", BULK - 1); // Last value wins
+    result = dpht_search(bulk, key);
+    assert(result != NULL && strcmp(result, value) == 0);
+
+    // The FKS backend loads through the same path.
+    dpht_config_t bulkConfig;
+    dpht_config_init(&bulkConfig);
+    bulkConfig.backend = PHT_BACKEND_FKS;
+    DPHT* bulkFks = dpht_build_with_config(&bulkConfig, bulkKeyPtrs, bulkValuePtrs, BULK - 1);
+    assert(bulkFks != NULL && bulkFks->size == BULK - 1);
+    for (int i = 0; i < BULK - 1; i++) {
+        result = dpht_search(bulkFks, bulkKeys[i]);
+        assert(result != NULL && strcmp(result, bulkValues[i]) == 0);
+    }
+    printf("Bulk load test passed: %d keys in %d buckets\n", bulk->size, bulk->capacity);
+
+    // The same load on a thread pool must give the same table.
+    bulkConfig.backend = PHT_BACKEND_CMPH;
+    bulkConfig.threads = 4;
+    DPHT* bulkParallel = dpht_build_with_config(&bulkConfig, bulkKeyPtrs, bulkValuePtrs, BULK);
+    assert(bulkParallel != NULL && bulkParallel->pool != NULL);
+    assert(bulkParallel->size == BULK - 1); // One key of the batch is repeated
+    for (int b = 0; b < bulkParallel->capacity; b++) {
+        PHT* table = bulkParallel->tables[b];
+        assert(table->size <= 1 || table->mph_size == table->size);
+    }
+    for (int i = 0; i < BULK - 1; i++) {
+        int last = (i == BULK / 2 + 7) ? BULK - 1 : i; // The repeated key keeps its last value
+        result = dpht_search(bulkParallel, bulkKeys[i]);
+        assert(result != NULL && strcmp(result, bulkValues[last]) == 0);
+    }
+    // Every index of a parallel loop runs exactly once, even with skewed chunks.
+    int visits[BULK] = { 0 };
+    thread_pool_parallel_for(bulkParallel->pool, BULK, 1, count_visits, visits);
+    for (int i = 0; i < BULK; i++) {
+        assert(visits[i] == 1);
+    }
+    printf("Parallel bulk load test passed with %d threads\n", thread_pool_size(bulkParallel->pool));
+    dpht_free(bulkParallel);
+    dpht_free(bulkFks);
+    dpht_free(bulk);
+    free(bulkKeys);
+    free(bulkValues);
+    free(bulkKeyPtrs);
+    free(bulkValuePtrs);
+
+    // 12. Snapshot test:
+    // A frozen snapshot answers like the DPHT it was taken from, and later
+    // writes to the DPHT do not show up in it.
+    DPHT* frozen = dpht_create(8);
+    assert(frozen != NULL);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(dpht_insert(frozen, key, value) == 1);
+    }
+    DPHT_snapshot* snapshot = dpht_freeze(frozen);
+    assert(snapshot != NULL);
+    assert(snapshot->size == (size_t)frozen->size);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "grow%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        result = dpht_snapshot_search(snapshot, key);
+        assert(result != NULL && strcmp(result, value) == 0);
+        assert((uintptr_t)result % 16 == 0); // Binary values can be read in place
+    }
+    assert(dpht_snapshot_search(snapshot, "missing") == NULL);
+    assert(dpht_snapshot_search_n(snapshot, "grow1", 4, NULL) == NULL); // A prefix is another key
+    dpht_update(frozen, "grow1", "changed");
+    dpht_remove_entry(frozen, "grow2");
+    dpht_insert(frozen, "fresh", "value");
+    result = dpht_snapshot_search(snapshot, "grow1");
+    assert(result != NULL && strcmp(result, "value1") == 0);
+    assert(dpht_snapshot_search(snapshot, "grow2") != NULL);
+    assert(dpht_snapshot_search(snapshot, "fresh") == NULL);
+    dpht_snapshot_free(snapshot);
+
+    // The next freeze sees the writes.
+    snapshot = dpht_freeze(frozen);
+    assert(snapshot != NULL && snapshot->size == (size_t)frozen->size);
+    result = dpht_snapshot_search(snapshot, "grow1");
+    assert(result != NULL && strcmp(result, "changed") == 0);
+    assert(dpht_snapshot_search(snapshot, "grow2") == NULL);
+    assert(dpht_snapshot_search(snapshot, "fresh") != NULL);
+    dpht_snapshot_free(snapshot);
+    printf("Snapshot test passed.\n");
+    dpht_free(frozen);
+
+    // 13. Mapped file test:
+    // A saved table answers from the mapping exactly like the DPHT did, for
+    // CMPH buckets (with delta areas) and FKS buckets alike.
+    const char* mapPath = "test_DPHT.map";
+    DPHT* savedTables[] = { dpht, dpht3, dpht4 };
+    for (size_t t = 0; t < sizeof(savedTables) / sizeof(savedTables[0]); t++) {
+        assert(dpht_save(savedTables[t], mapPath) == 1);
+        DPHT_mapped* mapped = dpht_open_mmap(mapPath);
+        assert(mapped != NULL);
+        assert(mapped->header->size == (uint64_t)savedTables[t]->size);
+        for (int i = 0; i < NUM_KEYS; i++) {
+            snprintf(key, sizeof(key), "key%d", i);
+            char* expected = dpht_search(savedTables[t], key);
+            result = dpht_mapped_search(mapped, key);
+            assert((result == NULL) == (expected == NULL));
+            assert(!result || strcmp(result, expected) == 0);
+            assert((uintptr_t)result % 8 == 0); // Binary values can be read in place
+        }
+        assert(dpht_mapped_search(mapped, "missing") == NULL);
+        dpht_mapped_close(mapped);
+    }
+    // Files that are not table files are rejected.
+    FILE* junk = fopen(mapPath, "wb");
+    assert(junk != NULL);
+    fputs("not a table file, just some text that is long enough for a header", junk);
+    fclose(junk);
+    assert(dpht_open_mmap(mapPath) == NULL);
+    remove(mapPath);
+    assert(dpht_open_mmap(mapPath) == NULL);
+    printf("Mapped file test passed.\n");
+
+    // 14. Concurrent reader test:
+    // Readers never lock and never see a torn or freed value while the writer
+    // inserts (splitting buckets), updates and removes keys.
+    dpht_config_t concurrentConfig;
+    dpht_config_init(&concurrentConfig);
+    concurrentConfig.initial_tables = 2;
+    concurrentConfig.concurrent = 1;
+    DPHT* shared = dpht_create_with_config(&concurrentConfig);
+    assert(shared != NULL);
+    assert(dpht_reader_register(dpht) == NULL); // Not a concurrent DPHT
+    char cvalue[32];
+    for (int i = 0; i < STABLE_KEYS; i++) {
+        snprintf(key, sizeof(key), "ckey%d", i);
+        snprintf(cvalue, sizeof(cvalue), "a%d", i);
+        assert(dpht_insert(shared, key, cvalue) == 1);
+    }
+    concurrent_test_t concurrentTest = { shared, 0, 0 };
+    pthread_t readers[READER_THREADS];
+    for (int t = 0; t < READER_THREADS; t++) {
+        assert(pthread_create(&readers[t], NULL, concurrent_reader, &concurrentTest) == 0);
+    }
+    for (int round = 0; round < 20; round++) {
+        for (int i = STABLE_KEYS; i < STABLE_KEYS + CHURN_KEYS; i++) {
+            snprintf(key, sizeof(key), "ckey%d", i);
+            snprintf(cvalue, sizeof(cvalue), "c%d", i);
+            assert(dpht_insert(shared, key, cvalue) == 1);
+        }
+        for (int i = 0; i < STABLE_KEYS; i++) {
+            snprintf(key, sizeof(key), "ckey%d", i);
+            snprintf(cvalue, sizeof(cvalue), "%c%d", round % 2 ? 'a' : 'b', i);
+            assert(dpht_update(shared, key, cvalue) == 1);
+        }
+        for (int i = STABLE_KEYS; i < STABLE_KEYS + CHURN_KEYS; i++) {
+            snprintf(key, sizeof(key), "ckey%d", i);
+            assert(dpht_remove_n(shared, key, strlen(key)) == 1);
+        }
+    }
+    __atomic_store_n(&concurrentTest.stop, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < READER_THREADS; t++) {
+        pthread_join(readers[t], NULL);
+    }
+    assert(shared->size == STABLE_KEYS);
+    // With every reader gone, the retired versions can all be freed.
+    epoch_reclaim(shared->context.epoch);
+    epoch_reclaim(shared->context.epoch);
+    assert(epoch_pending(shared->context.epoch) == 0);
+    printf("Concurrent reader test passed: %ld lookups, capacity = %d\n",
+           concurrentTest.lookups, shared->capacity);
+    dpht_free(shared);
+
+    // 15. Sharded DPHT test:
+    // Writers on different threads fill the shards in parallel; every shard
+    // grows on its own and the shard statistics add up to the totals.
+    DPHT_sharded* sharded = dpht_sharded_create(8, NULL);
+    assert(sharded != NULL);
+    assert(sharded->count == 8);
+    pthread_t writers[SHARDED_WRITERS];
+    sharded_writer_t writerArgs[SHARDED_WRITERS];
+    for (int t = 0; t < SHARDED_WRITERS; t++) {
+        writerArgs[t].sharded = sharded;
+        writerArgs[t].writer = t;
+        assert(pthread_create(&writers[t], NULL, sharded_writer, &writerArgs[t]) == 0);
+    }
+    for (int t = 0; t < SHARDED_WRITERS; t++) {
+        pthread_join(writers[t], NULL);
+    }
+    assert(dpht_sharded_size(sharded) == SHARDED_WRITERS * SHARDED_KEYS / 2);
+    for (int t = 0; t < SHARDED_WRITERS; t++) {
+        for (int i = 0; i < SHARDED_KEYS; i++) {
+            snprintf(key, sizeof(key), "w%d-%d", t, i);
+            snprintf(value, sizeof(value), "u%d", i);
+            result = dpht_sharded_search(sharded, key);
+            assert(i % 2 == 0 ? result == NULL : (result && strcmp(result, value) == 0));
+        }
+    }
+    char copiedValue[4];
+    size_t copiedLen = 0;
+    assert(dpht_sharded_get_n(sharded, "w0-1", 4, copiedValue, sizeof(copiedValue), &copiedLen) == 1);
+    assert(copiedLen == 2 && memcmp(copiedValue, "u1", 2) == 0);
+    assert(dpht_sharded_get_n(sharded, "w0-11", 5, copiedValue, 2, &copiedLen) == 1);
+    assert(copiedLen == 3 && memcmp(copiedValue, "u1", 2) == 0); // Truncated to the buffer
+    assert(dpht_sharded_get_n(sharded, "w0-0", 4, copiedValue, sizeof(copiedValue), NULL) == 0);
+    assert(dpht_sharded_get_n(sharded, "w0-1", 4, NULL, 0, &copiedLen) == 1 && copiedLen == 2);
+    dpht_shard_stats_t shardStats;
+    uint64_t shardInserts = 0, shardRemoves = 0;
+    int shardSize = 0;
+    for (int i = 0; i < sharded->count; i++) {
+        assert(dpht_sharded_stats(sharded, i, &shardStats) == 1);
+        assert(shardStats.size > 0); // Keys are spread over every shard
+        shardInserts += shardStats.inserts;
+        shardRemoves += shardStats.removes;
+        shardSize += shardStats.size;
+    }
+    assert(dpht_sharded_stats(sharded, sharded->count, &shardStats) == 0);
+    assert(shardInserts == SHARDED_WRITERS * SHARDED_KEYS);
+    assert(shardRemoves == SHARDED_WRITERS * SHARDED_KEYS / 2);
+    assert(shardSize == dpht_sharded_size(sharded));
+    dpht_sharded_free(sharded);
+    printf("Sharded DPHT test passed.\n");
+
+    // 16. Hash function test:
+    // Every table draws its own seed unless one is given, a custom hash
+    // function works like the default one, and the directory is a power of two.
+    DPHT* seededA = dpht_create(10);
+    DPHT* seededB = dpht_create(10);
+    assert(seededA != NULL && seededB != NULL);
+    assert(seededA->capacity == 16 && seededA->base == 16);
+    assert(seededA->seed != seededB->seed);
+    dpht_free(seededA);
+    dpht_free(seededB);
+    assert(hash_bytes_seeded("flow_1", 6, 1) != hash_bytes_seeded("flow_1", 6, 2));
+    assert(hash_bytes_seeded("flow_1", 6, 1) == hash_bytes_seeded("flow_1", 6, 1));
+    dpht_config_t hashConfig;
+    dpht_config_init(&hashConfig);
+    hashConfig.hash = hash_djb2;
+    hashConfig.seed = 42;
+    DPHT* custom = dpht_create_with_config(&hashConfig);
+    assert(custom != NULL);
+    assert(custom->seed == 42);
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        snprintf(value, sizeof(value), "hop_%d", i);
+        assert(dpht_insert(custom, key, value) == 1);
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        snprintf(value, sizeof(value), "hop_%d", i);
+        result = dpht_search(custom, key);
+        assert(result && strcmp(result, value) == 0);
+    }
+    assert(custom->base > 0 && (custom->base & (custom->base - 1)) == 0);
+    DPHT_snapshot* customSnapshot = dpht_freeze(custom);
+    assert(customSnapshot != NULL);
+    result = dpht_snapshot_search(customSnapshot, "flow_7");
+    assert(result && strcmp(result, "hop_7") == 0);
+    dpht_snapshot_free(customSnapshot);
+    assert(dpht_save(custom, mapPath) == 0); // Files only support the default hash
+    dpht_free(custom);
+    printf("Hash function test passed.\n");
+
+    // 17. MPH policy test:
+    // Tiers are picked by bucket size and must be added in ascending order.
+    pht_mph_policy_t policy;
+    pht_mph_policy_init(&policy);
+    assert(pht_mph_policy_select(&policy, 1000) == &pht_mph_chd);
+    assert(pht_mph_policy_select(NULL, 3) == &pht_mph_chd);
+    assert(pht_mph_policy_add_tier(&policy, 4, &pht_mph_bmz) == 1);
+    assert(pht_mph_policy_add_tier(&policy, 4, &pht_mph_chm) == 0);
+    assert(pht_mph_policy_add_tier(&policy, 64, &pht_mph_bdz) == 1);
+    assert(pht_mph_policy_select(&policy, 2) == &pht_mph_bmz);
+    assert(pht_mph_policy_select(&policy, 5) == &pht_mph_bdz);
+    assert(pht_mph_policy_select(&policy, 64) == &pht_mph_bdz);
+    assert(pht_mph_policy_select(&policy, 65) == &pht_mph_chd);
+    dpht_config_t policyConfig;
+    dpht_config_init(&policyConfig);
+    policyConfig.mph_policy = policy;
+    policyConfig.delta_threshold = 0; // Rebuild on every insert
+    DPHT* policyTable = dpht_create_with_config(&policyConfig);
+    assert(policyTable != NULL);
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        snprintf(value, sizeof(value), "hop_%d", i);
+        assert(dpht_insert(policyTable, key, value) == 1);
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        snprintf(value, sizeof(value), "hop_%d", i);
+        result = dpht_search(policyTable, key);
+        assert(result && strcmp(result, value) == 0);
+    }
+    dpht_free(policyTable);
+    printf("MPH policy test passed.\n");
+
+    // 18. Tombstone test:
+    // With tombstone_percent at 100, removals never rebuild a bucket; lookups,
+    // snapshots, table files and splits must all skip the tombstones.
+    dpht_config_t graveConfig;
+    dpht_config_init(&graveConfig);
+    graveConfig.initial_tables = 4;
+    graveConfig.tombstone_percent = 100;
+    DPHT* graves = dpht_create_with_config(&graveConfig);
+    assert(graves != NULL);
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert(dpht_insert(graves, key, "open") == 1);
+    }
+    int tombstones = 0;
+    for (int i = 0; i < 200; i += 3) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert(dpht_remove_n(graves, key, strlen(key)) == 1);
+    }
+    for (int b = 0; b < graves->capacity; b++) {
+        tombstones += graves->tables[b]->tombstones;
+    }
+    assert(tombstones > 0);
+    DPHT_snapshot* graveSnapshot = dpht_freeze(graves);
+    assert(graveSnapshot != NULL && graveSnapshot->size == (size_t)graves->size);
+    assert(dpht_save(graves, mapPath) == 1);
+    DPHT_mapped* graveFile = dpht_open_mmap(mapPath);
+    assert(graveFile != NULL && graveFile->header->size == (uint64_t)graves->size);
+    for (int i = 200; i < 400; i++) { // Splits move pairs past the tombstones
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert(dpht_insert(graves, key, "open") == 1);
+    }
+    for (int i = 0; i < 400; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        int open = (i >= 200) || (i % 3 != 0);
+        assert((dpht_search(graves, key) != NULL) == open);
+        if (i < 200) {
+            assert((dpht_snapshot_search(graveSnapshot, key) != NULL) == open);
+            assert((dpht_mapped_search(graveFile, key) != NULL) == open);
+        }
+    }
+    dpht_mapped_close(graveFile);
+    remove(mapPath);
+    dpht_snapshot_free(graveSnapshot);
+    dpht_free(graves);
+    printf("Tombstone test passed.\n");
+
+    // 19. Upsert test:
+    // Handles returned by dpht_get_or_insert() and dpht_upsert() point at the
+    // stored pair and survive the splits of later inserts.
+    DPHT* flows = dpht_create(2);
+    assert(flows != NULL);
+    int inserted = -1;
+    pair_t* flow = dpht_get_or_insert(flows, "flow_a", &inserted);
+    assert(flow != NULL && inserted == 1 && flow->value_len == 0);
+    assert(dpht_set_value(flows, flow, "0001", 4) == 1);
+    char* counter = flow->value;
+    assert(dpht_get_or_insert(flows, "flow_a", &inserted) == flow && inserted == 0);
+    memcpy(flow->value, "0002", 4); // Update through the handle
+    assert(strcmp(dpht_search(flows, "flow_a"), "0002") == 0);
+    assert(dpht_upsert(flows, "flow_a", "0003") == flow);
+    assert(flow->value == counter); // Same length: updated in place
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        assert(dpht_upsert(flows, key, value) != NULL);
+    }
+    assert(flows->size == 101);
+    assert(dpht_get_or_insert(flows, "flow_a", &inserted) == flow && inserted == 0);
+    assert(strcmp(flow->value, "0003") == 0);
+    assert(dpht_get_or_insert_n(flows, "flow_b", 6, "new", 3, &inserted) != NULL && inserted == 1);
+    assert(dpht_get_or_insert_n(flows, "flow_b", 6, "other", 5, &inserted) != NULL && inserted == 0);
+    assert(strcmp(dpht_search(flows, "flow_b"), "new") == 0);
+    dpht_free(flows);
+    dpht_config_t sharedConfig;
+    dpht_config_init(&sharedConfig);
+    sharedConfig.concurrent = 1;
+    DPHT* noHandles = dpht_create_with_config(&sharedConfig);
+    assert(noHandles != NULL);
+    assert(dpht_upsert(noHandles, "flow_a", "1") == NULL); // Readers could see the writes
+    assert(dpht_insert(noHandles, "flow_a", "1") == 1);
+    dpht_free(noHandles);
+    printf("Upsert test passed.\n");
+
+    // 20. Flow key test:
+    // Fixed-width tables hash the same way as byte keys, compare keys a word
+    // at a time and reject keys of any other length.
+    dpht_config_t flowConfig;
+    dpht_config_init(&flowConfig);
+    flowConfig.initial_tables = 2;
+    flowConfig.key_width = FLOW_KEY4_WIDTH;
+    flowConfig.seed = 99;
+    DPHT* flows4 = dpht_create_with_config(&flowConfig);
+    assert(flows4 != NULL && flows4->key_width == FLOW_KEY4_WIDTH);
+    flow_key4_t flowKeys[300];
+    for (int i = 0; i < 300; i++) {
+        flow_key4_init(&flowKeys[i], 0x0a000001u, 0x0a000002u, (uint16_t)(1000 + i), 80, 6);
+        uint32_t hop = (uint32_t)i;
+        assert(dpht_insert_n(flows4, &flowKeys[i], sizeof(flowKeys[i]), &hop, sizeof(hop)) == 1);
+    }
+    assert(flows4->size == 300);
+    flow_key4_t udpKey; // Differs from flowKeys[7] in the protocol byte only
+    flow_key4_init(&udpKey, 0x0a000001u, 0x0a000002u, 1007, 80, 17);
+    assert(udpKey.pad[0] == 0 && udpKey.pad[1] == 0 && udpKey.pad[2] == 0);
+    assert(flow_key_equal(&flowKeys[7], &flowKeys[7], FLOW_KEY4_WIDTH));
+    assert(!flow_key_equal(&flowKeys[7], &udpKey, FLOW_KEY4_WIDTH));
+    assert(flow_key_hash(&udpKey, FLOW_KEY4_WIDTH, 5) == hash_bytes_seeded(&udpKey, FLOW_KEY4_WIDTH, 5));
+    unsigned char flowBytes[FLOW_KEY6_WIDTH];
+    for (int i = 0; i < FLOW_KEY6_WIDTH; i++) {
+        flowBytes[i] = (unsigned char)(i * 37 + 11);
+    }
+    assert(flow_key_hash(flowBytes, FLOW_KEY6_WIDTH, 5) == hash_bytes_seeded(flowBytes, FLOW_KEY6_WIDTH, 5));
+    assert(flow_key_hash(flowBytes, FLOW_KEY4_WIDTH, 0) == hash_bytes(flowBytes, FLOW_KEY4_WIDTH));
+    assert(*(uint32_t*)dpht_search_n(flows4, &flowKeys[7], sizeof(flowKeys[7]), NULL) == 7);
+    assert(dpht_search_n(flows4, &udpKey, sizeof(udpKey), NULL) == NULL);
+    assert(dpht_search_n(flows4, &flowKeys[7], 13, NULL) == NULL); // Unpadded tuple
+    assert(dpht_insert_n(flows4, &udpKey, 13, "x", 1) == 0);
+    assert(dpht_insert(flows4, "flow_a", "1") == 0);
+    assert(dpht_remove_n(flows4, &flowKeys[7], 8) == 0 && flows4->size == 300);
+    pair_t* flowPair = dpht_get_or_insert_n(flows4, &udpKey, sizeof(udpKey), "hop", 3, &inserted);
+    assert(flowPair != NULL && inserted == 1);
+    assert(flowPair->key == (char*)(flowPair + 1)); // Key stored inline
+    flow_key4_t flowBurst[70];
+    void* flowHits[70];
+    for (int i = 0; i < 70; i++) {
+        flowBurst[i] = flowKeys[i * 4];
+        if (i % 10 == 9) {
+            flowBurst[i].dst_port = 81; // Unknown flow
+        }
+    }
+    assert(dpht_search_batch_n(flows4, flowBurst, 70, flowHits) == 63);
+    for (int i = 0; i < 70; i++) {
+        assert(flowHits[i] == dpht_search_n(flows4, &flowBurst[i], sizeof(flowBurst[i]), NULL));
+        assert((flowHits[i] == NULL) == (i % 10 == 9));
+    }
+    assert(dpht_search_batch_n(dpht, flowBurst, 70, flowHits) == 0); // No fixed width
+    DPHT_snapshot* flowSnapshot = dpht_freeze(flows4);
+    assert(flowSnapshot != NULL);
+    // Snapshot values are 16-byte aligned, so the value can be loaded in place
+    const void* flowValue = dpht_snapshot_search_n(flowSnapshot, &flowKeys[9], sizeof(flowKeys[9]), NULL);
+    assert(flowValue != NULL && (uintptr_t)flowValue % 16 == 0);
+    assert(*(const uint32_t*)flowValue == 9);
+    dpht_snapshot_free(flowSnapshot);
+    dpht_free(flows4);
+
+    flowConfig.key_width = FLOW_KEY6_WIDTH;
+    DPHT* flows6 = dpht_create_with_config(&flowConfig);
+    assert(flows6 != NULL);
+    uint8_t client[16] = { 0x20, 0x01, 0x0d, 0xb8 }, server[16] = { 0x20, 0x01, 0x0d, 0xb8, 0xff };
+    flow_key6_t flowKey6;
+    for (int i = 0; i < 200; i++) {
+        client[15] = (uint8_t)i;
+        flow_key6_init(&flowKey6, client, server, 5000, 443, 6);
+        assert(dpht_insert_n(flows6, &flowKey6, sizeof(flowKey6), &i, sizeof(i)) == 1);
+    }
+    client[15] = 42;
+    flow_key6_init(&flowKey6, client, server, 5000, 443, 6);
+    assert(*(int*)dpht_search_n(flows6, &flowKey6, sizeof(flowKey6), NULL) == 42);
+    flowKey6.protocol = 17;
+    assert(dpht_search_n(flows6, &flowKey6, sizeof(flowKey6), NULL) == NULL);
+    flowKey6.protocol = 6;
+    assert(dpht_remove_n(flows6, &flowKey6, sizeof(flowKey6)) == 1);
+    assert(dpht_search_n(flows6, &flowKey6, sizeof(flowKey6), NULL) == NULL && flows6->size == 199);
+    dpht_free(flows6);
+    printf("Flow key test passed.\n");
+
+    // 21. Statistics test:
+    // The shape and memory figures always add up; the event counters are
+    // only checked when the library was built with DPHT_STATS.
+    dpht_config_t statsConfig;
+    dpht_config_init(&statsConfig);
+    statsConfig.initial_tables = 2;
+    statsConfig.tombstone_percent = 100; // Removals leave tombstones
+    DPHT* counted = dpht_create_with_config(&statsConfig);
+    assert(counted != NULL);
+    dpht_stats_t stats;
+    assert(dpht_get_stats(counted, &stats) == 1);
+    assert(stats.size == 0 && stats.buckets == 2 && stats.histogram[0] == 2);
+    assert(stats.pair_bytes == 0 && stats.probes == 0 && stats.splits == 0);
+    size_t keyBytes = 0;
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "stat_%d", i);
+        assert(dpht_insert(counted, key, "v") == 1);
+        keyBytes += strlen(key) + 1;
+    }
+    const char* statsBurst[4] = { "stat_1", "stat_999", "stat_x", NULL };
+    char* statsOut[4];
+    assert(dpht_search_batch(counted, statsBurst, 4, statsOut) == 2);
+    for (int i = 0; i < 1000; i += 2) {
+        snprintf(key, sizeof(key), "stat_%d", i);
+        assert(dpht_search(counted, key) != NULL);
+        assert(dpht_search(counted, "stat_missing") == NULL);
+    }
+    assert(dpht_remove_n(counted, "stat_0", 6) == 1);
+    assert(dpht_get_stats(counted, &stats) == 1);
+    assert(stats.size == 999 && stats.buckets == (size_t)counted->capacity);
+    size_t histogramBuckets = 0;
+    for (int b = 0; b < DPHT_STATS_HISTOGRAM_BINS; b++) {
+        histogramBuckets += stats.histogram[b];
+    }
+    assert(histogramBuckets == stats.buckets);
+    assert(stats.largest_bucket > 0 && stats.largest_bucket <= stats.size);
+    assert(stats.pair_bytes == 999 * sizeof(pair_t));
+    assert(stats.key_bytes == keyBytes - strlen("stat_0") - 1 && stats.value_bytes == 999 * 2);
+    assert(stats.directory_bytes >= stats.buckets * (sizeof(PHT*) + sizeof(PHT)));
+    assert(stats.entries_bytes >= (stats.size + stats.tombstones) * sizeof(pair_t*));
+    assert(stats.mph_bytes > 0 && stats.arena_bytes == 0);
+    assert(stats.total_bytes == stats.directory_bytes + stats.entries_bytes + stats.pair_bytes +
+                                stats.key_bytes + stats.value_bytes + stats.mph_bytes);
+    if (stats.counters_enabled) {
+        // Inserts, the searched burst, the single searches and the removal
+        assert(stats.probes == 1000 + 3 + 1000 + 1);
+        assert(stats.hits == 2 + 500 && stats.misses == 1 + 500);
+        assert(stats.splits == stats.buckets - 2);
+        assert(stats.rebuilds > 0 && stats.rebuild_failures == 0);
+        assert(stats.rebuilds == stats.cmph_builds + stats.seed_builds + stats.fks_builds);
+        assert(stats.rebuild_max_ns <= stats.rebuild_ns);
+    }
+    else {
+        assert(stats.probes == 0 && stats.rebuilds == 0 && stats.splits == 0);
+    }
+    dpht_free(counted);
+    printf("Statistics test passed.\n");
+
+    // 22. Trace test:
+    // A full ring keeps the newest events; concurrent recorders never publish
+    // a torn event, and a traced DPHT dumps balanced build and split events.
+    trace_ring_t* ring = trace_ring_create(3); // Rounded up to 4 events
+    assert(ring != NULL);
+    for (int i = 0; i < 10; i++) {
+        trace_ring_record(ring, TRACE_REBUILD_BEGIN, TRACE_BUILD_SEED, 7, i, 0);
+    }
+    trace_event_t traced[256];
+    uint64_t dropped = 0;
+    assert(trace_ring_snapshot(ring, traced, 256, &dropped) == 4 && dropped == 6);
+    assert(traced[0].a == 6 && traced[3].a == 9 && traced[3].bucket == 7);
+    assert(traced[0].kind == TRACE_BUILD_SEED && traced[0].timestamp_ns <= traced[3].timestamp_ns);
+    trace_ring_destroy(ring);
+    ring = trace_ring_create(256);
+    assert(ring != NULL);
+    pthread_t recorders[4];
+    for (int t = 0; t < 4; t++) {
+        assert(pthread_create(&recorders[t], NULL, trace_recorder, ring) == 0);
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(recorders[t], NULL);
+    }
+    size_t tracedCount = trace_ring_snapshot(ring, traced, 256, &dropped);
+    assert(tracedCount == 256 && dropped == 4 * TRACE_RECORDS - 256);
+    for (size_t i = 0; i < tracedCount; i++) {
+        assert(traced[i].type == TRACE_SPLIT_BEGIN && traced[i].b == traced[i].a + 1);
+        assert(traced[i].thread > 0);
+    }
+    trace_ring_destroy(ring);
+
+    dpht_config_t traceConfig;
+    dpht_config_init(&traceConfig);
+    traceConfig.initial_tables = 2;
+    traceConfig.trace_events = 1 << 16;
+    DPHT* tracedTable = dpht_create_with_config(&traceConfig);
+    assert(tracedTable != NULL);
+    assert(dpht_trace_dump(dpht, stdout) == 0); // Tracing is opt-in
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "trace_%d", i);
+        assert(dpht_insert(tracedTable, key, "v") == 1);
+    }
+    FILE* traceFile = tmpfile();
+    assert(traceFile != NULL);
+    assert(dpht_trace_dump(tracedTable, traceFile) == 1);
+    long traceLength = ftell(traceFile);
+    char* traceJson = malloc(traceLength + 1);
+    assert(traceJson != NULL);
+    rewind(traceFile);
+    assert(fread(traceJson, 1, traceLength, traceFile) == (size_t)traceLength);
+    traceJson[traceLength] = '\0';
+    fclose(traceFile);
+    assert(strncmp(traceJson, "{\"traceEvents\":[", 16) == 0);
+    assert(strstr(traceJson, "\"dropped_events\":0}") != NULL);
+    int splitEvents = count_occurrences(traceJson, "\"name\":\"split\"");
+    assert(splitEvents == 2 * (tracedTable->capacity - 2));
+    assert(count_occurrences(traceJson, "\"name\":\"rebuild\"") > 0);
+    assert(count_occurrences(traceJson, "\"ph\":\"B\"") == count_occurrences(traceJson, "\"ph\":\"E\""));
+    assert(strstr(traceJson, "\"old_capacity\":2,\"new_capacity\":3") != NULL);
+    free(traceJson);
+    dpht_free(tracedTable);
+    printf("Trace test passed.\n");
+
+    // 23. Adaptive load test:
+    // The controller retunes max_load from measured costs but never leaves
+    // its bounds, and new buckets are sized for the chosen load.
+    dpht_config_t adaptiveConfig;
+    dpht_config_init(&adaptiveConfig);
+    adaptiveConfig.initial_tables = 2;
+    adaptiveConfig.max_load = 100.0; // Clamped to the bounds
+    adaptiveConfig.adaptive_load = 1;
+    adaptiveConfig.adaptive_min_load = 2.0;
+    adaptiveConfig.adaptive_max_load = 12.0;
+    DPHT* adaptive = dpht_create_with_config(&adaptiveConfig);
+    assert(adaptive != NULL && adaptive->max_load == 12.0 && adaptive->bucket_capacity == 16);
+    double loadsSeen[8];
+    int distinctLoads = 0;
+    for (int i = 0; i < 40000; i++) {
+        snprintf(key, sizeof(key), "adaptive_%d", i);
+        assert(dpht_insert(adaptive, key, "v") == 1);
+        assert(dpht_search(adaptive, key) != NULL);
+        assert(adaptive->max_load >= 2.0 && adaptive->max_load <= 12.0);
+        int seen = 0;
+        for (int j = 0; j < distinctLoads; j++) {
+            seen |= (loadsSeen[j] == adaptive->max_load);
+        }
+        if (!seen && distinctLoads < 8) {
+            loadsSeen[distinctLoads++] = adaptive->max_load;
+        }
+    }
+    assert(distinctLoads > 1); // The controller moved at least once
+    assert(adaptive->bucket_capacity >= adaptive->max_load &&
+           adaptive->bucket_capacity < 2 * adaptive->max_load);
+    assert(dpht_get_stats(adaptive, &stats) == 1);
+    assert(stats.max_load == adaptive->max_load && stats.build_ns_per_key > 0.0);
+    for (int i = 0; i < 40000; i += 97) {
+        snprintf(key, sizeof(key), "adaptive_%d", i);
+        assert(dpht_search(adaptive, key) != NULL);
+    }
+    dpht_free(adaptive);
+    assert(dpht_get_stats(dpht, &stats) == 1 && stats.max_load == dpht->max_load && stats.lookup_ns == 0.0);
+    printf("Adaptive load test passed.\n");
+
+    // 24. Shrink test:
+    // Removals merge buckets back once the load falls below the low-water
+    // mark and halve the directory array, without ever splitting again while
+    // the load hovers between the thresholds; dpht_compact() then repacks
+    // every bucket and the directory to exactly what they hold.
+    dpht_config_t shrinkConfig;
+    dpht_config_init(&shrinkConfig);
+    shrinkConfig.initial_tables = 2;
+    shrinkConfig.trace_events = 64;
+    DPHT* drained = dpht_create_with_config(&shrinkConfig);
+    assert(drained != NULL && drained->shrink_ratio == DPHT_DEFAULT_SHRINK_RATIO);
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert(dpht_insert(drained, key, "v") == 1);
+    }
+    int peakCapacity = drained->capacity;
+    int peakAllocated = drained->allocated;
+    for (int i = 0; i < 20000; i++) {
+        if (i % 100 != 0) {
+            snprintf(key, sizeof(key), "flow_%d", i);
+            assert(dpht_remove_n(drained, key, strlen(key)) == 1);
+        }
+        assert(drained->capacity == drained->base + drained->split);
+    }
+    assert(drained->size == 200 && drained->capacity < peakCapacity / 10);
+    assert(drained->allocated < peakAllocated / 4 && drained->allocated >= drained->capacity);
+    assert((double)drained->size / drained->capacity >= drained->shrink_ratio * drained->max_load);
+    size_t drainedEvents = trace_ring_snapshot(drained->context.trace, traced, 256, &dropped);
+    int merges = 0;
+    for (size_t i = 0; i < drainedEvents; i++) {
+        merges += (traced[i].type == TRACE_MERGE_BEGIN); // Index builds interleave with the merges
+    }
+    assert(merges > 0);
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert((dpht_search(drained, key) != NULL) == (i % 100 == 0));
+    }
+    int hoverCapacity = drained->capacity;
+    for (int i = 0; i < 1000; i++) {
+        assert(dpht_insert(drained, "hover", "v") == 1);
+        assert(drained->capacity <= hoverCapacity); // No split
+        assert(dpht_remove_n(drained, "hover", 5) == 1);
+        hoverCapacity = drained->capacity;
+    }
+    assert(hoverCapacity * drained->max_load > drained->size);
+    assert(dpht_get_stats(drained, &stats) == 1);
+    assert(!stats.counters_enabled || stats.merges == (uint64_t)(peakCapacity - drained->capacity));
+
+    assert(dpht_compact(NULL) == 0);
+    assert(dpht_compact(drained) == 1);
+    assert(drained->allocated == drained->capacity);
+    assert(drained->size <= drained->capacity * drained->max_load);
+    assert(drained->capacity == 2 || drained->size > (drained->capacity - 1) * drained->max_load);
+    for (int b = 0; b < drained->capacity; b++) {
+        PHT* bucket = drained->tables[b];
+        assert(bucket->tombstones == 0 && bucket->capacity == (bucket->size > 0 ? bucket->size : 1));
+        assert(bucket->size <= 1 || bucket->mph_size == bucket->size);
+    }
+    for (int i = 0; i < 20000; i += 100) {
+        snprintf(key, sizeof(key), "flow_%d", i);
+        assert(dpht_search(drained, key) != NULL);
+    }
+    for (int i = 0; i < 2000; i++) { // Still grows after a repack
+        snprintf(key, sizeof(key), "regrow_%d", i);
+        assert(dpht_insert(drained, key, "v") == 1);
+    }
+    assert(drained->size == 2200 && drained->size <= drained->capacity * drained->max_load);
+    dpht_free(drained);
+
+    shrinkConfig.backend = PHT_BACKEND_FKS;
+    shrinkConfig.shrink_ratio = 0.0; // Buckets are trimmed, the directory stays
+    shrinkConfig.trace_events = 0;
+    DPHT* drainedFks = dpht_create_with_config(&shrinkConfig);
+    assert(drainedFks != NULL);
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "fks_%d", i);
+        assert(dpht_insert(drainedFks, key, "v") == 1);
+    }
+    int fksCapacity = drainedFks->capacity;
+    int largestSlots = 0;
+    for (int b = 0; b < drainedFks->capacity; b++) {
+        if (drainedFks->tables[b]->slot_count > largestSlots) {
+            largestSlots = drainedFks->tables[b]->slot_count;
+        }
+    }
+    for (int i = 0; i < 2000; i++) {
+        if (i % 50 != 0) {
+            snprintf(key, sizeof(key), "fks_%d", i);
+            assert(dpht_remove_n(drainedFks, key, strlen(key)) == 1);
+        }
+    }
+    assert(drainedFks->capacity == fksCapacity);
+    for (int b = 0; b < drainedFks->capacity; b++) {
+        PHT* bucket = drainedFks->tables[b];
+        assert(bucket->size * 4 > bucket->capacity || bucket->capacity <= 4);
+        assert(bucket->slot_count == bucket->capacity * bucket->capacity && bucket->slot_count < largestSlots);
+    }
+    assert(dpht_compact(drainedFks) == 1 && drainedFks->capacity < fksCapacity);
+    for (int b = 0; b < drainedFks->capacity; b++) {
+        PHT* bucket = drainedFks->tables[b];
+        assert(bucket->capacity == (bucket->size > 0 ? bucket->size : 1));
+        assert(bucket->slot_count == bucket->capacity * bucket->capacity);
+    }
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "fks_%d", i);
+        assert((dpht_search(drainedFks, key) != NULL) == (i % 50 == 0));
+    }
+    dpht_free(drainedFks);
+    printf("Shrink test passed.\n");
+
+    // Clean up: Delete all DPHTs.
+    dpht_free(dpht6);
+    dpht_free(dpht5);
+    dpht_free(dpht4);
+    dpht_free(dpht3);
     dpht_free(dpht2);
     dpht_free(dpht);
 
@@ -0,0 +1,174 @@
+/*
+ * Test program for DPHashmap.h that performs the following:
+ * 1. Stores move-only values under string keys and finds them by std::string_view.
+ * 2. Stores values under fixed-width keys (integers and 5-tuples).
+ * 3. Checks that values are destroyed exactly once by erase(), clear() and the destructor.
+ * 4. Grows a map with custom traits and a custom hash, and checks value addresses stay put.
+ * 5. Compares insert and lookup times with the C API.
+ */
+
+#include <cassert>      // For assert
+#include <cstdio>       // For printf
+#include <cstring>      // For strlen
+#include <memory>       // For std::unique_ptr
+#include <string>
+#include <vector>
+#include <sys/time.h>   // For time functions
+#include "DPHashmap.h"
+
+/* Helper function: Returns the current time in seconds */
+static double get_time(void) {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec / 1000000.0;
+}
+
+/* An IPv4 5-tuple without padding bytes */
+struct FlowKey {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t sport;
+    uint16_t dport;
+    uint32_t proto;
+};
+
+/* A value that counts its live instances */
+struct Counted {
+    static int live;
+    int id;
+    explicit Counted(int i = 0) : id(i) { live++; }
+    Counted(const Counted& other) : id(other.id) { live++; }
+    Counted& operator=(const Counted&) = default;
+    ~Counted() { live--; }
+};
+int Counted::live = 0;
+
+/* Small buckets that split early */
+struct SmallBuckets : dpht::DefaultTraits<uint64_t> {
+    static constexpr int initial_buckets = 2;
+    static constexpr double max_load = 2.0;
+};
+
+/* The former default hash, through the Hash parameter */
+struct Djb2Hash {
+    uint64_t operator()(const void* key, size_t len, uint64_t seed) const noexcept {
+        return hash_djb2(key, len, seed);
+    }
+};
+
+#define NUM_KEYS 20000 // Number of keys of the growth and timing tests
+
+int main(void) {
+    // 1. String key Test:
+    // Values are move-only, and lookups take any string-like argument.
+    dpht::DPHashmap<std::string, std::unique_ptr<int>> names;
+    auto result = names.try_emplace("alpha", std::make_unique<int>(1));
+    assert(result.second && **result.first == 1);
+    result = names.try_emplace(std::string("alpha"), std::make_unique<int>(2));
+    assert(!result.second && **result.first == 1); // Existing value kept
+    names.insert_or_assign(std::string_view("beta"), std::make_unique<int>(3));
+    names.insert_or_assign("beta", std::make_unique<int>(4));
+    assert(names.size() == 2);
+    assert(**names.find(std::string_view("beta")) == 4);
+    assert(names.find("gamma") == nullptr);
+    assert(names.contains("alpha") && !names.contains("alph"));
+    names["gamma"] = std::make_unique<int>(5);
+    assert(**names.find("gamma") == 5);
+    assert(names.erase("alpha") && !names.erase("alpha"));
+    int visited = 0;
+    names.for_each([&](std::string_view key, std::unique_ptr<int>& value) {
+        assert(key == "beta" || key == "gamma");
+        visited += *value;
+    });
+    assert(visited == 9);
+    dpht::DPHashmap<std::string, std::unique_ptr<int>> moved(std::move(names));
+    assert(moved.size() == 2 && **moved.find("beta") == 4);
+    printf("String key test passed.\n");
+
+    // 2. Fixed-width key Test:
+    // Integers and 5-tuples are hashed and compared as their bytes.
+    static_assert(dpht::KeyBytes<FlowKey>::fixed_width, "5-tuples are fixed-width keys");
+    static_assert(!dpht::KeyBytes<std::string>::fixed_width, "strings are not");
+    dpht::DPHashmap<FlowKey, uint64_t> flows;
+    for (uint32_t i = 0; i < 1000; i++) {
+        FlowKey flow = { 0x0a000000u + i, 0xc0a80001u, (uint16_t)(1024 + i), 443, 6 };
+        flows[flow] += i;
+    }
+    FlowKey probe = { 0x0a000000u + 7, 0xc0a80001u, 1031, 443, 6 };
+    assert(flows.size() == 1000 && *flows.find(probe) == 7);
+    probe.proto = 17;
+    assert(flows.find(probe) == nullptr);
+    dpht::DPHashmap<uint32_t, int> counters(42);
+    counters[7u] = 1;
+    counters[7u]++;
+    assert(counters.size() == 1 && *counters.find(7u) == 2);
+    assert(counters.native()->seed == 42);
+    printf("Fixed-width key test passed.\n");
+
+    // 3. Value lifetime Test:
+    // Every constructed value is destroyed exactly once.
+    {
+        dpht::DPHashmap<uint64_t, Counted> lives;
+        for (uint64_t i = 0; i < 100; i++) {
+            lives.try_emplace(i, (int)i);
+        }
+        assert(Counted::live == 100);
+        for (uint64_t i = 0; i < 100; i += 2) {
+            assert(lives.erase(i));
+        }
+        assert(Counted::live == 50 && lives.size() == 50);
+        lives.clear();
+        assert(Counted::live == 0 && lives.empty());
+        lives.try_emplace(1u, 1);
+        lives.try_emplace(2u, 2);
+    }
+    assert(Counted::live == 0);
+    printf("Value lifetime test passed.\n");
+
+    // 4. Growth Test:
+    // Splits and rebuilds move pairs, never the values inside them.
+    dpht::DPHashmap<uint64_t, uint64_t, Djb2Hash, SmallBuckets> grown;
+    std::vector<uint64_t*> addresses;
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        addresses.push_back(grown.try_emplace(i, i * 3).first);
+    }
+    assert(grown.native()->capacity >= (int)(NUM_KEYS / SmallBuckets::max_load));
+    assert(grown.native()->hash != nullptr);
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        assert(grown.find(i) == addresses[i] && *addresses[i] == i * 3);
+    }
+    printf("Growth test passed.\n");
+
+    // 5. Timing Test:
+    // The template adds no work over the C API with binary keys.
+    DPHT* native = dpht_create(0);
+    dpht::DPHashmap<uint64_t, uint64_t> wrapped;
+    double start = get_time();
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        dpht_insert_n(native, &i, sizeof(i), &i, sizeof(i));
+    }
+    double c_insert = get_time() - start;
+    start = get_time();
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        wrapped.insert_or_assign(i, i);
+    }
+    double cpp_insert = get_time() - start;
+    uint64_t sum = 0;
+    start = get_time();
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        sum += *(uint64_t*)dpht_search_n(native, &i, sizeof(i), NULL);
+    }
+    double c_search = get_time() - start;
+    start = get_time();
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        sum -= *wrapped.find(i);
+    }
+    double cpp_search = get_time() - start;
+    assert(sum == 0);
+    dpht_free(native);
+    printf("Timing test passed: insert %f (C) / %f (C++) sec, search %f (C) / %f (C++) sec\n",
+           c_insert, cpp_insert, c_search, cpp_search);
+
+    printf("All DPHashmap tests passed successfully.\n");
+    return 0;
+}
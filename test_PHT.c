@@ -4,8 +4,11 @@
  * 2. Looks up each key and verifies the value.
  * 3. Updates each key's value and verifies the new value.
  * 4. Deletes every second key and verifies that those keys are removed.
- * 5. Creates a new PHT from the current one and verifies the keys.
- * 6. Cleans up by deleting both PHTs.
+ * 5. Creates a new PHT from the current one and verifies the keys and fingerprints.
+ * 6. Repeats insert/lookup/update/delete on a PHT using the FKS backend.
+ * 7. Checks that small buckets are indexed by a seed search instead of CMPH.
+ * 8. Checks that removals leave tombstones until the tombstone threshold.
+ * 9. Cleans up by deleting all PHTs.
  */
 
 #include <stdio.h>      // For printf
@@ -55,6 +58,8 @@ int main(void) {
         snprintf(expected, sizeof(expected), "value%d", i);
         assert(strcmp(result, expected) == 0);
     }
+    // Inserts leave at most PHT_DELTA_THRESHOLD keys outside the MPH
+    assert(pht->size - pht->mph_size <= PHT_DELTA_THRESHOLD);
     printf("Insertion test passed: %d keys inserted, size = %d\n", NUM_KEYS, pht->size);
     printf("Average insertion time: %f sec\n", total_insert / NUM_KEYS);
 
@@ -134,7 +139,8 @@ int main(void) {
     int new_capacity = pht->size + 1;
     PHT* new_pht = pht_create_from_array(pht, new_capacity);
     assert(new_pht != NULL);
-    assert(new_pht->size == pht->size);
+    assert(new_pht->size == pht->size - pht->tombstones);
+    assert(new_pht->tombstones == 0);
     // Check each key in the new table.
     for (int i = 0; i < NUM_KEYS; i++) {
         snprintf(key, sizeof(key), "key%d", i);
@@ -149,9 +155,140 @@ int main(void) {
             assert(strcmp(result, expected) == 0);
         }
     }
+    // Every fingerprint must match the entry it sits next to.
+    for (int i = 0; i < new_pht->size; i++) {
+        assert(new_pht->tags[i] == pht_tag(new_pht->entries[i]->hash));
+    }
     printf("Create-from-array test passed.\n");
 
-    // Clean up: Delete both PHTs.
+    // 6. FKS backend Test:
+    // Every operation must work without ever building a CMPH function.
+    PHT* fks = pht_create_with_backend(4, PHT_BACKEND_FKS);
+    assert(fks != NULL);
+    assert(fks->backend == PHT_BACKEND_FKS);
+    for (int i = 0; i < NUM_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(pht_insert(fks, pair_create(key, value)) == 1);
+        assert(fks->slot_count == fks->capacity * fks->capacity);
+    }
+    for (int i = 0; i < NUM_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "new_value%d", i);
+        assert(pht_update(fks, key, value) == 1);
+    }
+    for (int i = 0; i < NUM_KEYS; i += 2) {
+        snprintf(key, sizeof(key), "key%d", i);
+        pht_remove_entry(fks, key);
+    }
+    assert(fks->size == NUM_KEYS / 2);
+    assert(fks->mph == NULL);
+    for (int i = 0; i < NUM_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        result = pht_search(fks, key);
+        if (i % 2 == 0) {
+            assert(result == NULL);
+        }
+        else {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "new_value%d", i);
+            assert(result != NULL && strcmp(result, expected) == 0);
+        }
+    }
+    // Occupied slots carry their key's fingerprint, empty slots carry 0.
+    for (int slot = 0; slot < fks->slot_count; slot++) {
+        if (fks->slots[slot]) {
+            assert(fks->tags[slot] == pht_tag(fks->slots[slot]->hash));
+        }
+        else {
+            assert(fks->tags[slot] == 0);
+        }
+    }
+    // The quadratic slot array bounds the size of an FKS bucket.
+    assert(pht_create_with_backend(PHT_FKS_MAX_CAPACITY + 1, PHT_BACKEND_FKS) == NULL);
+    assert(pht_insert_batch(fks, fks->entries, PHT_FKS_MAX_CAPACITY) == 0);
+    assert(fks->size == NUM_KEYS / 2);
+    printf("FKS backend test passed.\n");
+
+    // 7. Seed-search MPH Test:
+    // Up to PHT_SEED_MAX_KEYS keys are indexed by a seed alone; larger
+    // buckets switch to CMPH.
+    PHT* tiny = pht_create(4);
+    assert(tiny != NULL);
+    for (int i = 0; i <= PHT_DELTA_THRESHOLD + 1; i++) {
+        snprintf(key, sizeof(key), "tiny%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(pht_insert(tiny, pair_create(key, value)) == 1);
+    }
+    assert(tiny->mph == NULL);
+    assert(tiny->mph_size == PHT_DELTA_THRESHOLD + 1);
+    for (int i = 0; i < tiny->mph_size; i++) {
+        // Every indexed entry sits in the slot its hash maps to
+        assert(pht_seed_slot(tiny->entries[i]->hash, (uint32_t)tiny->seed, tiny->mph_size) == i);
+        assert(tiny->tags[i] == pht_tag(tiny->entries[i]->hash));
+    }
+    for (int i = 0; i <= PHT_DELTA_THRESHOLD + 1; i++) {
+        snprintf(key, sizeof(key), "tiny%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        result = pht_search(tiny, key);
+        assert(result != NULL && strcmp(result, value) == 0);
+    }
+    assert(pht_search(tiny, "tiny99") == NULL);
+    pht_remove_entry(tiny, "tiny0");
+    assert(pht_search(tiny, "tiny0") == NULL);
+    assert(pht_search(tiny, "tiny1") != NULL);
+    for (int i = PHT_DELTA_THRESHOLD + 2; i < 3 * PHT_SEED_MAX_KEYS; i++) {
+        snprintf(key, sizeof(key), "tiny%d", i);
+        assert(pht_insert(tiny, pair_create(key, "large")) == 1);
+    }
+    assert(tiny->mph != NULL && tiny->mph_size > PHT_SEED_MAX_KEYS);
+    printf("Seed-search MPH test passed.\n");
+    pht_delete(tiny);
+
+    // 8. Tombstone Test:
+    // Removing an MPH-indexed key keeps the MPH and every other entry in
+    // place, until tombstones fill more than PHT_TOMBSTONE_PERCENT of the slots.
+    PHT* graves = pht_create(4);
+    assert(graves != NULL);
+    for (int i = 0; i < 4 * PHT_SEED_MAX_KEYS; i++) {
+        snprintf(key, sizeof(key), "grave%d", i);
+        assert(pht_insert(graves, pair_create(key, "alive")) == 1);
+    }
+    int indexed = graves->mph_size;
+    assert(indexed > PHT_SEED_MAX_KEYS && graves->mph != NULL);
+    cmph_t* graveMph = graves->mph;
+    unsigned int graveGeneration = graves->generation;
+    int removed = 0;
+    for (int slot = 0; (removed + 1) * 100 <= indexed * PHT_TOMBSTONE_PERCENT; slot++) {
+        snprintf(key, sizeof(key), "%s", graves->entries[slot]->key);
+        pht_remove_entry(graves, key);
+        removed++;
+        assert(graves->entries[slot] == NULL && graves->tags[slot] == 0);
+        assert(pht_search(graves, key) == NULL);
+    }
+    assert(graves->mph == graveMph && graves->mph_size == indexed);
+    assert(graves->tombstones == removed);
+    assert(graves->generation == graveGeneration); // No entry moved
+    for (int i = 0; i < 4 * PHT_SEED_MAX_KEYS; i++) {
+        snprintf(key, sizeof(key), "grave%d", i);
+        result = pht_search(graves, key);
+        assert(result == NULL || strcmp(result, "alive") == 0);
+    }
+    // One more tombstone crosses the threshold: compact and rebuild.
+    int live = graves->size - graves->tombstones;
+    snprintf(key, sizeof(key), "%s", graves->entries[removed]->key);
+    pht_remove_entry(graves, key);
+    assert(graves->tombstones == 0);
+    assert(graves->size == live - 1 && graves->mph_size == live - 1);
+    for (int i = 0; i < graves->size; i++) {
+        assert(graves->entries[i] != NULL);
+        assert(pht_search(graves, graves->entries[i]->key) != NULL);
+    }
+    printf("Tombstone test passed.\n");
+    pht_delete(graves);
+
+    // Clean up: Delete all PHTs.
+    pht_delete(fks);
     pht_delete(new_pht);
     pht_delete(pht);
 
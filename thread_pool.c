@@ -0,0 +1,269 @@
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+/** Range of loop indices owned by one participant.
+ *
+ * \param lock Protects begin and end against thieves.
+ * \param begin Next index the owner will take.
+ * \param end One past the last index of the range.
+ */
+typedef struct PoolRange {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} pool_range_t;
+
+/** Arguments of a background thread.
+ *
+ * \param pool Pointer to the pool.
+ * \param index Participant index of the thread (the caller is 0).
+ */
+typedef struct PoolThread {
+    thread_pool_t* pool;
+    int index;
+} pool_thread_t;
+
+/** Structure for the thread pool.
+ *
+ * \param count Number of participants, the calling thread included.
+ * \param threads Background threads (count - 1 of them).
+ * \param args Arguments of the background threads.
+ * \param ranges Per-participant index ranges of the current loop.
+ * \param lock Protects round, stop and active.
+ * \param start Signalled when a loop starts or the pool stops.
+ * \param done Signalled when the last background thread finishes a loop.
+ * \param round Number of the current loop; threads wait for it to change.
+ * \param stop Set to 1 when the threads must exit.
+ * \param active Background threads still working on the current loop.
+ * \param fn Body of the current loop.
+ * \param arg Argument of the current loop.
+ * \param grain Chunk size of the current loop.
+ */
+struct ThreadPool {
+    int count;
+    pthread_t* threads;
+    pool_thread_t* args;
+    pool_range_t* ranges;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long round;
+    int stop;
+    int active;
+    thread_pool_fn fn;
+    void* arg;
+    size_t grain;
+};
+
+/** Takes the next chunk from the front of a participant's own range.
+ *
+ * \param range Pointer to the range.
+ * \param grain Largest chunk to take.
+ * \param begin Receives the first index of the chunk.
+ * \param end Receives one past the last index of the chunk.
+ * \returns 1 if a chunk was taken, 0 if the range is empty.
+ */
+static int pool_take(pool_range_t* range, size_t grain, size_t* begin, size_t* end) {
+    int taken = 0;
+    pthread_mutex_lock(&range->lock);
+    if (range->begin < range->end) {
+        *begin = range->begin;
+        *end = (range->end - range->begin > grain) ? range->begin + grain : range->end;
+        range->begin = *end;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return taken;
+}
+
+/** Moves the back half of a victim's range to a thief.
+ *
+ * \param victim Pointer to the range to steal from.
+ * \param thief Pointer to the (empty) range of the stealing participant.
+ * \returns 1 if indices were stolen, 0 if the victim had nothing left.
+ */
+static int pool_steal(pool_range_t* victim, pool_range_t* thief) {
+    size_t begin, end;
+    pthread_mutex_lock(&victim->lock);
+    size_t remaining = victim->end - victim->begin;
+    if (remaining == 0) {
+        pthread_mutex_unlock(&victim->lock);
+        return 0;
+    }
+    end = victim->end;
+    begin = end - (remaining > 1 ? remaining / 2 : 1);
+    victim->end = begin;
+    pthread_mutex_unlock(&victim->lock);
+
+    pthread_mutex_lock(&thief->lock);
+    thief->begin = begin;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->lock);
+    return 1;
+}
+
+/** Runs chunks of the current loop until no participant has work left.
+ *
+ * \param pool Pointer to the pool.
+ * \param self Participant index of the calling thread.
+ */
+static void pool_work(thread_pool_t* pool, int self) {
+    pool_range_t* own = &pool->ranges[self];
+    size_t begin, end;
+
+    while (1) {
+        if (pool_take(own, pool->grain, &begin, &end)) {
+            pool->fn(begin, end, pool->arg);
+            continue;
+        }
+
+        // Own range exhausted: steal from the other participants in turn
+        int stolen = 0;
+        for (int k = 1; k < pool->count && !stolen; k++) {
+            stolen = pool_steal(&pool->ranges[(self + k) % pool->count], own);
+        }
+        if (!stolen) {
+            return; // Every range is empty; running chunks finish on their own
+        }
+    }
+}
+
+/** Main loop of a background thread.
+ *
+ * \param arg Pointer to the pool_thread_t of the thread.
+ * \returns NULL.
+ */
+static void* pool_thread_main(void* arg) {
+    pool_thread_t* self = (pool_thread_t*)arg;
+    thread_pool_t* pool = self->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->round == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, self->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+thread_pool_t* thread_pool_create(int threads) {
+    if (threads < 2) {
+        return NULL; // A single thread needs no pool
+    }
+
+    thread_pool_t* pool = (thread_pool_t*)calloc(1, sizeof(thread_pool_t));
+    if (!pool) {
+        return NULL; // Memory allocation failed
+    }
+    pool->count = threads;
+    pool->threads = (pthread_t*)calloc(threads - 1, sizeof(pthread_t));
+    pool->args = (pool_thread_t*)calloc(threads - 1, sizeof(pool_thread_t));
+    pool->ranges = (pool_range_t*)calloc(threads, sizeof(pool_range_t));
+    if (!pool->threads || !pool->args || !pool->ranges) {
+        free(pool->threads);
+        free(pool->args);
+        free(pool->ranges);
+        free(pool);
+        return NULL; // Memory allocation failed
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->ranges[i].lock, NULL);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Start the background threads; the caller is participant 0
+    for (int i = 0; i < threads - 1; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].index = i + 1;
+        if (pthread_create(&pool->threads[i], NULL, pool_thread_main, &pool->args[i]) != 0) {
+            pool->count = i + 1; // Only join the threads that were started
+            thread_pool_destroy(pool);
+            return NULL; // Thread creation failed
+        }
+    }
+    return pool;
+}
+
+int thread_pool_size(const thread_pool_t* pool) {
+    return pool ? pool->count : 1;
+}
+
+void thread_pool_parallel_for(thread_pool_t* pool, size_t n, size_t grain,
+                              thread_pool_fn fn, void* arg) {
+    if (!fn || n == 0) {
+        return; // Nothing to run
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+    if (!pool || n <= grain) {
+        fn(0, n, arg); // Not worth waking the threads
+        return;
+    }
+
+    // Divide the range evenly; stealing corrects any imbalance
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->grain = grain;
+    for (int i = 0; i < pool->count; i++) {
+        pool->ranges[i].begin = n * i / pool->count;
+        pool->ranges[i].end = n * (i + 1) / pool->count;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->active = pool->count - 1;
+    pool->round++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_work(pool, 0);
+
+    // Wait until every background thread has left the loop
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count - 1; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        pthread_mutex_destroy(&pool->ranges[i].lock);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->args);
+    free(pool->ranges);
+    free(pool);
+}
@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure for a fixed set of threads running data-parallel loops.
+ *
+ * A loop over [0, n) is first divided evenly between the participants. Each
+ * participant takes small chunks from the front of its own range; once its
+ * range is empty it steals the back half of another participant's range.
+ * Skewed work (e.g. a few very large buckets) is therefore spread over all
+ * threads instead of holding back the one that received it.
+ *
+ * The calling thread takes part in every loop, so a pool of N threads runs
+ * N - 1 background threads. A pool runs one loop at a time and must not be
+ * used from several threads at once.
+ */
+typedef struct ThreadPool thread_pool_t;
+
+/** Signature of the body of a parallel loop.
+ *
+ * \param begin First index of the chunk.
+ * \param end One past the last index of the chunk.
+ * \param arg The argument passed to thread_pool_parallel_for().
+ */
+typedef void (*thread_pool_fn)(size_t begin, size_t end, void* arg);
+
+/** Creates a thread pool and starts its background threads.
+ *
+ * \param threads Total number of threads taking part in a loop, the caller
+ *                included (at least 2).
+ * \returns A pointer to the new pool, or NULL on failure.
+ */
+thread_pool_t* thread_pool_create(int threads);
+
+/** Returns the number of threads taking part in each loop.
+ *
+ * \param pool Pointer to the pool, or NULL.
+ * \returns The number of threads, or 1 for a NULL pool.
+ */
+int thread_pool_size(const thread_pool_t* pool);
+
+/** Runs fn over every index of [0, n) and waits for all chunks to finish.
+ *
+ * With a NULL pool the whole range runs on the calling thread.
+ *
+ * \param pool Pointer to the pool, or NULL.
+ * \param n Number of indices.
+ * \param grain Largest number of indices handed to fn at once (at least 1).
+ * \param fn Loop body; called concurrently on disjoint chunks.
+ * \param arg Argument passed to every call of fn.
+ */
+void thread_pool_parallel_for(thread_pool_t* pool, size_t n, size_t grain,
+                              thread_pool_fn fn, void* arg);
+
+/** Stops the background threads and frees the pool.
+ *
+ * \param pool Pointer to the pool to destroy (NULL is ignored).
+ */
+void thread_pool_destroy(thread_pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,201 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Structure for one slot of the ring.
+ *
+ * \param sequence Ticket of the event in the slot plus one once it is
+ *                 published, 0 while a writer is filling it in.
+ * \param event The event.
+ */
+typedef struct TraceSlot {
+    uint64_t sequence;
+    trace_event_t event;
+} __attribute__((aligned(64))) trace_slot_t;   // Concurrent writers never share a line
+
+/** Structure for an event ring.
+ *
+ * \param head Tickets handed out so far; ticket t lives in slot t & mask.
+ * \param mask Capacity minus one (the capacity is a power of two).
+ * \param origin_ns Monotonic time at creation, subtracted from every timestamp.
+ * \param slots The slots.
+ */
+struct TraceRing {
+    uint64_t head;
+    uint64_t mask;
+    uint64_t origin_ns;
+    trace_slot_t* slots;
+};
+
+static uint32_t trace_next_thread = 1;     // Id handed to the next recording thread
+static __thread uint32_t trace_thread = 0;  // This thread's id, 0 until first use
+
+/** Reads the monotonic clock.
+ *
+ * \returns The time in nanoseconds.
+ */
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+trace_ring_t* trace_ring_create(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    trace_ring_t* ring = (trace_ring_t*)malloc(sizeof(trace_ring_t));
+    if (!ring) {
+        return NULL; // Memory allocation failed
+    }
+    ring->slots = (trace_slot_t*)aligned_alloc(sizeof(trace_slot_t), sizeof(trace_slot_t) * rounded);
+    if (!ring->slots) {
+        free(ring);
+        return NULL; // Memory allocation failed
+    }
+    memset(ring->slots, 0, sizeof(trace_slot_t) * rounded);
+    ring->head = 0;
+    ring->mask = rounded - 1;
+    ring->origin_ns = trace_now();
+    return ring;
+}
+
+void trace_ring_record(trace_ring_t* ring, trace_event_type_t type, trace_build_kind_t kind,
+                       int64_t bucket, int64_t a, int64_t b) {
+    if (!ring) {
+        return;
+    }
+    if (trace_thread == 0) {
+        trace_thread = __atomic_fetch_add(&trace_next_thread, 1, __ATOMIC_RELAXED);
+    }
+    uint64_t timestamp = trace_now() - ring->origin_ns;
+
+    // Claim a ticket, then fill its slot in between two sequence stores
+    uint64_t ticket = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    trace_slot_t* slot = &ring->slots[ticket & ring->mask];
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->event.timestamp_ns, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.type, (uint16_t)type, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.kind, (uint16_t)kind, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.thread, trace_thread, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.bucket, bucket, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.a, a, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->event.b, b, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, ticket + 1, __ATOMIC_RELEASE);
+}
+
+size_t trace_ring_snapshot(const trace_ring_t* ring, trace_event_t* out, size_t max, uint64_t* dropped) {
+    if (!ring || !out) {
+        return 0;
+    }
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t capacity = ring->mask + 1;
+    uint64_t first = (head > capacity) ? head - capacity : 0;
+    if (head - first > max) {
+        first = head - max; // Keep the newest events that fit
+    }
+
+    size_t count = 0;
+    for (uint64_t ticket = first; ticket < head; ticket++) {
+        const trace_slot_t* slot = &ring->slots[ticket & ring->mask];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != ticket + 1) {
+            continue; // Not published yet, or already overwritten
+        }
+        trace_event_t* event = &out[count];
+        event->timestamp_ns = __atomic_load_n(&slot->event.timestamp_ns, __ATOMIC_RELAXED);
+        event->type = __atomic_load_n(&slot->event.type, __ATOMIC_RELAXED);
+        event->kind = __atomic_load_n(&slot->event.kind, __ATOMIC_RELAXED);
+        event->thread = __atomic_load_n(&slot->event.thread, __ATOMIC_RELAXED);
+        event->bucket = __atomic_load_n(&slot->event.bucket, __ATOMIC_RELAXED);
+        event->a = __atomic_load_n(&slot->event.a, __ATOMIC_RELAXED);
+        event->b = __atomic_load_n(&slot->event.b, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == ticket + 1) {
+            count++; // Not overwritten while we copied it
+        }
+    }
+    if (dropped) {
+        *dropped = head - count;
+    }
+    return count;
+}
+
+/** Returns the name of a build kind as written to the trace.
+ *
+ * \param kind The build kind.
+ * \returns A static string.
+ */
+static const char* trace_kind_name(uint16_t kind) {
+    switch (kind) {
+    case TRACE_BUILD_SEED:
+        return "seed";
+    case TRACE_BUILD_FKS:
+        return "fks";
+    default:
+        return "cmph";
+    }
+}
+
+int trace_ring_write_chrome(const trace_ring_t* ring, FILE* out) {
+    if (!ring || !out) {
+        return 0;
+    }
+    size_t capacity = (size_t)ring->mask + 1;
+    trace_event_t* events = (trace_event_t*)malloc(sizeof(trace_event_t) * capacity);
+    if (!events) {
+        return 0; // Memory allocation failed
+    }
+    uint64_t dropped = 0;
+    size_t count = trace_ring_snapshot(ring, events, capacity, &dropped);
+
+    fprintf(out, "{\"traceEvents\":[");
+    for (size_t i = 0; i < count; i++) {
+        const trace_event_t* event = &events[i];
+        const char* phase = "i";
+        const char* name = "mph_failure";
+        int resize = 0;   // Splits and merges carry capacities instead of keys
+        if (event->type == TRACE_REBUILD_BEGIN || event->type == TRACE_REBUILD_END) {
+            name = "rebuild";
+            phase = (event->type == TRACE_REBUILD_BEGIN) ? "B" : "E";
+        }
+        else if (event->type == TRACE_SPLIT_BEGIN || event->type == TRACE_SPLIT_END) {
+            name = "split";
+            phase = (event->type == TRACE_SPLIT_BEGIN) ? "B" : "E";
+            resize = 1;
+        }
+        else if (event->type == TRACE_MERGE_BEGIN || event->type == TRACE_MERGE_END) {
+            name = "merge";
+            phase = (event->type == TRACE_MERGE_BEGIN) ? "B" : "E";
+            resize = 1;
+        }
+
+        fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"dpht\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,",
+                i ? "," : "", name, phase, event->timestamp_ns / 1000.0, (unsigned)event->thread);
+        if (*phase == 'i') {
+            fprintf(out, "\"s\":\"t\",");  // Instant event scoped to its thread
+        }
+        if (resize) {
+            fprintf(out, "\"args\":{\"bucket\":%lld,\"old_capacity\":%lld,\"new_capacity\":%lld}}",
+                    (long long)event->bucket, (long long)event->a, (long long)event->b);
+        }
+        else {
+            fprintf(out, "\"args\":{\"bucket\":%lld,\"keys\":%lld,\"kind\":\"%s\"}}",
+                    (long long)event->bucket, (long long)event->a, trace_kind_name(event->kind));
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu}}\n",
+            (unsigned long long)dropped);
+    free(events);
+    return ferror(out) ? 0 : 1;
+}
+
+void trace_ring_destroy(trace_ring_t* ring) {
+    if (!ring) {
+        return;
+    }
+    free(ring->slots);
+    free(ring);
+}
@@ -0,0 +1,115 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque structure for a fixed-size ring buffer of timestamped events.
+ *
+ * Any number of threads record events without taking a lock: each claims a
+ * slot with one atomic increment and publishes it with a sequence number,
+ * overwriting the oldest event once the ring is full. A reader copies the
+ * ring out at any time and skips the slots that are being overwritten.
+ */
+typedef struct TraceRing trace_ring_t;
+
+/** Types of traced events. */
+typedef enum {
+    TRACE_REBUILD_BEGIN,    // A bucket index build starts (bucket, keys, kind)
+    TRACE_REBUILD_END,      // The build finished (bucket, keys, kind)
+    TRACE_SPLIT_BEGIN,      // A bucket split starts (bucket, old and new capacity)
+    TRACE_SPLIT_END,        // The split finished (bucket, old and new capacity)
+    TRACE_MPH_FAILURE,      // An index build failed (bucket, keys, kind)
+    TRACE_MERGE_BEGIN,      // A bucket merge starts (bucket kept, old and new capacity)
+    TRACE_MERGE_END         // The merge finished (bucket kept, old and new capacity)
+} trace_event_type_t;
+
+/** Kinds of bucket index builds, recorded with rebuild and failure events. */
+typedef enum {
+    TRACE_BUILD_CMPH,       // CMPH function, inline or on the background worker
+    TRACE_BUILD_SEED,       // Seed-search MPH of a small bucket
+    TRACE_BUILD_FKS         // FKS slot array re-seed
+} trace_build_kind_t;
+
+/** Structure for one recorded event.
+ *
+ * \param timestamp_ns Monotonic time since the ring was created, in nanoseconds.
+ * \param type The event type (a trace_event_type_t).
+ * \param kind The build kind of rebuild and failure events (a trace_build_kind_t).
+ * \param thread Small id of the recording thread, numbered from 1 in order of
+ *               first use.
+ * \param bucket Index of the bucket in the directory, or -1 if unknown.
+ * \param a Keys indexed by a build, or the capacity before a split or merge.
+ * \param b The capacity after a split or merge (unused otherwise).
+ */
+typedef struct TraceEvent {
+    uint64_t timestamp_ns;
+    uint16_t type;
+    uint16_t kind;
+    uint32_t thread;
+    int64_t bucket;
+    int64_t a;
+    int64_t b;
+} trace_event_t;
+
+/** Creates an empty event ring.
+ *
+ * \param capacity The number of events kept, rounded up to a power of two.
+ * \returns A pointer to the new ring, or NULL on failure.
+ */
+trace_ring_t* trace_ring_create(size_t capacity);
+
+/** Records an event, overwriting the oldest one if the ring is full.
+ *
+ * \param ring Pointer to the ring (NULL is ignored, so callers need not check).
+ * \param type The event type.
+ * \param kind The build kind, or 0.
+ * \param bucket The bucket index, or -1.
+ * \param a First event argument.
+ * \param b Second event argument.
+ */
+void trace_ring_record(trace_ring_t* ring, trace_event_type_t type, trace_build_kind_t kind,
+                       int64_t bucket, int64_t a, int64_t b);
+
+/** Copies the events currently in the ring, oldest first.
+ *
+ * Events being overwritten while they are copied are left out.
+ *
+ * \param ring Pointer to the ring.
+ * \param out Array receiving up to max events.
+ * \param max Capacity of out.
+ * \param dropped If not NULL, receives the number of events ever recorded
+ *                that are not in out (overwritten, or skipped as torn).
+ * \returns The number of events copied.
+ */
+size_t trace_ring_snapshot(const trace_ring_t* ring, trace_event_t* out, size_t max, uint64_t* dropped);
+
+/** Writes the events of a ring as Chrome trace_event JSON.
+ *
+ * Builds, splits and merges become duration events ("B"/"E") on the thread that ran
+ * them and failures become instant events, so the file loads directly into
+ * chrome://tracing or Perfetto. Begin events whose end was not recorded yet,
+ * or end events whose begin was overwritten, are still written; viewers show
+ * them as open or ignore them.
+ *
+ * \param ring Pointer to the ring.
+ * \param out The stream to write to.
+ * \returns 1 on success, 0 on failure (memory allocation or write error).
+ */
+int trace_ring_write_chrome(const trace_ring_t* ring, FILE* out);
+
+/** Frees a ring.
+ *
+ * \param ring Pointer to the ring (NULL is ignored).
+ */
+void trace_ring_destroy(trace_ring_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H